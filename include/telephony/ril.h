@@ -3331,6 +3331,27 @@ typedef struct {
  */
 #define RIL_REQUEST_GET_UNLOCK_RETRY_COUNT 150
 
+/**
+ * RIL_REQUEST_SET_UNSOLICITED_SUBSCRIPTIONS
+ *
+ * Chooses which unsolicited responses this connection to rild receives.
+ * Answered by libril itself; never passed to the vendor RIL.
+ *
+ * The phone process starts out subscribed to all of them; any other
+ * client starts out subscribed to none.
+ *
+ * "data" is int *
+ * ((int *)data)[0] is the number of mask words that follow
+ * ((int *)data)[1 + w] bit b selects RIL_UNSOL_RESPONSE_BASE + w * 32 + b
+ *
+ * "response" is NULL
+ *
+ * Valid errors:
+ *  SUCCESS
+ *  GENERIC_FAILURE
+ */
+#define RIL_REQUEST_SET_UNSOLICITED_SUBSCRIPTIONS 151
+
 
 /***********************************************************************/
 
@@ -3865,6 +3886,11 @@ typedef void (*RIL_Cancel)(RIL_Token t);
 
 typedef void (*RIL_TimedCallback) (void *param);
 
+/**
+ * Opaque handle to a pending timed callback; NULL is never a valid handle
+ */
+typedef void * RIL_TimedCallbackHandle;
+
 /**
  * Return a version string for your RIL implementation
  */
@@ -3915,6 +3941,26 @@ struct RIL_Env {
 
     void (*RequestTimedCallback) (RIL_TimedCallback callback,
                                    void *param, const struct timeval *relativeTime);
+
+    /**
+     * Same as RequestTimedCallback, but returns a handle that can be passed
+     * to CancelTimedCallback, or NULL on failure. The handle becomes invalid
+     * as soon as the callback starts running.
+     *
+     * These entries follow the original ones so that RIL implementations
+     * built against an older RIL_Env keep working unchanged.
+     */
+
+    RIL_TimedCallbackHandle (*RequestTimedCallbackEx) (RIL_TimedCallback callback,
+                                   void *param, const struct timeval *relativeTime);
+
+    /**
+     * Cancel a callback requested with RequestTimedCallbackEx.
+     * Returns 0 if the callback was cancelled and will not run, or -1 if
+     * it has already started running or "handle" is no longer valid
+     */
+
+    int (*CancelTimedCallback) (RIL_TimedCallbackHandle handle);
 };
 
 
@@ -3981,6 +4027,28 @@ void RIL_onUnsolicitedResponse(int unsolResponse, const void *data,
 void RIL_requestTimedCallback (RIL_TimedCallback callback,
                                void *param, const struct timeval *relativeTime);
 
+/**
+ * Same as RIL_requestTimedCallback, but returns a handle for
+ * RIL_cancelTimedCallback, or NULL on failure
+ *
+ * @param callback user-specifed callback function
+ * @param param parameter list
+ * @param relativeTime a relative time value at which the callback is invoked
+ */
+
+RIL_TimedCallbackHandle RIL_requestTimedCallbackEx (RIL_TimedCallback callback,
+                               void *param, const struct timeval *relativeTime);
+
+/**
+ * Cancel a callback requested with RIL_requestTimedCallbackEx
+ *
+ * @param handle handle returned by RIL_requestTimedCallbackEx
+ * @return 0 if the callback will not run, -1 if it already started
+ *         running or the handle is no longer valid
+ */
+
+int RIL_cancelTimedCallback (RIL_TimedCallbackHandle handle);
+
 
 #endif /* RIL_SHLIB */
 
@@ -0,0 +1,64 @@
+/*
+ * Copyright (C) 2006 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef ANDROID_RIL_TRACE_H
+#define ANDROID_RIL_TRACE_H 1
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * Binary trace of the per-request hot paths, exported by libril for the
+ * vendor RIL as well. Each thread records into a ring of its own, so
+ * recording is a clock read and a few stores with no lock and no
+ * formatting; events are only turned into text when the rings are
+ * dumped, which the debug socket does with command 14.
+ *
+ * Each ring holds the last few hundred events of its thread. Strings
+ * keep their first RIL_TRACE_STRING_MAX bytes.
+ */
+
+#define RIL_TRACE_STRING_MAX 44
+
+typedef enum {
+    RIL_TRACE_REQUEST = 1,          /* token, request */
+    RIL_TRACE_RESPONSE,             /* token, request, RIL_Errno */
+    RIL_TRACE_UNSOL,                /* unsolicited response */
+    RIL_TRACE_LOCAL_REQUEST,        /* request issued by libril itself */
+    RIL_TRACE_LOCAL_RESPONSE,       /* request, RIL_Errno */
+    RIL_TRACE_VENDOR_REQUEST,       /* request, as the vendor RIL takes it */
+    RIL_TRACE_AT_SEND,              /* string: AT command line */
+    RIL_TRACE_AT_SEND_PDU,          /* string: line sent ending in ^Z */
+    RIL_TRACE_AT_RECV               /* string: line read from the modem */
+} RIL_TraceEvent;
+
+/* Record an event with up to three integer arguments. Any thread. */
+void RIL_trace(RIL_TraceEvent event, int32_t a, int32_t b, int32_t c);
+
+/* Record an event with a string argument. Any thread. */
+void RIL_traceString(RIL_TraceEvent event, const char *s);
+
+/* Log every thread's events through ALOGI, oldest first */
+void RIL_traceDump(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /*ANDROID_RIL_TRACE_H*/
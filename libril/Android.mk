@@ -5,7 +5,18 @@ include $(CLEAR_VARS)
 
 LOCAL_SRC_FILES:= \
     ril.cpp \
-    ril_event.cpp
+    ril_event.cpp \
+    ril_pool.cpp \
+    ril_arena.cpp \
+    ril_capture.cpp \
+    ril_trace.cpp
+
+# the ASCII string paths are vectorized when NEON is available
+ifeq ($(ARCH_ARM_HAVE_NEON),true)
+LOCAL_SRC_FILES += ril_string.cpp.neon
+else
+LOCAL_SRC_FILES += ril_string.cpp
+endif
 
 LOCAL_SHARED_LIBRARIES := \
     libutils \
@@ -22,13 +33,121 @@ LOCAL_LDLIBS += -lpthread
 include $(BUILD_SHARED_LIBRARY)
 
 
+# Host benchmark for the event loop
+# =================================
+include $(CLEAR_VARS)
+
+LOCAL_SRC_FILES:= \
+    ril_event.cpp \
+    bench/ril_event_bench.cpp
+
+# the shim stands in for liblog
+LOCAL_C_INCLUDES := \
+    $(LOCAL_PATH) \
+    $(LOCAL_PATH)/bench/shim
+
+LOCAL_CFLAGS := -DHAVE_POSIX_CLOCKS
+
+LOCAL_MODULE:= ril_event_bench
+LOCAL_MODULE_TAGS := optional
+
+LOCAL_LDLIBS += -lpthread -lrt
+
+include $(BUILD_HOST_EXECUTABLE)
+
+
+# Host benchmark for string marshalling
+# =====================================
+include $(CLEAR_VARS)
+
+LOCAL_SRC_FILES:= \
+    ril_string.cpp \
+    bench/ril_string_bench.cpp
+
+LOCAL_C_INCLUDES := \
+    $(LOCAL_PATH)
+
+LOCAL_STATIC_LIBRARIES := \
+    libcutils
+
+LOCAL_MODULE:= ril_string_bench
+LOCAL_MODULE_TAGS := optional
+
+LOCAL_LDLIBS += -lrt
+
+include $(BUILD_HOST_EXECUTABLE)
+
+
+# Host tool printing a command socket capture
+# ============================================
+include $(CLEAR_VARS)
+
+LOCAL_SRC_FILES:= \
+    tools/ril_capture_dump.cpp
+
+LOCAL_C_INCLUDES := \
+    $(LOCAL_PATH)
+
+LOCAL_MODULE:= ril_capture_dump
+LOCAL_MODULE_TAGS := optional
+
+include $(BUILD_HOST_EXECUTABLE)
+
+
+# Load generator for the command socket
+# ======================================
+include $(CLEAR_VARS)
+
+LOCAL_SRC_FILES:= \
+    tools/ril_loadgen.cpp
+
+LOCAL_C_INCLUDES := \
+    $(LOCAL_PATH)
+
+LOCAL_SHARED_LIBRARIES := \
+    libcutils
+
+LOCAL_MODULE:= ril_loadgen
+LOCAL_MODULE_TAGS := optional
+
+include $(BUILD_EXECUTABLE)
+
+
+# The same for the host, to drive a device's rild through
+#   adb forward localfilesystem:/tmp/rild localreserved:rild
+# with -s /tmp/rild
+# ========================================================
+include $(CLEAR_VARS)
+
+LOCAL_SRC_FILES:= \
+    tools/ril_loadgen.cpp
+
+LOCAL_C_INCLUDES := \
+    $(LOCAL_PATH)
+
+LOCAL_STATIC_LIBRARIES := \
+    libcutils
+
+LOCAL_MODULE:= ril_loadgen
+LOCAL_MODULE_TAGS := optional
+
+LOCAL_LDLIBS += -lpthread -lrt
+
+include $(BUILD_HOST_EXECUTABLE)
+
+
 # For RdoServD which needs a static library
 # =========================================
 ifneq ($(ANDROID_BIONIC_TRANSITION),)
 include $(CLEAR_VARS)
 
 LOCAL_SRC_FILES:= \
-    ril.cpp
+    ril.cpp \
+    ril_pool.cpp \
+    ril_arena.cpp \
+    ril_capture.cpp \
+    ril_trace.cpp \
+    ril_string.cpp
 
 LOCAL_STATIC_LIBRARIES := \
     libutils_static \
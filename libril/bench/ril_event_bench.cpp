@@ -0,0 +1,517 @@
+/* //device/libs/telephony/bench/ril_event_bench.cpp
+**
+** Copyright 2008, The Android Open Source Project
+**
+** Licensed under the Apache License, Version 2.0 (the "License");
+** you may not use this file except in compliance with the License.
+** You may obtain a copy of the License at
+**
+**     http://www.apache.org/licenses/LICENSE-2.0
+**
+** Unless required by applicable law or agreed to in writing, software
+** distributed under the License is distributed on an "AS IS" BASIS,
+** WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+** See the License for the specific language governing permissions and
+** limitations under the License.
+*/
+
+// Host micro-benchmarks for ril_event. Links only ril_event.cpp and a
+// logging shim; results are written to stdout as one JSON object.
+//
+// usage: ril_event_bench [select|epoll]
+
+#define LOG_TAG "ril_bench"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <time.h>
+#include <pthread.h>
+#include <semaphore.h>
+#include <sys/time.h>
+#include <sys/select.h>
+#include <sys/resource.h>
+#include <utils/Log.h>
+#include <ril_event.h>
+
+static const int s_timerCounts[] = {10, 100, 1000, 10000, 100000};
+static const int s_fdCounts[] = {8, 64, 256, 1024};
+static const int s_threadCounts[] = {1, 2, 4, 8};
+
+#define NUM_ELEMS(a) ((int) (sizeof(a) / sizeof((a)[0])))
+
+// Timers added by each posting thread in the contention benchmark
+#define CONTENTION_TIMERS_PER_THREAD 20000
+
+// Round trips measured for single-fd dispatch and wakeup latency
+#define LATENCY_ROUNDS 5000
+
+// Timers posted by each thread in the wakeup stress test, and how long
+// to wait for all of them to fire before calling one lost
+#define STRESS_POSTS_PER_THREAD 50000
+#define STRESS_TIMEOUT_S 10
+
+static int s_fdWakeupRead;
+static int s_fdWakeupWrite;
+static struct ril_event s_wakeupEvent;
+// Set while a wakeup is written but not yet drained, as in ril.cpp
+static volatile int32_t s_wakeupPending = 0;
+static volatile bool s_widenWakeupRace = false;
+
+// Completion signalling from the loop thread back to the benchmark
+static sem_t s_done;
+static volatile int s_remaining;
+static uint64_t s_lastFireNs;
+
+static struct ril_event s_latencyEvent;
+static uint64_t s_postNs;
+static struct ril_histogram s_latency;
+
+static uint64_t nowNs()
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t) ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+// Like processWakeupCallback in ril.cpp: drain, then let the next
+// post write again
+static void wakeupCallback(int fd, short flags, void *param)
+{
+    char buf[64];
+
+    while (read(fd, buf, sizeof(buf)) > 0);
+    // the stress test stretches the window in which posts race the drain
+    if (s_widenWakeupRace) {
+        usleep(20);
+    }
+    __sync_lock_release(&s_wakeupPending);
+}
+
+// Like triggerEvLoop in ril.cpp: make the loop recompute its timeout,
+// writing only if no wakeup is on its way already
+static void wakeLoop()
+{
+    int ret;
+
+    if (!__sync_bool_compare_and_swap(&s_wakeupPending, 0, 1)) {
+        return;
+    }
+    do {
+        ret = write(s_fdWakeupWrite, " ", 1);
+    } while (ret < 0 && errno == EINTR);
+}
+
+static void countdownCallback(int fd, short flags, void *param)
+{
+    if (__sync_sub_and_fetch(&s_remaining, 1) == 0) {
+        s_lastFireNs = nowNs();
+        sem_post(&s_done);
+    }
+}
+
+static void waitDone()
+{
+    while (sem_wait(&s_done) < 0 && errno == EINTR);
+}
+
+// waitDone giving up after seconds; false if it did
+static bool waitDoneFor(int seconds)
+{
+    struct timespec deadline;
+    int ret;
+
+    clock_gettime(CLOCK_REALTIME, &deadline);
+    deadline.tv_sec += seconds;
+    do {
+        ret = sem_timedwait(&s_done, &deadline);
+    } while (ret < 0 && errno == EINTR);
+    return ret == 0;
+}
+
+static void *loopThread(void *param)
+{
+    ril_event_loop();
+    ALOGE("event loop exited");
+    exit(1);
+    return NULL;
+}
+
+static void printHistogram(const struct ril_histogram * h)
+{
+    printf("{\"count\": %u, \"p50_us\": %u, \"p90_us\": %u, \"p99_us\": %u, \"max_us\": %u}",
+            (unsigned int) h->count,
+            (unsigned int) ril_histogram_percentile(h, 50),
+            (unsigned int) ril_histogram_percentile(h, 90),
+            (unsigned int) ril_histogram_percentile(h, 99),
+            (unsigned int) h->max);
+}
+
+// Insert, cancel and fire n timers. Inserts go into a heap already
+// holding the earlier ones, with shuffled far-future deadlines.
+static void benchTimers(int n)
+{
+    struct ril_event * events;
+    struct timeval tv;
+    uint64_t start, insertNs, deleteNs, fireNs;
+
+    events = (struct ril_event *) calloc(n, sizeof(struct ril_event));
+    for (int i = 0; i < n; i++) {
+        ril_event_set(&events[i], -1, false, countdownCallback, NULL);
+    }
+
+    start = nowNs();
+    for (int i = 0; i < n; i++) {
+        tv.tv_sec = 3600 + rand() % 3600;
+        tv.tv_usec = rand() % 1000000;
+        ril_timer_add(&events[i], &tv);
+    }
+    insertNs = nowNs() - start;
+
+    s_remaining = n;
+    start = nowNs();
+    for (int i = 0; i < n; i++) {
+        ril_event_del(&events[i]);
+    }
+    deleteNs = nowNs() - start;
+
+    // cancelled timers come back through their callback
+    wakeLoop();
+    waitDone();
+
+    // all due at once, so this measures expiry and dispatch only
+    tv.tv_sec = 0;
+    tv.tv_usec = 0;
+    s_remaining = n;
+    for (int i = 0; i < n; i++) {
+        ril_timer_add(&events[i], &tv);
+    }
+    start = nowNs();
+    wakeLoop();
+    waitDone();
+    fireNs = s_lastFireNs - start;
+
+    printf("    {\"pending\": %d, \"insert_ns\": %.1f, \"delete_ns\": %.1f, \"fire_ns\": %.1f}",
+            n, (double) insertNs / n, (double) deleteNs / n, (double) fireNs / n);
+    free(events);
+}
+
+static void drainCallback(int fd, short flags, void *param)
+{
+    char buf[16];
+
+    while (read(fd, buf, sizeof(buf)) > 0);
+    countdownCallback(fd, flags, param);
+}
+
+// Dispatch with n watched fds: one ready at a time, then all at once.
+// Returns false if the fds could not be set up.
+static bool benchFds(int n, bool first)
+{
+    int (*pipes)[2];
+    struct ril_event * events;
+    struct ril_histogram single;
+    uint64_t start, allNs;
+    int opened;
+
+    pipes = (int (*)[2]) calloc(n, sizeof(pipes[0]));
+    events = (struct ril_event *) calloc(n, sizeof(struct ril_event));
+
+    for (opened = 0; opened < n; opened++) {
+        if (pipe(pipes[opened]) < 0) {
+            break;
+        }
+        // select can't watch fds past FD_SETSIZE
+        if (ril_event_get_backend() == RIL_EVENT_BACKEND_SELECT
+                && pipes[opened][0] >= FD_SETSIZE) {
+            close(pipes[opened][0]);
+            close(pipes[opened][1]);
+            break;
+        }
+    }
+
+    if (opened == n) {
+        for (int i = 0; i < n; i++) {
+            ril_event_set(&events[i], pipes[i][0], true, drainCallback, NULL);
+            ril_event_add(&events[i]);
+        }
+        wakeLoop();
+
+        ril_histogram_clear(&single);
+        for (int i = 0; i < LATENCY_ROUNDS; i++) {
+            s_remaining = 1;
+            start = nowNs();
+            write(pipes[rand() % n][1], " ", 1);
+            waitDone();
+            ril_histogram_record(&single, (uint32_t) ((s_lastFireNs - start) / 1000));
+        }
+
+        s_remaining = n;
+        start = nowNs();
+        for (int i = 0; i < n; i++) {
+            write(pipes[i][1], " ", 1);
+        }
+        waitDone();
+        allNs = s_lastFireNs - start;
+
+        for (int i = 0; i < n; i++) {
+            ril_event_del(&events[i]);
+        }
+
+        printf("%s    {\"watched\": %d, \"single_ready\": ", first ? "" : ",\n", n);
+        printHistogram(&single);
+        printf(", \"all_ready_ns_per_fd\": %.1f}", (double) allNs / n);
+    } else {
+        ALOGW("skipping %d fds: only %d could be watched", n, opened);
+    }
+
+    for (int i = 0; i < opened; i++) {
+        close(pipes[i][0]);
+        close(pipes[i][1]);
+    }
+    free(events);
+    free(pipes);
+    return opened == n;
+}
+
+struct PosterArgs {
+    struct ril_event * events;
+    int count;
+};
+
+static pthread_barrier_t s_startBarrier;
+
+static void *posterThread(void *param)
+{
+    PosterArgs *args = (PosterArgs *) param;
+    struct timeval tv;
+
+    pthread_barrier_wait(&s_startBarrier);
+    for (int i = 0; i < args->count; i++) {
+        tv.tv_sec = 3600;
+        tv.tv_usec = i % 1000000;
+        ril_timer_add(&args->events[i], &tv);
+    }
+    return NULL;
+}
+
+// Concurrent ril_timer_add from several threads into one loop
+static void benchContention(int threads)
+{
+    int total = threads * CONTENTION_TIMERS_PER_THREAD;
+    struct ril_event * events;
+    pthread_t * tids;
+    PosterArgs * args;
+    uint64_t start, elapsedNs;
+
+    events = (struct ril_event *) calloc(total, sizeof(struct ril_event));
+    tids = (pthread_t *) calloc(threads, sizeof(pthread_t));
+    args = (PosterArgs *) calloc(threads, sizeof(PosterArgs));
+
+    for (int i = 0; i < total; i++) {
+        ril_event_set(&events[i], -1, false, countdownCallback, NULL);
+    }
+
+    pthread_barrier_init(&s_startBarrier, NULL, threads + 1);
+    for (int i = 0; i < threads; i++) {
+        args[i].events = events + i * CONTENTION_TIMERS_PER_THREAD;
+        args[i].count = CONTENTION_TIMERS_PER_THREAD;
+        pthread_create(&tids[i], NULL, posterThread, &args[i]);
+    }
+
+    start = nowNs();
+    pthread_barrier_wait(&s_startBarrier);
+    for (int i = 0; i < threads; i++) {
+        pthread_join(tids[i], NULL);
+    }
+    elapsedNs = nowNs() - start;
+    pthread_barrier_destroy(&s_startBarrier);
+
+    s_remaining = total;
+    for (int i = 0; i < total; i++) {
+        ril_event_del(&events[i]);
+    }
+    wakeLoop();
+    waitDone();
+
+    printf("    {\"threads\": %d, \"adds\": %d, \"adds_per_sec\": %.0f}",
+            threads, total, total * 1e9 / elapsedNs);
+
+    free(args);
+    free(tids);
+    free(events);
+}
+
+static void latencyCallback(int fd, short flags, void *param)
+{
+    ril_histogram_record(&s_latency, (uint32_t) ((nowNs() - s_postNs) / 1000));
+    sem_post(&s_done);
+}
+
+// Post a zero-delay timer from another thread and wait for it to run
+static void benchWakeup()
+{
+    struct timeval tv = {0, 0};
+
+    ril_histogram_clear(&s_latency);
+    for (int i = 0; i < LATENCY_ROUNDS; i++) {
+        ril_event_set(&s_latencyEvent, -1, false, latencyCallback, NULL);
+        s_postNs = nowNs();
+        ril_timer_add(&s_latencyEvent, &tv);
+        wakeLoop();
+        waitDone();
+    }
+    printHistogram(&s_latency);
+}
+
+static void *stressThread(void *param)
+{
+    PosterArgs *args = (PosterArgs *) param;
+    struct timeval tv = {0, 0};
+
+    pthread_barrier_wait(&s_startBarrier);
+    for (int i = 0; i < args->count; i++) {
+        ril_timer_add(&args->events[i], &tv);
+        wakeLoop();
+    }
+    return NULL;
+}
+
+// Post zero-delay timers from several threads, each followed by a
+// wakeup, so posts keep landing while the loop drains the wakeup fd.
+// Every timer must fire; one that doesn't means a wakeup was lost.
+// Returns false if any was.
+static bool stressWakeup(int threads)
+{
+    int total = threads * STRESS_POSTS_PER_THREAD;
+    struct ril_event * events;
+    pthread_t * tids;
+    PosterArgs * args;
+    bool fired;
+    int lost;
+
+    events = (struct ril_event *) calloc(total, sizeof(struct ril_event));
+    tids = (pthread_t *) calloc(threads, sizeof(pthread_t));
+    args = (PosterArgs *) calloc(threads, sizeof(PosterArgs));
+
+    for (int i = 0; i < total; i++) {
+        ril_event_set(&events[i], -1, false, countdownCallback, NULL);
+    }
+    s_remaining = total;
+    s_widenWakeupRace = true;
+
+    pthread_barrier_init(&s_startBarrier, NULL, threads + 1);
+    for (int i = 0; i < threads; i++) {
+        args[i].events = events + i * STRESS_POSTS_PER_THREAD;
+        args[i].count = STRESS_POSTS_PER_THREAD;
+        pthread_create(&tids[i], NULL, stressThread, &args[i]);
+    }
+    pthread_barrier_wait(&s_startBarrier);
+    for (int i = 0; i < threads; i++) {
+        pthread_join(tids[i], NULL);
+    }
+    pthread_barrier_destroy(&s_startBarrier);
+
+    fired = waitDoneFor(STRESS_TIMEOUT_S);
+    s_widenWakeupRace = false;
+    lost = fired ? 0 : s_remaining;
+
+    printf("    {\"threads\": %d, \"posts\": %d, \"lost\": %d}", threads, total, lost);
+
+    // the loop still holds the events of a failed run, so leak them
+    if (fired) {
+        free(events);
+    }
+    free(args);
+    free(tids);
+    return fired;
+}
+
+int main(int argc, char **argv)
+{
+    enum ril_event_backend requested = RIL_EVENT_BACKEND_DEFAULT;
+    int filedes[2];
+    pthread_t tid;
+    struct rlimit rl;
+    bool first;
+    bool ok = true;
+
+    if (argc > 1) {
+        if (strcmp(argv[1], "select") == 0) {
+            requested = RIL_EVENT_BACKEND_SELECT;
+        } else if (strcmp(argv[1], "epoll") == 0) {
+            requested = RIL_EVENT_BACKEND_EPOLL;
+        } else {
+            fprintf(stderr, "usage: %s [select|epoll]\n", argv[0]);
+            return 1;
+        }
+    }
+
+    // two fds per watched pipe, plus headroom
+    if (getrlimit(RLIMIT_NOFILE, &rl) == 0 && rl.rlim_cur < 4096) {
+        rl.rlim_cur = (rl.rlim_max < 4096) ? rl.rlim_max : 4096;
+        setrlimit(RLIMIT_NOFILE, &rl);
+    }
+
+    srand(1);
+    sem_init(&s_done, 0, 0);
+    ril_event_init_backend(requested);
+
+    if (pipe(filedes) < 0) {
+        ALOGE("pipe failed (%d)", errno);
+        return 1;
+    }
+    s_fdWakeupRead = filedes[0];
+    s_fdWakeupWrite = filedes[1];
+    fcntl(s_fdWakeupRead, F_SETFL, O_NONBLOCK);
+    ril_event_set(&s_wakeupEvent, s_fdWakeupRead, true, wakeupCallback, NULL);
+    ril_event_add(&s_wakeupEvent);
+
+    pthread_create(&tid, NULL, loopThread, NULL);
+
+    printf("{\n  \"benchmark\": \"ril_event\",\n  \"backend\": \"%s\",\n",
+            (ril_event_get_backend() == RIL_EVENT_BACKEND_EPOLL) ? "epoll" : "select");
+
+    printf("  \"timers\": [\n");
+    for (int i = 0; i < NUM_ELEMS(s_timerCounts); i++) {
+        benchTimers(s_timerCounts[i]);
+        printf("%s\n", (i + 1 < NUM_ELEMS(s_timerCounts)) ? "," : "");
+    }
+    printf("  ],\n");
+
+    printf("  \"fds\": [\n");
+    first = true;
+    for (int i = 0; i < NUM_ELEMS(s_fdCounts); i++) {
+        if (benchFds(s_fdCounts[i], first)) {
+            first = false;
+        }
+    }
+    printf("\n  ],\n");
+
+    printf("  \"contention\": [\n");
+    for (int i = 0; i < NUM_ELEMS(s_threadCounts); i++) {
+        benchContention(s_threadCounts[i]);
+        printf("%s\n", (i + 1 < NUM_ELEMS(s_threadCounts)) ? "," : "");
+    }
+    printf("  ],\n");
+
+    printf("  \"wakeup_latency\": ");
+    benchWakeup();
+    printf(",\n");
+
+    printf("  \"wakeup_stress\": [\n");
+    for (int i = 0; i < NUM_ELEMS(s_threadCounts); i++) {
+        if (!stressWakeup(s_threadCounts[i])) {
+            ALOGE("wakeup stress: timers never fired");
+            ok = false;
+        }
+        printf("%s\n", (i + 1 < NUM_ELEMS(s_threadCounts)) ? "," : "");
+    }
+    printf("  ]\n}\n");
+
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,327 @@
+/* //device/libs/telephony/bench/ril_string_bench.cpp
+**
+** Copyright 2008, The Android Open Source Project
+**
+** Licensed under the Apache License, Version 2.0 (the "License");
+** you may not use this file except in compliance with the License.
+** You may obtain a copy of the License at
+**
+**     http://www.apache.org/licenses/LICENSE-2.0
+**
+** Unless required by applicable law or agreed to in writing, software
+** distributed under the License is distributed on an "AS IS" BASIS,
+** WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+** See the License for the specific language governing permissions and
+** limitations under the License.
+*/
+
+// Host micro-benchmark for string marshalling: the strdup8to16 /
+// strndup16to8 path ril.cpp used to take against the ASCII fast path in
+// ril_string.cpp, on payloads shaped like real responses and requests.
+// Parcel is not available on the host, so a minimal buffer with the same
+// wire layout stands in for it. Results go to stdout as one JSON object.
+//
+// usage: ril_string_bench [iterations]
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <cutils/jstring.h>
+#include <ril_string.h>
+
+#define NUM_ELEMS(a) ((int) (sizeof(a) / sizeof((a)[0])))
+
+#define DEFAULT_ITERATIONS 200000
+
+// Parcel's wire layout: 32-bit words, strings as a length followed by
+// NUL-terminated UTF-16 padded to a word
+struct WireBuffer {
+    uint8_t *data;
+    size_t size;
+    size_t capacity;
+};
+
+static void *wireInplace(WireBuffer *w, size_t len)
+{
+    size_t padded = (len + 3) & ~(size_t) 3;
+    void *p;
+
+    if (w->size + padded > w->capacity) {
+        w->capacity = (w->size + padded) * 2;
+        w->data = (uint8_t *) realloc(w->data, w->capacity);
+    }
+    p = w->data + w->size;
+    memset(w->data + w->size + len, 0, padded - len);
+    w->size += padded;
+    return p;
+}
+
+static void wireInt32(WireBuffer *w, int32_t value)
+{
+    memcpy(wireInplace(w, sizeof(value)), &value, sizeof(value));
+}
+
+// Parcel::writeString16
+static void wireString16(WireBuffer *w, const char16_t *s, size_t len)
+{
+    if (s == NULL) {
+        wireInt32(w, -1);
+        return;
+    }
+    wireInt32(w, len);
+    uint8_t *p = (uint8_t *) wireInplace(w, (len + 1) * sizeof(char16_t));
+    memcpy(p, s, len * sizeof(char16_t));
+    memset(p + len * sizeof(char16_t), 0, sizeof(char16_t));
+}
+
+// Parcel::readString16Inplace
+static const char16_t *wireReadString16(const WireBuffer *w, size_t *pos, size_t *len)
+{
+    int32_t n;
+
+    memcpy(&n, w->data + *pos, sizeof(n));
+    *pos += sizeof(n);
+    if (n < 0) {
+        return NULL;
+    }
+    const char16_t *s = (const char16_t *) (w->data + *pos);
+    *pos += ((n + 1) * sizeof(char16_t) + 3) & ~(size_t) 3;
+    *len = n;
+    return s;
+}
+
+static void writeStringOld(WireBuffer *w, const char *s)
+{
+    char16_t *s16;
+    size_t s16_len;
+
+    s16 = strdup8to16(s, &s16_len);
+    wireString16(w, s16, s16_len);
+    free(s16);
+}
+
+// Same as writeStringToParcel in ril.cpp
+static void writeStringNew(WireBuffer *w, const char *s)
+{
+    if (s != NULL) {
+        size_t len = strlen(s);
+
+        if (ril_is_ascii(s, len)) {
+            wireInt32(w, len);
+            char16_t *s16 = (char16_t *) wireInplace(w, (len + 1) * sizeof(char16_t));
+            ril_ascii_widen((uint16_t *) s16, s, len);
+            s16[len] = 0;
+            return;
+        }
+    }
+    writeStringOld(w, s);
+}
+
+static char *readStringOld(const WireBuffer *w, size_t *pos)
+{
+    size_t len = 0;
+    const char16_t *s16 = wireReadString16(w, pos, &len);
+
+    return strndup16to8(s16, len);
+}
+
+// Same as arenaReadString in ril.cpp, with malloc standing in for the arena
+static char *readStringNew(const WireBuffer *w, size_t *pos)
+{
+    size_t len;
+    const char16_t *s16 = wireReadString16(w, pos, &len);
+    char *s8;
+
+    if (s16 == NULL) {
+        return NULL;
+    }
+    s8 = (char *) malloc(len + 1);
+    if (s8 != NULL && ril_ascii_narrow(s8, (const uint16_t *) s16, len)) {
+        s8[len] = '\0';
+        return s8;
+    }
+    free(s8);
+    return strndup16to8(s16, len);
+}
+
+typedef void (*write_string_fn)(WireBuffer *w, const char *s);
+
+// responseCallList with three calls
+static void payloadCallList(WireBuffer *w, write_string_fn writeString)
+{
+    static const char *numbers[] = {"+14155550123", "+442079460958", "5551234"};
+    static const char *names[] = {"Alice Example", NULL, "Voicemail"};
+
+    wireInt32(w, NUM_ELEMS(numbers));
+    for (int i = 0; i < NUM_ELEMS(numbers); i++) {
+        wireInt32(w, 0);            // state
+        wireInt32(w, i + 1);        // index
+        wireInt32(w, 145);          // toa
+        wireInt32(w, 0);            // isMpty
+        wireInt32(w, i == 1);       // isMT
+        wireInt32(w, 0);            // als
+        wireInt32(w, 1);            // isVoice
+        wireInt32(w, 0);            // isVoicePrivacy
+        writeString(w, numbers[i]);
+        wireInt32(w, 0);            // numberPresentation
+        writeString(w, names[i]);
+        wireInt32(w, 0);            // namePresentation
+        wireInt32(w, 0);            // no uusInfo
+    }
+}
+
+// responseStrings for VOICE_REGISTRATION_STATE
+static void payloadRegistration(WireBuffer *w, write_string_fn writeString)
+{
+    static const char *strings[] = {"1", "1f2e", "0003a4b2", "3", NULL, NULL, NULL,
+            NULL, NULL, NULL, NULL, NULL, NULL, "0"};
+
+    wireInt32(w, NUM_ELEMS(strings));
+    for (int i = 0; i < NUM_ELEMS(strings); i++) {
+        writeString(w, strings[i]);
+    }
+}
+
+// responseStrings for OPERATOR
+static void payloadOperator(WireBuffer *w, write_string_fn writeString)
+{
+    wireInt32(w, 3);
+    writeString(w, "T-Mobile US");
+    writeString(w, "T-Mobile");
+    writeString(w, "310260");
+}
+
+// responseStrings for OPERATOR with a non-ASCII name: the slow path
+static void payloadOperatorUtf8(WireBuffer *w, write_string_fn writeString)
+{
+    wireInt32(w, 3);
+    writeString(w, "T\xc3\xa9l\xc3\xa9" "com Espa\xc3\xb1" "a");
+    writeString(w, "T\xc3\xa9l\xc3\xa9" "com");
+    writeString(w, "21407");
+}
+
+// responseSIM_IO with a 256-byte EF read
+static void payloadSimIo(WireBuffer *w, write_string_fn writeString)
+{
+    static char hex[513];
+
+    if (hex[0] == '\0') {
+        for (int i = 0; i < 512; i++) {
+            hex[i] = "0123456789ABCDEF"[(i * 7) & 15];
+        }
+    }
+    wireInt32(w, 0x90);
+    wireInt32(w, 0x00);
+    writeString(w, hex);
+}
+
+struct Payload {
+    const char *name;
+    void (*build)(WireBuffer *w, write_string_fn writeString);
+};
+
+static const Payload s_payloads[] = {
+    {"call_list", payloadCallList},
+    {"registration", payloadRegistration},
+    {"operator", payloadOperator},
+    {"operator_utf8", payloadOperatorUtf8},
+    {"sim_io", payloadSimIo},
+};
+
+static uint64_t nowNs()
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t) ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static double timeWrite(const Payload *payload, write_string_fn writeString, int iterations)
+{
+    WireBuffer w = {NULL, 0, 0};
+    uint64_t start = nowNs();
+
+    for (int i = 0; i < iterations; i++) {
+        w.size = 0;
+        payload->build(&w, writeString);
+    }
+
+    double ns = (double) (nowNs() - start) / iterations;
+    free(w.data);
+    return ns;
+}
+
+typedef char *(*read_string_fn)(const WireBuffer *w, size_t *pos);
+
+// Where writeStringRecorded put each string of the payload
+static size_t s_offsets[64];
+static int s_offsetCount;
+
+static void writeStringRecorded(WireBuffer *w, const char *s)
+{
+    if (s_offsetCount < NUM_ELEMS(s_offsets)) {
+        s_offsets[s_offsetCount++] = w->size;
+    }
+    writeStringOld(w, s);
+}
+
+// Read back every string in the payload, the way dispatch functions do
+static double timeRead(const Payload *payload, read_string_fn readString, int iterations)
+{
+    WireBuffer w = {NULL, 0, 0};
+
+    s_offsetCount = 0;
+    payload->build(&w, writeStringRecorded);
+
+    uint64_t start = nowNs();
+    for (int i = 0; i < iterations; i++) {
+        for (int j = 0; j < s_offsetCount; j++) {
+            size_t pos = s_offsets[j];
+            free(readString(&w, &pos));
+        }
+    }
+
+    double ns = (double) (nowNs() - start) / iterations;
+    free(w.data);
+    return ns;
+}
+
+int main(int argc, char **argv)
+{
+    int iterations = DEFAULT_ITERATIONS;
+
+    if (argc > 1) {
+        iterations = atoi(argv[1]);
+        if (iterations <= 0) {
+            fprintf(stderr, "usage: %s [iterations]\n", argv[0]);
+            return 1;
+        }
+    }
+
+    printf("{\n  \"benchmark\": \"ril_string\",\n  \"iterations\": %d,\n", iterations);
+    printf("  \"simd\": \"%s\",\n",
+#if defined(__SSE2__)
+            "sse2"
+#elif defined(__ARM_NEON__) || defined(__ARM_NEON)
+            "neon"
+#else
+            "none"
+#endif
+            );
+    printf("  \"payloads\": [\n");
+    for (int i = 0; i < NUM_ELEMS(s_payloads); i++) {
+        const Payload *payload = &s_payloads[i];
+
+        printf("    {\"name\": \"%s\", \"write_old_ns\": %.1f, \"write_new_ns\": %.1f, "
+                "\"read_old_ns\": %.1f, \"read_new_ns\": %.1f}%s\n",
+                payload->name,
+                timeWrite(payload, writeStringOld, iterations),
+                timeWrite(payload, writeStringNew, iterations),
+                timeRead(payload, readStringOld, iterations),
+                timeRead(payload, readStringNew, iterations),
+                (i + 1 < NUM_ELEMS(s_payloads)) ? "," : "");
+    }
+    printf("  ]\n}\n");
+    return 0;
+}
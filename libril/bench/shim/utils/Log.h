@@ -0,0 +1,39 @@
+/* //device/libs/telephony/bench/shim/utils/Log.h
+**
+** Copyright 2008, The Android Open Source Project
+**
+** Licensed under the Apache License, Version 2.0 (the "License");
+** you may not use this file except in compliance with the License.
+** You may obtain a copy of the License at
+**
+**     http://www.apache.org/licenses/LICENSE-2.0
+**
+** Unless required by applicable law or agreed to in writing, software
+** distributed under the License is distributed on an "AS IS" BASIS,
+** WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+** See the License for the specific language governing permissions and
+** limitations under the License.
+*/
+
+// Minimal stand-in for liblog so ril_event.cpp can be built on its own.
+// Everything goes to stderr; stdout is left to the benchmark results.
+
+#ifndef RIL_BENCH_LOG_H
+#define RIL_BENCH_LOG_H
+
+#include <stdio.h>
+
+#ifndef LOG_TAG
+#define LOG_TAG "ril_bench"
+#endif
+
+#define RIL_BENCH_LOG(prio, ...) \
+    (fprintf(stderr, prio "/%s: ", LOG_TAG), fprintf(stderr, __VA_ARGS__), fputc('\n', stderr))
+
+#define ALOGV(...) ((void)0)
+#define ALOGD(...) ((void)0)
+#define ALOGI(...) RIL_BENCH_LOG("I", __VA_ARGS__)
+#define ALOGW(...) RIL_BENCH_LOG("W", __VA_ARGS__)
+#define ALOGE(...) RIL_BENCH_LOG("E", __VA_ARGS__)
+
+#endif /* RIL_BENCH_LOG_H */
@@ -45,11 +45,18 @@
 #include <ctype.h>
 #include <alloca.h>
 #include <sys/un.h>
+#include <sys/uio.h>
 #include <assert.h>
 #include <netinet/in.h>
+#include <sys/eventfd.h>
 #include <cutils/properties.h>
 
 #include <ril_event.h>
+#include <ril_arena.h>
+#include <ril_capture.h>
+#include <ril_pool.h>
+#include <ril_string.h>
+#include <telephony/ril_trace.h>
 
 namespace android {
 
@@ -63,9 +70,45 @@ namespace android {
 
 #define PROPERTY_RIL_IMPL "gsm.version.ril-impl"
 
+// Users other than PHONE_PROCESS that may connect to the command
+// socket, separated by commas. They get no unsolicited responses until
+// they ask for them with RIL_REQUEST_SET_UNSOLICITED_SUBSCRIPTIONS.
+#define PROPERTY_RIL_CLIENTS "ro.ril.clients"
+
+// Coalescing windows for unsolicited responses, in milliseconds; 0 turns
+// that kind of coalescing off
+#define PROPERTY_UNSOL_COLLAPSE_MS "ril.unsol.collapse_ms"
+#define PROPERTY_UNSOL_MIN_INTERVAL_MS "ril.unsol.min_interval_ms"
+#define DEFAULT_UNSOL_COLLAPSE_MS 200
+#define DEFAULT_UNSOL_MIN_INTERVAL_MS 1000
+
+// Size in KB of the ring command socket traffic is captured into, 0 to
+// not capture. The host tool ril_capture_dump prints the file.
+#define PROPERTY_RIL_CAPTURE_KB "persist.ril.capture_kb"
+#define RIL_CAPTURE_PATH "/data/misc/radio/ril_capture"
+
+// Longest a response may be held back
+#define MAX_UNSOL_COALESCE_MS 1000
+
 // match with constant in RIL.java
 #define MAX_COMMAND_BYTES (8 * 1024)
 
+// Messages gathered into a single write to the command socket
+#define MAX_BATCH_FRAMES 16
+
+// Connections the command socket accepts at once
+#define MAX_CLIENTS 8
+
+// Bounds on messages queued for a connection. Solicited responses
+// are already bounded by the client's outstanding requests; that limit
+// only guards against a client that stops reading altogether.
+#define MAX_OUTBOUND_SOLICITED 256
+#define MAX_OUTBOUND_UNSOLICITED 64
+
+// Decoded arguments of one request; a request that needs more spills
+// into malloc'd chunks for the duration of its dispatch
+#define DISPATCH_ARENA_BYTES (2 * MAX_COMMAND_BYTES)
+
 // Basically: memset buffers that the client library
 // shouldn't be using anymore in an attempt to find
 // memory usage issues sooner.
@@ -75,6 +118,9 @@ namespace android {
 
 #define MIN(a,b) ((a)<(b) ? (a) : (b))
 
+/* Fails to compile unless expr holds; name says why */
+#define RIL_COMPILE_ASSERT(expr, name) typedef char name[(expr) ? 1 : -1]
+
 /* Constants for response types */
 #define RESPONSE_SOLICITED 0
 #define RESPONSE_UNSOLICITED 1
@@ -89,18 +135,18 @@ namespace android {
 #define RILC_LOG 0
 
 #if RILC_LOG
-    #define startRequest           sprintf(printBuf, "(")
-    #define closeRequest           sprintf(printBuf, "%s)", printBuf)
+    #define startRequest           (clearPrintBuf, appendPrintBuf("("))
+    #define closeRequest           appendPrintBuf(")")
     #define printRequest(token, req)           \
             ALOGD("[%04d]> %s %s", token, requestToString(req), printBuf)
 
-    #define startResponse           sprintf(printBuf, "%s {", printBuf)
-    #define closeResponse           sprintf(printBuf, "%s}", printBuf)
+    #define startResponse           appendPrintBuf(" {")
+    #define closeResponse           appendPrintBuf("}")
     #define printResponse           ALOGD("%s", printBuf)
 
-    #define clearPrintBuf           printBuf[0] = 0
-    #define removeLastChar          printBuf[strlen(printBuf)-1] = 0
-    #define appendPrintBuf(x...)    sprintf(printBuf, x)
+    #define clearPrintBuf           (printBufLen = 0, printBuf[0] = 0)
+    #define removeLastChar          (printBufLen > 0 ? printBuf[--printBufLen] = 0 : 0)
+    #define appendPrintBuf(x...)    appendPrintBufImpl(x)
 #else
     #define startRequest
     #define closeRequest
@@ -115,24 +161,47 @@ namespace android {
 
 enum WakeType {DONT_WAKE, WAKE_PARTIAL};
 
+/* What to do with an unsolicited response when the client has fallen
+   behind and the outbound queue is full */
+enum OutboundPolicy {
+    OUTBOUND_DROP_OLDEST,       // drop the oldest queued unsolicited response
+    OUTBOUND_REPLACE_LATEST     // replace the queued one with the same ID, if any
+};
+
+/* How a burst of one unsolicited response is thinned out before it
+   reaches the client. The first of a burst goes out straight away; the
+   rest are held, newest replacing older, and the last is sent once the
+   window has passed */
+enum CoalescePolicy {
+    COALESCE_NONE,
+    COALESCE_COLLAPSE,          // payload-free notification, s_collapseWindowMs
+    COALESCE_LATEST             // state snapshot, s_minIntervalMs
+};
+
 typedef struct {
     int requestNumber;
+    const char *name;
     void (*dispatchFunction) (Parcel &p, struct RequestInfo *pRI);
     int(*responseFunction) (Parcel &p, void *response, size_t responselen);
 } CommandInfo;
 
 typedef struct {
     int requestNumber;
+    const char *name;
     int (*responseFunction) (Parcel &p, void *response, size_t responselen);
     WakeType wakeType;
+    OutboundPolicy outboundPolicy;
+    CoalescePolicy coalescePolicy;
 } UnsolResponseInfo;
 
 typedef struct RequestInfo {
     int32_t token;      //this is not RIL_Token
     CommandInfo *pCI;
-    struct RequestInfo *p_next;
+    struct RilClient *client;   // connection it came in on, NULL if local
+    uint32_t clientId;  // client->id when the request arrived
     char cancelled;
     char local;         // responses to local commands do not go back to command process
+    int64_t intakeUs;   // nowUs() when the request was read
 } RequestInfo;
 
 typedef struct UserCallbackInfo {
@@ -140,8 +209,24 @@ typedef struct UserCallbackInfo {
     void *userParam;
     struct ril_event event;
     struct UserCallbackInfo *p_next;
+    int slot;           // index in s_timedCallbackSlots, -1 if no handle
 } UserCallbackInfo;
 
+/* A RIL_TimedCallbackHandle encodes a slot index in the low bits and the
+   slot's generation in the high bits, so a handle whose callback already
+   ran (and whose slot was reused) is rejected instead of dereferenced.
+   Handles fit in 32 bits. Free slots are reused oldest first, so a stale
+   handle could only match again after 2^20 reuses of every free slot */
+typedef struct {
+    UserCallbackInfo *p_info;
+    uint32_t generation;
+    int nextFree;
+} TimedCallbackSlot;
+
+#define TIMED_CALLBACK_SLOT_BITS 12
+#define TIMED_CALLBACK_SLOT_MAX (1 << TIMED_CALLBACK_SLOT_BITS)
+#define TIMED_CALLBACK_GENERATION_MASK ((1U << (32 - TIMED_CALLBACK_SLOT_BITS)) - 1)
+
 
 /*******************************************************************/
 
@@ -153,13 +238,19 @@ static pthread_t s_tid_reader;
 static int s_started = 0;
 
 static int s_fdListen = -1;
-static int s_fdCommand = -1;
 static int s_fdDebug = -1;
 
 static int s_fdWakeupRead;
 static int s_fdWakeupWrite;
+static bool s_wakeupIsEventfd = false;
+
+/* Set by the first poster to write the wakeup fd and cleared by the
+   event loop before draining it, so concurrent posters collapse into
+   at most one write per loop iteration */
+static volatile int32_t s_wakeupPending = 0;
+static volatile int32_t s_wakeupRequests = 0;
+static volatile int32_t s_wakeupWrites = 0;
 
-static struct ril_event s_commands_event;
 static struct ril_event s_wakeupfd_event;
 static struct ril_event s_listen_event;
 static struct ril_event s_wake_timeout_event;
@@ -168,7 +259,38 @@ static struct ril_event s_debug_event;
 
 static const struct timeval TIMEVAL_WAKE_TIMEOUT = {1,0};
 
+/* Holds everything a dispatch function decodes from the request, and
+   is reset once onRequest returns. Event loop thread only */
+static uint64_t s_dispatchArenaBuffer[DISPATCH_ARENA_BYTES / sizeof(uint64_t)];
+static struct ril_arena s_dispatchArena
+    = RIL_ARENA_INITIALIZER(s_dispatchArenaBuffer, sizeof(s_dispatchArenaBuffer));
+
+typedef struct OutboundMessage {
+    struct OutboundMessage *p_next;
+    int unsolResponse;      // 0 for a solicited response
+    int requestNumber;      // of a solicited response, or 0
+    int64_t intakeUs;       // when that request was read
+    size_t size;            // frame size, length header included
+    uint8_t *frame;
+} OutboundMessage;
+
+typedef struct {
+    OutboundMessage *head;
+    OutboundMessage *tail;
+    int count;
+} OutboundQueue;
+
+static int s_outboundDropped = 0;
+static int s_outboundReplaced = 0;
+
 static pthread_mutex_t s_pendingRequestsMutex = PTHREAD_MUTEX_INITIALIZER;
+
+// RequestInfo is allocated on the dispatch thread and freed on whichever
+// thread completes the request; UserCallbackInfo is freed on the loop
+static struct ril_pool s_requestInfoPool
+    = RIL_POOL_INITIALIZER(RequestInfo, "RequestInfo");
+static struct ril_pool s_userCallbackPool
+    = RIL_POOL_INITIALIZER(UserCallbackInfo, "UserCallbackInfo");
 static pthread_mutex_t s_writeMutex = PTHREAD_MUTEX_INITIALIZER;
 static pthread_mutex_t s_startupMutex = PTHREAD_MUTEX_INITIALIZER;
 static pthread_cond_t s_startupCond = PTHREAD_COND_INITIALIZER;
@@ -176,18 +298,63 @@ static pthread_cond_t s_startupCond = PTHREAD_COND_INITIALIZER;
 static pthread_mutex_t s_dispatchMutex = PTHREAD_MUTEX_INITIALIZER;
 static pthread_cond_t s_dispatchCond = PTHREAD_COND_INITIALIZER;
 
-static RequestInfo *s_pendingRequests = NULL;
+/* Open-addressing set of outstanding requests, keyed by the RequestInfo
+   pointer that the vendor RIL gets as its RIL_Token. Linear probing with
+   backward-shift deletion, kept at most half full. Guarded by
+   s_pendingRequestsMutex */
+static RequestInfo **s_pendingRequests = NULL;
+static size_t s_pendingRequestsSize = 0;
+static int s_pendingRequestsShift = 32;     // 32 - log2(size)
+static size_t s_pendingRequestsCount = 0;
 
 static RequestInfo *s_toDispatchHead = NULL;
 static RequestInfo *s_toDispatchTail = NULL;
 
-static UserCallbackInfo *s_last_wake_timeout_info = NULL;
-
+/* References on the partial wake lock, which is held while there are
+   any, and the deadline until which s_wake_timeout_event keeps one.
+   Guarded by s_wakeLockMutex */
+static pthread_mutex_t s_wakeLockMutex = PTHREAD_MUTEX_INITIALIZER;
+static int s_wakeLockRefs = 0;
+static struct timeval s_wakeDeadline;
+static bool s_wakeTimerArmed = false;
+static int s_wakeLockGrabs = 0;
+static int s_wakeLockAcquisitions = 0;
+static int64_t s_wakeLockHeldSince;
+static int64_t s_wakeLockHeldMs = 0;
+
+static pthread_mutex_t s_timedCallbackMutex = PTHREAD_MUTEX_INITIALIZER;
+static TimedCallbackSlot *s_timedCallbackSlots = NULL;
+static int s_timedCallbackSlotsSize = 0;
+static int s_timedCallbackFreeSlot = -1;       // oldest free slot
+static int s_timedCallbackFreeTail = -1;       // newest free slot
+
+/* The last NITZ response sent, replayed to each client that connects or
+   subscribes to it later. Guarded by s_lastNITZMutex */
+static pthread_mutex_t s_lastNITZMutex = PTHREAD_MUTEX_INITIALIZER;
 static void *s_lastNITZTimeData = NULL;
 static size_t s_lastNITZTimeDataSize;
 
 #if RILC_LOG
     static char printBuf[PRINTBUF_SIZE];
+    static size_t printBufLen;
+
+/* Append to printBuf in place; formatting printBuf into itself is
+   undefined and rescans the whole buffer on every field */
+static void appendPrintBufImpl(const char *fmt, ...) {
+    va_list ap;
+    int n;
+
+    va_start(ap, fmt);
+    n = vsnprintf(printBuf + printBufLen, PRINTBUF_SIZE - printBufLen, fmt, ap);
+    va_end(ap);
+
+    if (n > 0) {
+        printBufLen += n;
+        if (printBufLen >= PRINTBUF_SIZE) {
+            printBufLen = PRINTBUF_SIZE - 1;
+        }
+    }
+}
 #endif
 
 /*******************************************************************/
@@ -237,6 +404,8 @@ static int responseSimRefresh(Parcel &p, void *response, size_t responselen);
 static int decodeVoiceRadioTechnology (RIL_RadioState radioState);
 static int decodeCdmaSubscriptionSource (RIL_RadioState radioState);
 static RIL_RadioState processRadioState(RIL_RadioState newRadioState);
+static bool isSubscribed(const uint32_t *mask, int unsolResponseIndex);
+static void sendLastNITZ(RilClient *client);
 
 extern "C" const char * requestToString(int request);
 extern "C" const char * failCauseToString(RIL_Errno);
@@ -250,17 +419,139 @@ extern "C" void RIL_onUnsolicitedResponse(int unsolResponse, void *data,
 
 static UserCallbackInfo * internalRequestTimedCallback
     (RIL_TimedCallback callback, void *param,
-        const struct timeval *relativeTime);
+        const struct timeval *relativeTime,
+        RIL_TimedCallbackHandle *pHandle);
+static int internalCancelTimedCallback(RIL_TimedCallbackHandle handle);
+
+static int sendResponseRaw (struct RilClient *client, uint32_t clientId,
+        const RequestInfo *pRI, const void *data, size_t dataSize);
+static void updateUnsolSubscribedLocked();
+static void onUnsolicitedResponse(struct RilClient *target, int unsolResponse,
+        void *data, size_t datalen);
 
-/** Index == requestNumber */
+/** Index == requestNumber; unused numbers have a requestNumber of 0 */
 static CommandInfo s_commands[] = {
+#define RIL_REQUEST_ENTRY(name, dispatch, response) \
+    {RIL_REQUEST_##name, #name, dispatch, response},
+#define RIL_REQUEST_UNUSED(number) \
+    {0, NULL, NULL, NULL},
+#include "ril_commands.h"
+#undef RIL_REQUEST_ENTRY
+#undef RIL_REQUEST_UNUSED
+};
+
+/* Where each line of ril_commands.h landed in s_commands */
+enum {
+#define RIL_REQUEST_ENTRY(name, dispatch, response) REQUEST_INDEX_##name,
+#define RIL_REQUEST_UNUSED(number) REQUEST_INDEX_UNUSED_##number,
+#include "ril_commands.h"
+#undef RIL_REQUEST_ENTRY
+#undef RIL_REQUEST_UNUSED
+};
+
+#define RIL_REQUEST_ENTRY(name, dispatch, response) \
+    RIL_COMPILE_ASSERT(RIL_REQUEST_##name == REQUEST_INDEX_##name, \
+            ril_commands_h_##name##_out_of_place);
+#define RIL_REQUEST_UNUSED(number) \
+    RIL_COMPILE_ASSERT(number == REQUEST_INDEX_UNUSED_##number, \
+            ril_commands_h_##number##_out_of_place);
 #include "ril_commands.h"
+#undef RIL_REQUEST_ENTRY
+#undef RIL_REQUEST_UNUSED
+
+/* Points in a request's life, each timed from when it was read */
+enum RequestPhase {
+    REQUEST_DISPATCHED,     // decoded, and onRequest has returned
+    REQUEST_COMPLETED,      // RIL_onRequestComplete called
+    REQUEST_WRITTEN,        // response written to the command socket
+    REQUEST_PHASES
 };
 
+/* Where the time goes for one request number, in microseconds */
+typedef struct {
+    struct ril_histogram latency_us[REQUEST_PHASES];
+    volatile uint32_t errors;
+} RequestStats;
+
+/* Indexed like s_commands, allocated on first use */
+static RequestStats * volatile s_requestStats[NUM_ELEMS(s_commands)];
+
+/* Completions by RIL_Errno; the last counts any other value */
+#define ERRNO_STATS (RIL_E_ILLEGAL_SIM_OR_ME + 2)
+static volatile uint32_t s_errnoCounts[ERRNO_STATS];
+
+/** Index == requestNumber - RIL_UNSOL_RESPONSE_BASE */
 static UnsolResponseInfo s_unsolResponses[] = {
+#define RIL_UNSOL_ENTRY(name, response, wake, outbound, coalesce) \
+    {RIL_UNSOL_##name, "UNSOL_" #name, response, wake, outbound, coalesce},
+#include "ril_unsol_commands.h"
+#undef RIL_UNSOL_ENTRY
+};
+
+/* Where each line of ril_unsol_commands.h landed in s_unsolResponses */
+enum {
+#define RIL_UNSOL_ENTRY(name, response, wake, outbound, coalesce) UNSOL_INDEX_##name,
 #include "ril_unsol_commands.h"
+#undef RIL_UNSOL_ENTRY
 };
 
+#define RIL_UNSOL_ENTRY(name, response, wake, outbound, coalesce) \
+    RIL_COMPILE_ASSERT(RIL_UNSOL_##name - RIL_UNSOL_RESPONSE_BASE == UNSOL_INDEX_##name, \
+            ril_unsol_commands_h_##name##_out_of_place);
+#include "ril_unsol_commands.h"
+#undef RIL_UNSOL_ENTRY
+
+typedef struct {
+    int64_t lastSent;       // elapsedRealtime() when one last went out
+    void *held;             // marshalled response waiting for the window
+    size_t heldSize;
+    int suppressed;         // responses replaced before they were sent
+} CoalesceState;
+
+/* Per unsolicited response, indexed like s_unsolResponses. Guarded by
+   s_coalesceMutex */
+static CoalesceState s_coalesceState[NUM_ELEMS(s_unsolResponses)];
+static pthread_mutex_t s_coalesceMutex = PTHREAD_MUTEX_INITIALIZER;
+static int s_collapseWindowMs = DEFAULT_UNSOL_COLLAPSE_MS;
+static int s_minIntervalMs = DEFAULT_UNSOL_MIN_INTERVAL_MS;
+
+#define UNSOL_MASK_WORDS ((NUM_ELEMS(s_unsolResponses) + 31) / 32)
+
+/* One connection on the command socket. The socket and record stream
+   belong to the event loop; everything else is guarded by s_writeMutex,
+   which is never held across a blocking call */
+typedef struct RilClient {
+    // 0 while the slot is free. Each connection gets a new one, so
+    // responses for a closed connection are not sent to a later one
+    volatile uint32_t id;
+    int fd;
+    RecordStream *p_rs;
+    struct ril_event commandsEvent;
+    bool isPhone;
+
+    // unsolicited responses it receives, by index in s_unsolResponses
+    uint32_t unsolMask[UNSOL_MASK_WORDS];
+
+    // Messages for the socket. They are written without blocking,
+    // straight away if the socket takes them and otherwise by the event
+    // loop once it is writable; solicited responses go first.
+    OutboundQueue solicitedQueue;
+    OutboundQueue unsolicitedQueue;
+    OutboundMessage *outboundPartial;   // frame cut short by the socket
+    size_t outboundOffset;              // bytes of it already written
+    int fdWrite;                        // dup of fd watched by writerEvent
+    struct ril_event writerEvent;
+    bool writerArmed;
+    bool outboundBehind;
+} RilClient;
+
+static RilClient s_clients[MAX_CLIENTS];
+static uint32_t s_nextClientId = 0;
+
+/* Union of the clients' unsolMasks, so that a response nobody wants is
+   not even marshalled. Guarded by s_writeMutex */
+static uint32_t s_unsolSubscribed[UNSOL_MASK_WORDS];
+
 /* For older RILs that do not support new commands RIL_REQUEST_VOICE_RADIO_TECH and
    RIL_UNSOL_VOICE_RADIO_TECH_CHANGED messages, decode the voice radio tech from
    radio state message and store it. Every time there is a change in Radio State
@@ -281,19 +572,58 @@ int cdmaSubscriptionSource = -1;
  */
 int simRuimStatus = -1;
 
+/**
+ * Reads a string into the dispatch arena; it lives until the dispatch
+ * function returns
+ */
 static char *
-strdupReadString(Parcel &p) {
+arenaReadString(Parcel &p) {
     size_t stringlen;
     const char16_t *s16;
+    char *s8;
 
     s16 = p.readString16Inplace(&stringlen);
+    if (s16 == NULL) {
+        return NULL;
+    }
+
+    // ASCII narrows straight into the arena; UTF-8 needs at least as
+    // many bytes, so a failed attempt only leaves the space too small
+    s8 = (char *) ril_arena_alloc(&s_dispatchArena, stringlen + 1);
+    if (s8 == NULL) {
+        return NULL;
+    }
+    if (ril_ascii_narrow(s8, (const uint16_t *) s16, stringlen)) {
+        s8[stringlen] = '\0';
+        return s8;
+    }
 
-    return strndup16to8(s16, stringlen);
+    s8 = (char *) ril_arena_alloc(&s_dispatchArena, strnlen16to8(s16, stringlen) + 1);
+    if (s8 == NULL) {
+        return NULL;
+    }
+    return strncpy16to8(s8, s16, stringlen);
 }
 
 static void writeStringToParcel(Parcel &p, const char *s) {
     char16_t *s16;
     size_t s16_len;
+
+    // ASCII widens straight into the parcel, laid out as writeString16 would
+    if (s != NULL) {
+        size_t len = strlen(s);
+
+        if (ril_is_ascii(s, len)) {
+            p.writeInt32(len);
+            s16 = (char16_t *) p.writeInplace((len + 1) * sizeof(char16_t));
+            if (s16 != NULL) {
+                ril_ascii_widen((uint16_t *) s16, s, len);
+                s16[len] = 0;
+            }
+            return;
+        }
+    }
+
     s16 = strdup8to16(s, &s16_len);
     p.writeString16(s16, s16_len);
     free(s16);
@@ -301,18 +631,146 @@ static void writeStringToParcel(Parcel &p, const char *s) {
 
 
 static void
-memsetString (char *s) {
-    if (s != NULL) {
-        memset (s, 0, strlen(s));
-    }
-}
-
-void   nullParcelReleaseFunction (const uint8_t* data, size_t dataSize,
+nullParcelReleaseFunction (Parcel* parcel, const uint8_t* data, size_t dataSize,
                                     const size_t* objects, size_t objectsSize,
                                         void* cookie) {
     // do nothing -- the data reference lives longer than the Parcel object
 }
 
+/* Slot for pRI in a table of 2^(32 - shift) entries. Fibonacci hashing
+   takes the top bits of the product, which depend on every bit of the
+   pointer; its low bits would only permute the pointer's own low bits.
+   Heap pointers are 8-byte aligned, so those bits are dropped first */
+static size_t
+pendingRequestHash(RequestInfo *pRI, int shift) {
+    return (size_t) ((uint32_t) ((uint32_t) ((uintptr_t) pRI >> 3) * 2654435761U) >> shift);
+}
+
+/** Called with s_pendingRequestsMutex held */
+static bool
+growPendingRequests() {
+    size_t size = (s_pendingRequestsSize == 0) ? 16 : s_pendingRequestsSize * 2;
+    int shift = (s_pendingRequestsSize == 0) ? 28 : s_pendingRequestsShift - 1;
+    RequestInfo **table;
+
+    table = (RequestInfo **) calloc(size, sizeof(RequestInfo *));
+    if (table == NULL) {
+        return false;
+    }
+
+    for (size_t i = 0; i < s_pendingRequestsSize; i++) {
+        RequestInfo *pRI = s_pendingRequests[i];
+
+        if (pRI != NULL) {
+            size_t j = pendingRequestHash(pRI, shift);
+            while (table[j] != NULL) {
+                j = (j + 1) & (size - 1);
+            }
+            table[j] = pRI;
+        }
+    }
+
+    free(s_pendingRequests);
+    s_pendingRequests = table;
+    s_pendingRequestsSize = size;
+    s_pendingRequestsShift = shift;
+    return true;
+}
+
+/**
+ * Track pRI as outstanding. Returns false if out of memory, in which
+ * case the request cannot be handed to the vendor RIL.
+ */
+static bool
+addPendingRequest(RequestInfo *pRI) {
+    int ret;
+    bool added = true;
+
+    ret = pthread_mutex_lock(&s_pendingRequestsMutex);
+    assert (ret == 0);
+
+    if ((s_pendingRequestsCount + 1) * 2 > s_pendingRequestsSize
+            && !growPendingRequests()) {
+        added = false;
+    } else {
+        size_t mask = s_pendingRequestsSize - 1;
+        size_t i = pendingRequestHash(pRI, s_pendingRequestsShift);
+
+        while (s_pendingRequests[i] != NULL) {
+            i = (i + 1) & mask;
+        }
+        s_pendingRequests[i] = pRI;
+        s_pendingRequestsCount++;
+    }
+
+    ret = pthread_mutex_unlock(&s_pendingRequestsMutex);
+    assert (ret == 0);
+
+    return added;
+}
+
+static int64_t
+nowUs() {
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t) ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+/**
+ * Stats for a request number, or NULL if out of memory
+ */
+static RequestStats *
+requestStats(int request) {
+    RequestStats *stats = s_requestStats[request];
+
+    if (stats == NULL) {
+        RequestStats *fresh = (RequestStats *) calloc(1, sizeof(RequestStats));
+
+        if (fresh == NULL) {
+            return NULL;
+        }
+        stats = __sync_val_compare_and_swap(&s_requestStats[request],
+                (RequestStats *) NULL, fresh);
+        if (stats == NULL) {
+            stats = fresh;
+        } else {
+            free(fresh);
+        }
+    }
+    return stats;
+}
+
+/**
+ * Record the time from intakeUs to a phase of a request
+ */
+static void
+recordRequestLatency(int request, RequestPhase phase, int64_t intakeUs) {
+    RequestStats *stats = requestStats(request);
+    int64_t us = nowUs() - intakeUs;
+
+    if (stats == NULL) {
+        return;
+    }
+    if (us < 0) {
+        us = 0;
+    } else if (us > 0xffffffffLL) {
+        us = 0xffffffffLL;
+    }
+    ril_histogram_record(&stats->latency_us[phase], (uint32_t) us);
+}
+
+static void
+recordRequestErrno(int request, RIL_Errno e) {
+    int index = (e >= RIL_E_SUCCESS && e < ERRNO_STATS - 1) ? e : ERRNO_STATS - 1;
+    RequestStats *stats;
+
+    __sync_fetch_and_add(&s_errnoCounts[index], 1);
+    if (e != RIL_E_SUCCESS && (stats = requestStats(request)) != NULL) {
+        __sync_fetch_and_add(&stats->errors, 1);
+    }
+}
+
 /**
  * To be called from dispatch thread
  * Issue a single local request, ensuring that the response
@@ -321,40 +779,91 @@ void   nullParcelReleaseFunction (const uint8_t* data, size_t dataSize,
 static void
 issueLocalRequest(int request, void *data, int len) {
     RequestInfo *pRI;
-    int ret;
 
-    pRI = (RequestInfo *)calloc(1, sizeof(RequestInfo));
+    pRI = (RequestInfo *)ril_pool_alloc(&s_requestInfoPool);
+    if (pRI == NULL) {
+        ALOGE("out of memory issuing local %s", requestToString(request));
+        return;
+    }
 
     pRI->local = 1;
     pRI->token = 0xffffffff;        // token is not used in this context
     pRI->pCI = &(s_commands[request]);
+    pRI->intakeUs = nowUs();
 
-    ret = pthread_mutex_lock(&s_pendingRequestsMutex);
-    assert (ret == 0);
-
-    pRI->p_next = s_pendingRequests;
-    s_pendingRequests = pRI;
-
-    ret = pthread_mutex_unlock(&s_pendingRequestsMutex);
-    assert (ret == 0);
+    if (!addPendingRequest(pRI)) {
+        ALOGE("out of memory issuing local %s", requestToString(request));
+        ril_pool_free(&s_requestInfoPool, pRI);
+        return;
+    }
 
-    ALOGD("C[locl]> %s", requestToString(request));
+    RIL_trace(RIL_TRACE_LOCAL_REQUEST, request, 0, 0);
 
     s_callbacks.onRequest(request, data, len, pRI);
 }
 
 
 
+/**
+ * RIL_REQUEST_SET_UNSOLICITED_SUBSCRIPTIONS, which libril answers itself
+ */
+static void
+setUnsolicitedSubscriptions(RilClient *client, Parcel &p, int32_t token) {
+    uint32_t mask[UNSOL_MASK_WORDS];
+    int32_t count;
+    int32_t word;
+    RIL_Errno e = RIL_E_SUCCESS;
+    Parcel reply;
+    const int nitzIndex = RIL_UNSOL_NITZ_TIME_RECEIVED - RIL_UNSOL_RESPONSE_BASE;
+    bool newNITZ = false;
+
+    memset(mask, 0, sizeof(mask));
+    if (p.readInt32(&count) != NO_ERROR || count < 0
+            || (size_t) count > p.dataAvail() / sizeof(int32_t)) {
+        e = RIL_E_GENERIC_FAILURE;
+    } else {
+        for (int32_t i = 0; i < count; i++) {
+            p.readInt32(&word);
+            if (i < (int32_t) UNSOL_MASK_WORDS) {
+                mask[i] = (uint32_t) word;
+            }
+        }
+    }
+
+    if (e == RIL_E_SUCCESS) {
+        pthread_mutex_lock(&s_writeMutex);
+        newNITZ = !isSubscribed(client->unsolMask, nitzIndex) && isSubscribed(mask, nitzIndex);
+        memcpy(client->unsolMask, mask, sizeof(mask));
+        updateUnsolSubscribedLocked();
+        pthread_mutex_unlock(&s_writeMutex);
+    }
+
+    reply.writeInt32 (RESPONSE_SOLICITED);
+    reply.writeInt32 (token);
+    reply.writeInt32 (e);
+    sendResponseRaw(client, client->id, NULL, reply.data(), reply.dataSize());
+
+    // A client that has just subscribed to NITZ may have missed the last one
+    if (newNITZ) {
+        sendLastNITZ(client);
+    }
+}
+
 static int
-processCommandBuffer(void *buffer, size_t buflen) {
+processCommandBuffer(RilClient *client, void *buffer, size_t buflen) {
     Parcel p;
     status_t status;
     int32_t request;
     int32_t token;
     RequestInfo *pRI;
-    int ret;
 
-    p.setData((uint8_t *) buffer, buflen);
+    ril_capture_record(RIL_CAPTURE_IN, client->id, buffer, buflen);
+
+    // Read the request in place: the record stays valid until the next
+    // record_stream_get_next(), and request data handed to the vendor RIL
+    // is only valid for the duration of onRequest anyway
+    p.ipcSetDataReference((const uint8_t *) buffer, buflen, NULL, 0,
+            nullParcelReleaseFunction, NULL);
 
     // status checked at end
     status = p.readInt32(&request);
@@ -365,30 +874,51 @@ processCommandBuffer(void *buffer, size_t buflen) {
         return 0;
     }
 
-    if (request < 1 || request >= (int32_t)NUM_ELEMS(s_commands)) {
+    if (request == RIL_REQUEST_SET_UNSOLICITED_SUBSCRIPTIONS) {
+        setUnsolicitedSubscriptions(client, p, token);
+        return 0;
+    }
+
+    if (request < 1 || request >= (int32_t)NUM_ELEMS(s_commands)
+            || s_commands[request].dispatchFunction == NULL) {
         ALOGE("unsupported request code %d token %d", request, token);
         // FIXME this should perhaps return a response
         return 0;
     }
 
 
-    pRI = (RequestInfo *)calloc(1, sizeof(RequestInfo));
+    pRI = (RequestInfo *)ril_pool_alloc(&s_requestInfoPool);
+    if (pRI == NULL) {
+        ALOGE("out of memory for request %d token %d", request, token);
+        return 0;
+    }
 
     pRI->token = token;
     pRI->pCI = &(s_commands[request]);
+    pRI->client = client;
+    pRI->clientId = client->id;
+    pRI->intakeUs = nowUs();
 
-    ret = pthread_mutex_lock(&s_pendingRequestsMutex);
-    assert (ret == 0);
-
-    pRI->p_next = s_pendingRequests;
-    s_pendingRequests = pRI;
-
-    ret = pthread_mutex_unlock(&s_pendingRequestsMutex);
-    assert (ret == 0);
+    if (!addPendingRequest(pRI)) {
+        ALOGE("out of memory for request %d token %d", request, token);
+        ril_pool_free(&s_requestInfoPool, pRI);
+        return 0;
+    }
 
 /*    sLastDispatchedToken = token; */
 
+    RIL_trace(RIL_TRACE_REQUEST, token, request, 0);
+
+    // pRI may be gone once this returns, if the request completed inline
+    int64_t intakeUs = pRI->intakeUs;
     pRI->pCI->dispatchFunction(p, pRI);
+    recordRequestLatency(request, REQUEST_DISPATCHED, intakeUs);
+
+#ifdef MEMSET_FREED
+    ril_arena_reset(&s_dispatchArena, true);
+#else
+    ril_arena_reset(&s_dispatchArena, false);
+#endif
 
     return 0;
 }
@@ -410,30 +940,15 @@ dispatchVoid (Parcel& p, RequestInfo *pRI) {
 /** Callee expects const char * */
 static void
 dispatchString (Parcel& p, RequestInfo *pRI) {
-    status_t status;
-    size_t datalen;
-    size_t stringlen;
-    char *string8 = NULL;
-
-    string8 = strdupReadString(p);
+    char *string8 = arenaReadString(p);
 
     startRequest;
-    appendPrintBuf("%s%s", printBuf, string8);
+    appendPrintBuf("%s", string8);
     closeRequest;
     printRequest(pRI->token, pRI->pCI->requestNumber);
 
     s_callbacks.onRequest(pRI->pCI->requestNumber, string8,
                        sizeof(char *), pRI);
-
-#ifdef MEMSET_FREED
-    memsetString(string8);
-#endif
-
-    free(string8);
-    return;
-invalid:
-    invalidCommandBlock(pRI);
-    return;
 }
 
 /** Callee expects const char ** */
@@ -453,19 +968,27 @@ dispatchStrings (Parcel &p, RequestInfo *pRI) {
     startRequest;
     if (countStrings == 0) {
         // just some non-null pointer
-        pStrings = (char **)alloca(sizeof(char *));
+        pStrings = (char **)ril_arena_alloc(&s_dispatchArena, sizeof(char *));
         datalen = 0;
     } else if (((int)countStrings) == -1) {
         pStrings = NULL;
         datalen = 0;
     } else {
+        // every string takes at least a word of the request
+        if (countStrings < 0
+                || (size_t) countStrings > p.dataAvail() / sizeof(int32_t)) {
+            goto invalid;
+        }
         datalen = sizeof(char *) * countStrings;
 
-        pStrings = (char **)alloca(datalen);
+        pStrings = (char **)ril_arena_alloc(&s_dispatchArena, datalen);
+        if (pStrings == NULL) {
+            goto invalid;
+        }
 
         for (int i = 0 ; i < countStrings ; i++) {
-            pStrings[i] = strdupReadString(p);
-            appendPrintBuf("%s%s,", printBuf, pStrings[i]);
+            pStrings[i] = arenaReadString(p);
+            appendPrintBuf("%s,", pStrings[i]);
         }
     }
     removeLastChar;
@@ -474,19 +997,6 @@ dispatchStrings (Parcel &p, RequestInfo *pRI) {
 
     s_callbacks.onRequest(pRI->pCI->requestNumber, pStrings, datalen, pRI);
 
-    if (pStrings != NULL) {
-        for (int i = 0 ; i < countStrings ; i++) {
-#ifdef MEMSET_FREED
-            memsetString (pStrings[i]);
-#endif
-            free(pStrings[i]);
-        }
-
-#ifdef MEMSET_FREED
-        memset(pStrings, 0, datalen);
-#endif
-    }
-
     return;
 invalid:
     invalidCommandBlock(pRI);
@@ -503,12 +1013,16 @@ dispatchInts (Parcel &p, RequestInfo *pRI) {
 
     status = p.readInt32 (&count);
 
-    if (status != NO_ERROR || count == 0) {
+    if (status != NO_ERROR || count <= 0
+            || (size_t) count > p.dataAvail() / sizeof(int32_t)) {
         goto invalid;
     }
 
     datalen = sizeof(int) * count;
-    pInts = (int *)alloca(datalen);
+    pInts = (int *)ril_arena_alloc(&s_dispatchArena, datalen);
+    if (pInts == NULL) {
+        goto invalid;
+    }
 
     startRequest;
     for (int i = 0 ; i < count ; i++) {
@@ -516,7 +1030,7 @@ dispatchInts (Parcel &p, RequestInfo *pRI) {
 
         status = p.readInt32(&t);
         pInts[i] = (int)t;
-        appendPrintBuf("%s%d,", printBuf, t);
+        appendPrintBuf("%d,", t);
 
         if (status != NO_ERROR) {
             goto invalid;
@@ -529,10 +1043,6 @@ dispatchInts (Parcel &p, RequestInfo *pRI) {
    s_callbacks.onRequest(pRI->pCI->requestNumber, const_cast<int *>(pInts),
                        datalen, pRI);
 
-#ifdef MEMSET_FREED
-    memset(pInts, 0, datalen);
-#endif
-
     return;
 invalid:
     invalidCommandBlock(pRI);
@@ -557,28 +1067,22 @@ dispatchSmsWrite (Parcel &p, RequestInfo *pRI) {
     status = p.readInt32(&t);
     args.status = (int)t;
 
-    args.pdu = strdupReadString(p);
+    args.pdu = arenaReadString(p);
 
     if (status != NO_ERROR || args.pdu == NULL) {
         goto invalid;
     }
 
-    args.smsc = strdupReadString(p);
+    args.smsc = arenaReadString(p);
 
     startRequest;
-    appendPrintBuf("%s%d,%s,smsc=%s", printBuf, args.status,
+    appendPrintBuf("%d,%s,smsc=%s", args.status,
         (char*)args.pdu,  (char*)args.smsc);
     closeRequest;
     printRequest(pRI->token, pRI->pCI->requestNumber);
 
     s_callbacks.onRequest(pRI->pCI->requestNumber, &args, sizeof(args), pRI);
 
-#ifdef MEMSET_FREED
-    memsetString (args.pdu);
-#endif
-
-    free (args.pdu);
-
 #ifdef MEMSET_FREED
     memset(&args, 0, sizeof(args));
 #endif
@@ -606,7 +1110,7 @@ dispatchDial (Parcel &p, RequestInfo *pRI) {
 
     memset (&dial, 0, sizeof(dial));
 
-    dial.address = strdupReadString(p);
+    dial.address = arenaReadString(p);
 
     status = p.readInt32(&t);
     dial.clir = (int)t;
@@ -658,9 +1162,9 @@ dispatchDial (Parcel &p, RequestInfo *pRI) {
     }
 
     startRequest;
-    appendPrintBuf("%snum=%s,clir=%d", printBuf, dial.address, dial.clir);
+    appendPrintBuf("num=%s,clir=%d", dial.address, dial.clir);
     if (uusPresent) {
-        appendPrintBuf("%s,uusType=%d,uusDcs=%d,uusLen=%d", printBuf,
+        appendPrintBuf(",uusType=%d,uusDcs=%d,uusLen=%d",
                 dial.uusInfo->uusType, dial.uusInfo->uusDcs,
                 dial.uusInfo->uusLength);
     }
@@ -669,12 +1173,6 @@ dispatchDial (Parcel &p, RequestInfo *pRI) {
 
     s_callbacks.onRequest(pRI->pCI->requestNumber, &dial, sizeOfDial, pRI);
 
-#ifdef MEMSET_FREED
-    memsetString (dial.address);
-#endif
-
-    free (dial.address);
-
 #ifdef MEMSET_FREED
     memset(&uusInfo, 0, sizeof(RIL_UUS_Info));
     memset(&dial, 0, sizeof(dial));
@@ -718,7 +1216,7 @@ dispatchSIM_IO (Parcel &p, RequestInfo *pRI) {
     status = p.readInt32(&t);
     simIO.v6.fileid = (int)t;
 
-    simIO.v6.path = strdupReadString(p);
+    simIO.v6.path = arenaReadString(p);
 
     status = p.readInt32(&t);
     simIO.v6.p1 = (int)t;
@@ -729,12 +1227,12 @@ dispatchSIM_IO (Parcel &p, RequestInfo *pRI) {
     status = p.readInt32(&t);
     simIO.v6.p3 = (int)t;
 
-    simIO.v6.data = strdupReadString(p);
-    simIO.v6.pin2 = strdupReadString(p);
-    simIO.v6.aidPtr = strdupReadString(p);
+    simIO.v6.data = arenaReadString(p);
+    simIO.v6.pin2 = arenaReadString(p);
+    simIO.v6.aidPtr = arenaReadString(p);
 
     startRequest;
-    appendPrintBuf("%scmd=0x%X,efid=0x%X,path=%s,%d,%d,%d,%s,pin2=%s,aid=%s", printBuf,
+    appendPrintBuf("cmd=0x%X,efid=0x%X,path=%s,%d,%d,%d,%s,pin2=%s,aid=%s",
         simIO.v6.command, simIO.v6.fileid, (char*)simIO.v6.path,
         simIO.v6.p1, simIO.v6.p2, simIO.v6.p3,
         (char*)simIO.v6.data,  (char*)simIO.v6.pin2, simIO.v6.aidPtr);
@@ -748,18 +1246,6 @@ dispatchSIM_IO (Parcel &p, RequestInfo *pRI) {
     size = (s_callbacks.version < 6) ? sizeof(simIO.v5) : sizeof(simIO.v6);
     s_callbacks.onRequest(pRI->pCI->requestNumber, &simIO, size, pRI);
 
-#ifdef MEMSET_FREED
-    memsetString (simIO.v6.path);
-    memsetString (simIO.v6.data);
-    memsetString (simIO.v6.pin2);
-    memsetString (simIO.v6.aidPtr);
-#endif
-
-    free (simIO.v6.path);
-    free (simIO.v6.data);
-    free (simIO.v6.pin2);
-    free (simIO.v6.aidPtr);
-
 #ifdef MEMSET_FREED
     memset(&simIO, 0, sizeof(simIO));
 #endif
@@ -802,7 +1288,7 @@ dispatchCallForward(Parcel &p, RequestInfo *pRI) {
     status = p.readInt32(&t);
     cff.toa = (int)t;
 
-    cff.number = strdupReadString(p);
+    cff.number = arenaReadString(p);
 
     status = p.readInt32(&t);
     cff.timeSeconds = (int)t;
@@ -818,7 +1304,7 @@ dispatchCallForward(Parcel &p, RequestInfo *pRI) {
     }
 
     startRequest;
-    appendPrintBuf("%sstat=%d,reason=%d,serv=%d,toa=%d,%s,tout=%d", printBuf,
+    appendPrintBuf("stat=%d,reason=%d,serv=%d,toa=%d,%s,tout=%d",
         cff.status, cff.reason, cff.serviceClass, cff.toa,
         (char*)cff.number, cff.timeSeconds);
     closeRequest;
@@ -826,12 +1312,6 @@ dispatchCallForward(Parcel &p, RequestInfo *pRI) {
 
     s_callbacks.onRequest(pRI->pCI->requestNumber, &cff, sizeof(cff), pRI);
 
-#ifdef MEMSET_FREED
-    memsetString(cff.number);
-#endif
-
-    free (cff.number);
-
 #ifdef MEMSET_FREED
     memset(&cff, 0, sizeof(cff));
 #endif
@@ -864,7 +1344,7 @@ dispatchRaw(Parcel &p, RequestInfo *pRI) {
     data = p.readInplace(len);
 
     startRequest;
-    appendPrintBuf("%sraw_size=%d", printBuf, len);
+    appendPrintBuf("raw_size=%d", len);
     closeRequest;
     printRequest(pRI->token, pRI->pCI->requestNumber);
 
@@ -946,9 +1426,9 @@ dispatchCdmaSms(Parcel &p, RequestInfo *pRI) {
     }
 
     startRequest;
-    appendPrintBuf("%suTeleserviceID=%d, bIsServicePresent=%d, uServicecategory=%d, \
+    appendPrintBuf("uTeleserviceID=%d, bIsServicePresent=%d, uServicecategory=%d, \
             sAddress.digit_mode=%d, sAddress.Number_mode=%d, sAddress.number_type=%d, ",
-            printBuf, rcsm.uTeleserviceID,rcsm.bIsServicePresent,rcsm.uServicecategory,
+            rcsm.uTeleserviceID,rcsm.bIsServicePresent,rcsm.uServicecategory,
             rcsm.sAddress.digit_mode, rcsm.sAddress.number_mode,rcsm.sAddress.number_type);
     closeRequest;
 
@@ -987,8 +1467,8 @@ dispatchCdmaSmsAck(Parcel &p, RequestInfo *pRI) {
     }
 
     startRequest;
-    appendPrintBuf("%suErrorClass=%d, uTLStatus=%d, ",
-            printBuf, rcsa.uErrorClass, rcsa.uSMSCauseCode);
+    appendPrintBuf("uErrorClass=%d, uTLStatus=%d, ",
+            rcsa.uErrorClass, rcsa.uSMSCauseCode);
     closeRequest;
 
     printRequest(pRI->token, pRI->pCI->requestNumber);
@@ -1040,8 +1520,8 @@ dispatchGsmBrSmsCnf(Parcel &p, RequestInfo *pRI) {
             status = p.readInt32(&t);
             gsmBci[i].selected = (uint8_t) t;
 
-            appendPrintBuf("%s [%d: fromServiceId=%d, toServiceId =%d, \
-                  fromCodeScheme=%d, toCodeScheme=%d, selected =%d]", printBuf, i,
+            appendPrintBuf(" [%d: fromServiceId=%d, toServiceId =%d, \
+                  fromCodeScheme=%d, toCodeScheme=%d, selected =%d]", i,
                   gsmBci[i].fromServiceId, gsmBci[i].toServiceId,
                   gsmBci[i].fromCodeScheme, gsmBci[i].toCodeScheme,
                   gsmBci[i].selected);
@@ -1098,8 +1578,8 @@ dispatchCdmaBrSmsCnf(Parcel &p, RequestInfo *pRI) {
             status = p.readInt32(&t);
             cdmaBci[i].selected = (uint8_t) t;
 
-            appendPrintBuf("%s [%d: service_category=%d, language =%d, \
-                  entries.bSelected =%d]", printBuf, i, cdmaBci[i].service_category,
+            appendPrintBuf(" [%d: service_category=%d, language =%d, \
+                  entries.bSelected =%d]", i, cdmaBci[i].service_category,
                   cdmaBci[i].language, cdmaBci[i].selected);
         }
         closeRequest;
@@ -1195,11 +1675,11 @@ static void dispatchRilCdmaSmsWriteArgs(Parcel &p, RequestInfo *pRI) {
     }
 
     startRequest;
-    appendPrintBuf("%sstatus=%d, message.uTeleserviceID=%d, message.bIsServicePresent=%d, \
+    appendPrintBuf("status=%d, message.uTeleserviceID=%d, message.bIsServicePresent=%d, \
             message.uServicecategory=%d, message.sAddress.digit_mode=%d, \
             message.sAddress.number_mode=%d, \
             message.sAddress.number_type=%d, ",
-            printBuf, rcsw.status, rcsw.message.uTeleserviceID, rcsw.message.bIsServicePresent,
+            rcsw.status, rcsw.message.uTeleserviceID, rcsw.message.bIsServicePresent,
             rcsw.message.uServicecategory, rcsw.message.sAddress.digit_mode,
             rcsw.message.sAddress.number_mode,
             rcsw.message.sAddress.number_type);
@@ -1303,76 +1783,458 @@ static void dispatchCdmaSubscriptionSource(Parcel& p, RequestInfo *pRI) {
         RIL_onRequestComplete(pRI, RIL_E_SUCCESS, &cdmaSubscriptionSource, sizeof(int));
 }
 
-static int
-blockingWrite(int fd, const void *buffer, size_t len) {
-    size_t writeOffset = 0;
-    const uint8_t *toWrite;
+static void rilEventAddWakeup(struct ril_event *ev);
 
-    toWrite = (const uint8_t *)buffer;
+static void
+pushOutbound(OutboundQueue *q, OutboundMessage *msg) {
+    msg->p_next = NULL;
+    if (q->tail == NULL) {
+        q->head = msg;
+    } else {
+        q->tail->p_next = msg;
+    }
+    q->tail = msg;
+    q->count++;
+}
 
-    while (writeOffset < len) {
-        ssize_t written;
-        do {
-            written = write (fd, toWrite + writeOffset,
-                                len - writeOffset);
-        } while (written < 0 && errno == EINTR);
+static OutboundMessage *
+popOutbound(OutboundQueue *q) {
+    OutboundMessage *msg = q->head;
 
-        if (written >= 0) {
-            writeOffset += written;
-        } else {   // written < 0
-            ALOGE ("RIL Response: unexpected error on write errno:%d", errno);
-            close(fd);
-            return -1;
+    if (msg != NULL) {
+        q->head = msg->p_next;
+        if (q->head == NULL) {
+            q->tail = NULL;
         }
+        q->count--;
     }
-
-    return 0;
+    return msg;
 }
 
-static int
-sendResponseRaw (const void *data, size_t dataSize) {
-    int fd = s_fdCommand;
-    int ret;
-    uint32_t header;
+/**
+ * Free a message that has been written in full to client. This is
+ * where outbound traffic is captured, so a capture holds exactly what
+ * the client was sent, stamped with when the write finished; messages
+ * dropped or replaced in the queue never appear.
+ */
+static void
+retireOutbound(RilClient *client, OutboundMessage *msg) {
+    ril_capture_record(RIL_CAPTURE_OUT, client->id, msg->frame + sizeof(uint32_t),
+            msg->size - sizeof(uint32_t));
 
-    if (s_fdCommand < 0) {
-        return -1;
+    if (msg->requestNumber != 0) {
+        recordRequestLatency(msg->requestNumber, REQUEST_WRITTEN, msg->intakeUs);
     }
+    free(msg);
+}
 
-    if (dataSize > MAX_COMMAND_BYTES) {
-        ALOGE("RIL: packet larger than %u (%u)",
-                MAX_COMMAND_BYTES, (unsigned int )dataSize);
+/** Called with s_writeMutex held */
+static void
+discardOutboundLocked(RilClient *client) {
+    OutboundMessage *msg;
 
-        return -1;
+    while ((msg = popOutbound(&client->solicitedQueue)) != NULL) {
+        free(msg);
     }
+    while ((msg = popOutbound(&client->unsolicitedQueue)) != NULL) {
+        free(msg);
+    }
+    free(client->outboundPartial);
+    client->outboundPartial = NULL;
+    client->outboundOffset = 0;
+    client->outboundBehind = false;
+}
 
-    pthread_mutex_lock(&s_writeMutex);
-
-    header = htonl(dataSize);
-
-    ret = blockingWrite(fd, (void *)&header, sizeof(header));
+/**
+ * Retire written bytes, in the order flushOutboundLocked gathered them.
+ * Called with s_writeMutex held.
+ */
+static void
+consumeOutboundLocked(RilClient *client, size_t written) {
+    if (client->outboundPartial != NULL) {
+        size_t left = client->outboundPartial->size - client->outboundOffset;
 
-    if (ret < 0) {
-        pthread_mutex_unlock(&s_writeMutex);
-        return ret;
+        if (written < left) {
+            client->outboundOffset += written;
+            return;
+        }
+        written -= left;
+        retireOutbound(client, client->outboundPartial);
+        client->outboundPartial = NULL;
+        client->outboundOffset = 0;
     }
 
-    ret = blockingWrite(fd, data, dataSize);
+    while (written > 0) {
+        OutboundMessage *msg = popOutbound(client->solicitedQueue.head != NULL
+                ? &client->solicitedQueue : &client->unsolicitedQueue);
 
-    if (ret < 0) {
+        if (written < msg->size) {
+            client->outboundPartial = msg;
+            client->outboundOffset = written;
+            return;
+        }
+        written -= msg->size;
+        retireOutbound(client, msg);
+    }
+}
+
+/**
+ * Writes as much queued output as the client's socket takes without
+ * blocking, up to MAX_BATCH_FRAMES messages per sendmsg. On a socket
+ * error the output is dropped; the reader will see the socket close.
+ * Called with s_writeMutex held.
+ */
+static void
+flushOutboundLocked(RilClient *client) {
+    for (;;) {
+        struct iovec iov[MAX_BATCH_FRAMES];
+        struct msghdr msgh;
+        OutboundMessage *msg;
+        size_t total = 0;
+        ssize_t written;
+        int count = 0;
+
+        if (client->outboundPartial != NULL) {
+            iov[count].iov_base = client->outboundPartial->frame + client->outboundOffset;
+            iov[count].iov_len = client->outboundPartial->size - client->outboundOffset;
+            total += iov[count++].iov_len;
+        }
+        for (msg = client->solicitedQueue.head; msg != NULL && count < MAX_BATCH_FRAMES;
+                msg = msg->p_next) {
+            iov[count].iov_base = msg->frame;
+            iov[count].iov_len = msg->size;
+            total += iov[count++].iov_len;
+        }
+        for (msg = client->unsolicitedQueue.head; msg != NULL && count < MAX_BATCH_FRAMES;
+                msg = msg->p_next) {
+            iov[count].iov_base = msg->frame;
+            iov[count].iov_len = msg->size;
+            total += iov[count++].iov_len;
+        }
+
+        if (count == 0) {
+            client->outboundBehind = false;
+            return;
+        }
+
+        memset(&msgh, 0, sizeof(msgh));
+        msgh.msg_iov = iov;
+        msgh.msg_iovlen = count;
+
+        do {
+            written = sendmsg(client->fdWrite, &msgh, MSG_DONTWAIT | MSG_NOSIGNAL);
+        } while (written < 0 && errno == EINTR);
+
+        if (written < 0) {
+            if (errno != EAGAIN && errno != EWOULDBLOCK) {
+                ALOGE ("RIL Response: unexpected error on write errno:%d", errno);
+                discardOutboundLocked(client);
+            }
+            return;
+        }
+
+        consumeOutboundLocked(client, written);
+
+        if ((size_t) written < total) {
+            // the socket is full
+            return;
+        }
+    }
+}
+
+/**
+ * Has the event loop finish writing whatever is left.
+ * Called with s_writeMutex held.
+ */
+static void
+armWriterLocked(RilClient *client) {
+    if (client->writerArmed || client->fdWrite < 0) {
+        return;
+    }
+    if (client->outboundPartial != NULL || client->solicitedQueue.head != NULL
+            || client->unsolicitedQueue.head != NULL) {
+        client->writerArmed = true;
+        rilEventAddWakeup(&client->writerEvent);
+    }
+}
+
+static void
+outboundWriterCallback(int fd, short flags, void *param) {
+    RilClient *client = (RilClient *) param;
+
+    pthread_mutex_lock(&s_writeMutex);
+    client->writerArmed = false;
+    flushOutboundLocked(client);
+    armWriterLocked(client);
+    pthread_mutex_unlock(&s_writeMutex);
+}
+
+/**
+ * Queue an unsolicited response, making room if the client has fallen
+ * behind. Called with s_writeMutex held.
+ */
+static void
+queueUnsolicitedLocked(RilClient *client, OutboundMessage *msg) {
+    OutboundQueue *q = &client->unsolicitedQueue;
+    int index = msg->unsolResponse - RIL_UNSOL_RESPONSE_BASE;
+
+    if (q->count < MAX_OUTBOUND_UNSOLICITED) {
+        pushOutbound(q, msg);
+        return;
+    }
+
+    if (!client->outboundBehind) {
+        ALOGW("RIL: client is not keeping up; dropping unsolicited responses");
+        client->outboundBehind = true;
+    }
+
+    if (s_unsolResponses[index].outboundPolicy == OUTBOUND_REPLACE_LATEST) {
+        OutboundMessage *prev = NULL;
+
+        for (OutboundMessage *cur = q->head; cur != NULL;
+                prev = cur, cur = cur->p_next) {
+            if (cur->unsolResponse == msg->unsolResponse) {
+                msg->p_next = cur->p_next;
+                if (prev == NULL) {
+                    q->head = msg;
+                } else {
+                    prev->p_next = msg;
+                }
+                if (q->tail == cur) {
+                    q->tail = msg;
+                }
+                free(cur);
+                s_outboundReplaced++;
+                return;
+            }
+        }
+    }
+
+    free(popOutbound(q));
+    s_outboundDropped++;
+    pushOutbound(q, msg);
+}
+
+/**
+ * Frame a message for a command socket up front, so one iovec covers
+ * header and payload. unsolResponse is 0 for solicited responses.
+ */
+static OutboundMessage *
+newOutboundMessage(const void *data, size_t dataSize, int unsolResponse) {
+    OutboundMessage *msg;
+    uint32_t header;
+
+    msg = (OutboundMessage *) malloc(sizeof(OutboundMessage) + sizeof(header) + dataSize);
+    if (msg == NULL) {
+        ALOGE("RIL: out of memory queueing response");
+        return NULL;
+    }
+    header = htonl(dataSize);
+    msg->unsolResponse = unsolResponse;
+    msg->requestNumber = 0;
+    msg->intakeUs = 0;
+    msg->size = sizeof(header) + dataSize;
+    msg->frame = (uint8_t *) (msg + 1);
+    memcpy(msg->frame, &header, sizeof(header));
+    memcpy(msg->frame + sizeof(header), data, dataSize);
+
+    return msg;
+}
+
+/** Called with s_writeMutex held */
+static void
+queueOutboundLocked(RilClient *client, OutboundMessage *msg) {
+    if (msg->unsolResponse != 0) {
+        queueUnsolicitedLocked(client, msg);
+    } else if (client->solicitedQueue.count < MAX_OUTBOUND_SOLICITED) {
+        pushOutbound(&client->solicitedQueue, msg);
+    } else {
+        if (!client->outboundBehind) {
+            ALOGE("RIL: command socket is not being read; dropping responses");
+            client->outboundBehind = true;
+        }
+        s_outboundDropped++;
+        free(msg);
+    }
+
+    // once the loop is waiting for the socket, leave the writing to it
+    if (!client->writerArmed) {
+        flushOutboundLocked(client);
+        armWriterLocked(client);
+    }
+}
+
+static bool
+isSubscribed(const uint32_t *mask, int unsolResponseIndex) {
+    return (mask[unsolResponseIndex / 32] & (1U << (unsolResponseIndex % 32))) != 0;
+}
+
+/**
+ * True if some client wants the unsolicited response
+ */
+static bool
+hasUnsolSubscriber(int unsolResponseIndex) {
+    bool subscribed;
+
+    pthread_mutex_lock(&s_writeMutex);
+    subscribed = isSubscribed(s_unsolSubscribed, unsolResponseIndex);
+    pthread_mutex_unlock(&s_writeMutex);
+
+    return subscribed;
+}
+
+/** Called with s_writeMutex held */
+static void
+updateUnsolSubscribedLocked() {
+    memset(s_unsolSubscribed, 0, sizeof(s_unsolSubscribed));
+    for (int i = 0; i < MAX_CLIENTS; i++) {
+        if (s_clients[i].id != 0) {
+            for (size_t w = 0; w < UNSOL_MASK_WORDS; w++) {
+                s_unsolSubscribed[w] |= s_clients[i].unsolMask[w];
+            }
+        }
+    }
+}
+
+/**
+ * Queue a solicited response for the connection identified by client
+ * and clientId. Never blocks on the socket, so any thread may call it.
+ * If pRI is not NULL, the time the response is written is recorded
+ * against its request. Returns -1 if that connection has gone, or the
+ * response could not be queued.
+ */
+static int
+sendResponseRaw (RilClient *client, uint32_t clientId, const RequestInfo *pRI,
+        const void *data, size_t dataSize) {
+    OutboundMessage *msg;
+
+    if (dataSize > MAX_COMMAND_BYTES) {
+        ALOGE("RIL: packet larger than %u (%u)",
+                MAX_COMMAND_BYTES, (unsigned int )dataSize);
+
+        return -1;
+    }
+
+    msg = newOutboundMessage(data, dataSize, 0);
+    if (msg == NULL) {
+        return -1;
+    }
+    if (pRI != NULL) {
+        msg->requestNumber = pRI->pCI->requestNumber;
+        msg->intakeUs = pRI->intakeUs;
+    }
+
+    pthread_mutex_lock(&s_writeMutex);
+
+    if (client->id != clientId || client->fdWrite < 0) {
         pthread_mutex_unlock(&s_writeMutex);
-        return ret;
+        free(msg);
+        return -1;
     }
+    queueOutboundLocked(client, msg);
 
     pthread_mutex_unlock(&s_writeMutex);
 
     return 0;
 }
 
+/**
+ * Queue an unsolicited response for every client subscribed to it, or
+ * only for target if that is not NULL. Never blocks on the socket, so
+ * any thread may call it. Returns -1 if no client got it.
+ */
 static int
-sendResponse (Parcel &p) {
+sendUnsolicitedRaw (RilClient *target, const void *data, size_t dataSize,
+        int unsolResponse) {
+    int index = unsolResponse - RIL_UNSOL_RESPONSE_BASE;
+    int sent = 0;
+
+    if (dataSize > MAX_COMMAND_BYTES) {
+        ALOGE("RIL: packet larger than %u (%u)",
+                MAX_COMMAND_BYTES, (unsigned int )dataSize);
+
+        return -1;
+    }
+
+    pthread_mutex_lock(&s_writeMutex);
+
+    for (int i = 0; i < MAX_CLIENTS; i++) {
+        RilClient *client = &s_clients[i];
+        OutboundMessage *msg;
+
+        if (client->id == 0 || client->fdWrite < 0
+                || (target != NULL ? client != target
+                        : !isSubscribed(client->unsolMask, index))) {
+            continue;
+        }
+
+        msg = newOutboundMessage(data, dataSize, unsolResponse);
+        if (msg == NULL) {
+            break;
+        }
+        queueOutboundLocked(client, msg);
+        sent++;
+    }
+
+    pthread_mutex_unlock(&s_writeMutex);
+
+    if (sent == 0) {
+        return -1;
+    }
+    return 0;
+}
+
+/**
+ * Start queueing output for a new connection
+ */
+static int
+openOutbound(RilClient *client) {
+    int fdWrite = dup(client->fd);
+
+    if (fdWrite < 0) {
+        ALOGE("Error on dup() errno:%d", errno);
+        return -1;
+    }
+    fcntl(fdWrite, F_SETFD, FD_CLOEXEC);
+
+    pthread_mutex_lock(&s_writeMutex);
+    client->fdWrite = fdWrite;
+    ril_event_set(&client->writerEvent, fdWrite, false, outboundWriterCallback, client,
+            RIL_EVENT_PRIORITY_HIGH);
+    ril_event_set_write(&client->writerEvent);
+    pthread_mutex_unlock(&s_writeMutex);
+
+    return 0;
+}
+
+/**
+ * Drop output still queued for a connection that is going away
+ */
+static void
+closeOutbound(RilClient *client) {
+    pthread_mutex_lock(&s_writeMutex);
+    if (client->writerArmed) {
+        ril_event_del(&client->writerEvent);
+        client->writerArmed = false;
+    }
+    if (client->fdWrite >= 0) {
+        close(client->fdWrite);
+        client->fdWrite = -1;
+    }
+    discardOutboundLocked(client);
+    pthread_mutex_unlock(&s_writeMutex);
+}
+
+static int
+sendResponse (RequestInfo *pRI, Parcel &p) {
     printResponse;
-    return sendResponseRaw(p.data(), p.dataSize());
+    return sendResponseRaw(pRI->client, pRI->clientId, pRI, p.data(), p.dataSize());
+}
+
+static int
+sendUnsolResponse (RilClient *target, Parcel &p, int unsolResponse) {
+    printResponse;
+    return sendUnsolicitedRaw(target, p.data(), p.dataSize(), unsolResponse);
 }
 
 /** response is an int* pointing to an array of ints*/
@@ -1399,7 +2261,7 @@ responseInts(Parcel &p, void *response, size_t responselen) {
     /* each int*/
     startResponse;
     for (int i = 0 ; i < numInts ; i++) {
-        appendPrintBuf("%s%d,", printBuf, p_int[i]);
+        appendPrintBuf("%d,", p_int[i]);
         p.writeInt32(p_int[i]);
     }
     removeLastChar;
@@ -1440,7 +2302,7 @@ static int responseStrings(Parcel &p, void *response, size_t responselen) {
         /* each string*/
         startResponse;
         for (int i = 0 ; i < numStrings ; i++) {
-            appendPrintBuf("%s%s,", printBuf, (char*)p_cur[i]);
+            appendPrintBuf("%s,", (char*)p_cur[i]);
             writeStringToParcel (p, p_cur[i]);
         }
         removeLastChar;
@@ -1457,7 +2319,7 @@ static int responseStrings(Parcel &p, void *response, size_t responselen) {
 static int responseString(Parcel &p, void *response, size_t responselen) {
     /* one string only */
     startResponse;
-    appendPrintBuf("%s%s", printBuf, (char*)response);
+    appendPrintBuf("%s", (char*)response);
     closeResponse;
 
     writeStringToParcel(p, (const char *)response);
@@ -1516,20 +2378,17 @@ static int responseCallList(Parcel &p, void *response, size_t responselen) {
             p.writeInt32(uusInfo->uusLength);
             p.write(uusInfo->uusData, uusInfo->uusLength);
         }
-        appendPrintBuf("%s[id=%d,%s,toa=%d,",
-            printBuf,
+        appendPrintBuf("[id=%d,%s,toa=%d,",
             p_cur->index,
             callStateToString(p_cur->state),
             p_cur->toa);
-        appendPrintBuf("%s%s,%s,als=%d,%s,%s,",
-            printBuf,
+        appendPrintBuf("%s,%s,als=%d,%s,%s,",
             (p_cur->isMpty)?"conf":"norm",
             (p_cur->isMT)?"mt":"mo",
             p_cur->als,
             (p_cur->isVoice)?"voc":"nonvoc",
             (p_cur->isVoicePrivacy)?"evp":"noevp");
-        appendPrintBuf("%s%s,cli=%d,name='%s',%d]",
-            printBuf,
+        appendPrintBuf("%s,cli=%d,name='%s',%d]",
             p_cur->number,
             p_cur->numberPresentation,
             p_cur->name,
@@ -1560,7 +2419,7 @@ static int responseSMS(Parcel &p, void *response, size_t responselen) {
     p.writeInt32(p_cur->errorCode);
 
     startResponse;
-    appendPrintBuf("%s%d,%s,%d", printBuf, p_cur->messageRef,
+    appendPrintBuf("%d,%s,%d", p_cur->messageRef,
         (char*)p_cur->ackPDU, p_cur->errorCode);
     closeResponse;
 
@@ -1592,7 +2451,7 @@ static int responseDataCallListV4(Parcel &p, void *response, size_t responselen)
         writeStringToParcel(p, p_cur[i].type);
         // apn is not used, so don't send.
         writeStringToParcel(p, p_cur[i].address);
-        appendPrintBuf("%s[cid=%d,%s,%s,%s],", printBuf,
+        appendPrintBuf("[cid=%d,%s,%s,%s],",
             p_cur[i].cid,
             (p_cur[i].active==0)?"down":"up",
             (char*)p_cur[i].type,
@@ -1639,7 +2498,7 @@ static int responseDataCallList(Parcel &p, void *response, size_t responselen)
             writeStringToParcel(p, p_cur[i].addresses);
             writeStringToParcel(p, p_cur[i].dnses);
             writeStringToParcel(p, p_cur[i].gateways);
-            appendPrintBuf("%s[status=%d,retry=%d,cid=%d,%s,%s,%s,%s,%s,%s],", printBuf,
+            appendPrintBuf("[status=%d,retry=%d,cid=%d,%s,%s,%s,%s,%s,%s],",
                 p_cur[i].status,
                 p_cur[i].suggestedRetryTime,
                 p_cur[i].cid,
@@ -1702,7 +2561,7 @@ static int responseSIM_IO(Parcel &p, void *response, size_t responselen) {
     writeStringToParcel(p, p_cur->simResponse);
 
     startResponse;
-    appendPrintBuf("%ssw1=0x%X,sw2=0x%X,%s", printBuf, p_cur->sw1, p_cur->sw2,
+    appendPrintBuf("sw1=0x%X,sw2=0x%X,%s", p_cur->sw1, p_cur->sw2,
         (char*)p_cur->simResponse);
     closeResponse;
 
@@ -1738,7 +2597,7 @@ static int responseCallForwards(Parcel &p, void *response, size_t responselen) {
         p.writeInt32(p_cur->toa);
         writeStringToParcel(p, p_cur->number);
         p.writeInt32(p_cur->timeSeconds);
-        appendPrintBuf("%s[%s,reason=%d,cls=%d,toa=%d,%s,tout=%d],", printBuf,
+        appendPrintBuf("[%s,reason=%d,cls=%d,toa=%d,%s,tout=%d],",
             (p_cur->status==1)?"enable":"disable",
             p_cur->reason, p_cur->serviceClass, p_cur->toa,
             (char*)p_cur->number,
@@ -1770,7 +2629,7 @@ static int responseSsn(Parcel &p, void *response, size_t responselen) {
     writeStringToParcel(p, p_cur->number);
 
     startResponse;
-    appendPrintBuf("%s%s,code=%d,id=%d,type=%d,%s", printBuf,
+    appendPrintBuf("%s,code=%d,id=%d,type=%d,%s",
         (p_cur->notificationType==0)?"mo":"mt",
          p_cur->code, p_cur->index, p_cur->type,
         (char*)p_cur->number);
@@ -1804,7 +2663,7 @@ static int responseCellList(Parcel &p, void *response, size_t responselen) {
         p.writeInt32(p_cur->rssi);
         writeStringToParcel (p, p_cur->cid);
 
-        appendPrintBuf("%s[cid=%s,rssi=%d],", printBuf,
+        appendPrintBuf("[cid=%s,rssi=%d],",
             p_cur->cid, p_cur->rssi);
     }
     removeLastChar;
@@ -1903,9 +2762,9 @@ static int responseCdmaInformationRecords(Parcel &p,
                 p.writeInt32(infoRec->rec.signal.alertPitch);
                 p.writeInt32(infoRec->rec.signal.signal);
 
-                appendPrintBuf("%sisPresent=%X, signalType=%X, \
+                appendPrintBuf("isPresent=%X, signalType=%X, \
                                 alertPitch=%X, signal=%X, ",
-                   printBuf, (int)infoRec->rec.signal.isPresent,
+                   (int)infoRec->rec.signal.isPresent,
                    (int)infoRec->rec.signal.signalType,
                    (int)infoRec->rec.signal.alertPitch,
                    (int)infoRec->rec.signal.signal);
@@ -1943,9 +2802,9 @@ static int responseCdmaInformationRecords(Parcel &p,
                 p.writeInt32(infoRec->rec.lineCtrl.lineCtrlReverse);
                 p.writeInt32(infoRec->rec.lineCtrl.lineCtrlPowerDenial);
 
-                appendPrintBuf("%slineCtrlPolarityIncluded=%d, \
+                appendPrintBuf("lineCtrlPolarityIncluded=%d, \
                                 lineCtrlToggle=%d, lineCtrlReverse=%d, \
-                                lineCtrlPowerDenial=%d, ", printBuf,
+                                lineCtrlPowerDenial=%d, ",
                        (int)infoRec->rec.lineCtrl.lineCtrlPolarityIncluded,
                        (int)infoRec->rec.lineCtrl.lineCtrlToggle,
                        (int)infoRec->rec.lineCtrl.lineCtrlReverse,
@@ -1955,14 +2814,14 @@ static int responseCdmaInformationRecords(Parcel &p,
             case RIL_CDMA_T53_CLIR_INFO_REC:
                 p.writeInt32((int)(infoRec->rec.clir.cause));
 
-                appendPrintBuf("%scause%d", printBuf, infoRec->rec.clir.cause);
+                appendPrintBuf("cause%d", infoRec->rec.clir.cause);
                 removeLastChar;
                 break;
             case RIL_CDMA_T53_AUDIO_CONTROL_INFO_REC:
                 p.writeInt32(infoRec->rec.audioCtrl.upLink);
                 p.writeInt32(infoRec->rec.audioCtrl.downLink);
 
-                appendPrintBuf("%supLink=%d, downLink=%d, ", printBuf,
+                appendPrintBuf("upLink=%d, downLink=%d, ",
                         infoRec->rec.audioCtrl.upLink,
                         infoRec->rec.audioCtrl.downLink);
                 removeLastChar;
@@ -2018,13 +2877,12 @@ static int responseRilSignalStrength(Parcel &p,
         }
 
         startResponse;
-        appendPrintBuf("%s[signalStrength=%d,bitErrorRate=%d,\
+        appendPrintBuf("[signalStrength=%d,bitErrorRate=%d,\
                 CDMA_SS.dbm=%d,CDMA_SSecio=%d,\
                 EVDO_SS.dbm=%d,EVDO_SS.ecio=%d,\
                 EVDO_SS.signalNoiseRatio=%d,\
                 LTE_SS.signalStrength=%d,LTE_SS.rsrp=%d,LTE_SS.rsrq=%d,\
                 LTE_SS.rssnr=%d,LTE_SS.cqi=%d]",
-                printBuf,
                 p_cur->GW_SignalStrength.signalStrength,
                 p_cur->GW_SignalStrength.bitErrorRate,
                 p_cur->CDMA_SignalStrength.dbm,
@@ -2072,9 +2930,8 @@ static int responseCdmaSignalInfoRecord(Parcel &p, void *response, size_t respon
     RIL_CDMA_SignalInfoRecord *p_cur = ((RIL_CDMA_SignalInfoRecord *) response);
     marshallSignalInfoRecord(p, *p_cur);
 
-    appendPrintBuf("%s[isPresent=%d,signalType=%d,alertPitch=%d\
+    appendPrintBuf("[isPresent=%d,signalType=%d,alertPitch=%d\
               signal=%d]",
-              printBuf,
               p_cur->isPresent,
               p_cur->signalType,
               p_cur->alertPitch,
@@ -2111,10 +2968,9 @@ static int responseCdmaCallWaiting(Parcel &p, void *response,
     }
 
     startResponse;
-    appendPrintBuf("%snumber=%s,numberPresentation=%d, name=%s,\
+    appendPrintBuf("number=%s,numberPresentation=%d, name=%s,\
             signalInfoRecord[isPresent=%d,signalType=%d,alertPitch=%d\
             signal=%d,number_type=%d,number_plan=%d]",
-            printBuf,
             p_cur->number,
             p_cur->numberPresentation,
             p_cur->name,
@@ -2142,8 +2998,7 @@ static int responseSimRefresh(Parcel &p, void *response, size_t responselen) {
         p.writeInt32(p_cur->ef_id);
         writeStringToParcel(p, p_cur->aid);
 
-        appendPrintBuf("%sresult=%d, ef_id=%d, aid=%s",
-                printBuf,
+        appendPrintBuf("result=%d, ef_id=%d, aid=%s",
                 p_cur->result,
                 p_cur->ef_id,
                 p_cur->aid);
@@ -2153,8 +3008,7 @@ static int responseSimRefresh(Parcel &p, void *response, size_t responselen) {
         p.writeInt32(p_cur[1]);
         writeStringToParcel(p, NULL);
 
-        appendPrintBuf("%sresult=%d, ef_id=%d",
-                printBuf,
+        appendPrintBuf("result=%d, ef_id=%d",
                 p_cur[0],
                 p_cur[1]);
     }
@@ -2168,9 +3022,24 @@ static void triggerEvLoop() {
     if (!pthread_equal(pthread_self(), s_tid_dispatch)) {
         /* trigger event loop to wakeup. No reason to do this,
          * if we're in the event loop thread */
-         do {
-            ret = write (s_fdWakeupWrite, " ", 1);
-         } while (ret < 0 && errno == EINTR);
+        __sync_fetch_and_add(&s_wakeupRequests, 1);
+
+        /* a wakeup is already on its way */
+        if (!__sync_bool_compare_and_swap(&s_wakeupPending, 0, 1)) {
+            return;
+        }
+
+        __sync_fetch_and_add(&s_wakeupWrites, 1);
+        if (s_wakeupIsEventfd) {
+            uint64_t one = 1;
+            do {
+                ret = write (s_fdWakeupWrite, &one, sizeof(one));
+            } while (ret < 0 && errno == EINTR);
+        } else {
+            do {
+                ret = write (s_fdWakeupWrite, " ", 1);
+            } while (ret < 0 && errno == EINTR);
+        }
     }
 }
 
@@ -2192,9 +3061,8 @@ static void sendSimStatusAppInfo(Parcel &p, int num_apps, RIL_AppStatus appStatu
             p.writeInt32(appStatus[i].pin1_replaced);
             p.writeInt32(appStatus[i].pin1);
             p.writeInt32(appStatus[i].pin2);
-            appendPrintBuf("%s[app_type=%d,app_state=%d,perso_substate=%d,\
+            appendPrintBuf("[app_type=%d,app_state=%d,perso_substate=%d,\
                     aid_ptr=%s,app_label_ptr=%s,pin1_replaced=%d,pin1=%d,pin2=%d],",
-                    printBuf,
                     appStatus[i].app_type,
                     appStatus[i].app_state,
                     appStatus[i].perso_substate,
@@ -2257,9 +3125,9 @@ static int responseGsmBrSmsCnf(Parcel &p, void *response, size_t responselen) {
         p.writeInt32(p_cur[i]->toCodeScheme);
         p.writeInt32(p_cur[i]->selected);
 
-        appendPrintBuf("%s [%d: fromServiceId=%d, toServiceId=%d, \
+        appendPrintBuf(" [%d: fromServiceId=%d, toServiceId=%d, \
                 fromCodeScheme=%d, toCodeScheme=%d, selected =%d]",
-                printBuf, i, p_cur[i]->fromServiceId, p_cur[i]->toServiceId,
+                i, p_cur[i]->fromServiceId, p_cur[i]->toServiceId,
                 p_cur[i]->fromCodeScheme, p_cur[i]->toCodeScheme,
                 p_cur[i]->selected);
     }
@@ -2281,9 +3149,9 @@ static int responseCdmaBrSmsCnf(Parcel &p, void *response, size_t responselen) {
         p.writeInt32(p_cur[i]->language);
         p.writeInt32(p_cur[i]->selected);
 
-        appendPrintBuf("%s [%d: srvice_category=%d, language =%d, \
+        appendPrintBuf(" [%d: srvice_category=%d, language =%d, \
               selected =%d], ",
-              printBuf, i, p_cur[i]->service_category, p_cur[i]->language,
+              i, p_cur[i]->service_category, p_cur[i]->language,
               p_cur[i]->selected);
     }
     closeResponse;
@@ -2340,9 +3208,9 @@ static int responseCdmaSms(Parcel &p, void *response, size_t responselen) {
     }
 
     startResponse;
-    appendPrintBuf("%suTeleserviceID=%d, bIsServicePresent=%d, uServicecategory=%d, \
+    appendPrintBuf("uTeleserviceID=%d, bIsServicePresent=%d, uServicecategory=%d, \
             sAddress.digit_mode=%d, sAddress.number_mode=%d, sAddress.number_type=%d, ",
-            printBuf, p_cur->uTeleserviceID,p_cur->bIsServicePresent,p_cur->uServicecategory,
+            p_cur->uTeleserviceID,p_cur->bIsServicePresent,p_cur->uServicecategory,
             p_cur->sAddress.digit_mode, p_cur->sAddress.number_mode,p_cur->sAddress.number_type);
     closeResponse;
 
@@ -2360,47 +3228,58 @@ static void processWakeupCallback(int fd, short flags, void *param) {
 
     ALOGV("processWakeupCallback");
 
-    /* empty our wakeup socket out */
-    do {
-        ret = read(s_fdWakeupRead, &buff, sizeof(buff));
-    } while (ret > 0 || (ret < 0 && errno == EINTR));
-}
-
-static void onCommandsSocketClosed() {
-    int ret;
-    RequestInfo *p_cur;
-
-    /* mark pending requests as "cancelled" so we dont report responses */
+    if (s_wakeupIsEventfd) {
+        /* a single read resets the eventfd counter */
+        uint64_t count;
+        do {
+            ret = read(s_fdWakeupRead, &count, sizeof(count));
+        } while (ret < 0 && errno == EINTR);
+    } else {
+        /* empty our wakeup socket out */
+        do {
+            ret = read(s_fdWakeupRead, &buff, sizeof(buff));
+        } while (ret > 0 || (ret < 0 && errno == EINTR));
+    }
 
-    ret = pthread_mutex_lock(&s_pendingRequestsMutex);
-    assert (ret == 0);
+    /* re-arm only once the fd is empty. Clearing the flag first would
+       let a post set it and write in between, the drain eat that write,
+       and the flag stay set with nothing left to clear it, so no post
+       would ever write again. A post that finds the flag still set here
+       needs no write: the loop takes in its timer or event on the next
+       pass before it blocks again */
+    __sync_lock_release(&s_wakeupPending);
+}
 
-    p_cur = s_pendingRequests;
+/**
+ * Close a connection. Requests still outstanding for it are dropped
+ * when they complete, as their clientId no longer matches.
+ */
+static void closeClient(RilClient *client) {
+    closeOutbound(client);
 
-    for (p_cur = s_pendingRequests
-            ; p_cur != NULL
-            ; p_cur  = p_cur->p_next
-    ) {
-        p_cur->cancelled = 1;
-    }
+    ril_event_del(&client->commandsEvent);
+    record_stream_free(client->p_rs);
+    client->p_rs = NULL;
+    close(client->fd);
+    client->fd = -1;
 
-    ret = pthread_mutex_unlock(&s_pendingRequestsMutex);
-    assert (ret == 0);
+    pthread_mutex_lock(&s_writeMutex);
+    client->id = 0;
+    updateUnsolSubscribedLocked();
+    pthread_mutex_unlock(&s_writeMutex);
 }
 
 static void processCommandsCallback(int fd, short flags, void *param) {
-    RecordStream *p_rs;
+    RilClient *client = (RilClient *)param;
     void *p_record;
     size_t recordlen;
     int ret;
 
-    assert(fd == s_fdCommand);
-
-    p_rs = (RecordStream *)param;
+    assert(fd == client->fd);
 
     for (;;) {
         /* loop until EAGAIN/EINTR, end of stream, or other error */
-        ret = record_stream_get_next(p_rs, &p_record, &recordlen);
+        ret = record_stream_get_next(client->p_rs, &p_record, &recordlen);
 
         if (ret == 0 && p_record == NULL) {
             /* end-of-stream */
@@ -2408,7 +3287,7 @@ static void processCommandsCallback(int fd, short flags, void *param) {
         } else if (ret < 0) {
             break;
         } else if (ret == 0) { /* && p_record != NULL */
-            processCommandBuffer(p_record, recordlen);
+            processCommandBuffer(client, p_record, recordlen);
         }
     }
 
@@ -2420,37 +3299,35 @@ static void processCommandsCallback(int fd, short flags, void *param) {
             ALOGW("EOS.  Closing command socket.");
         }
 
-        close(s_fdCommand);
-        s_fdCommand = -1;
-
-        ril_event_del(&s_commands_event);
-
-        record_stream_free(p_rs);
+        closeClient(client);
+    }
+}
 
-        /* start listening for new connections again */
-        rilEventAddWakeup(&s_listen_event);
 
-        onCommandsSocketClosed();
+/* Replay the last NITZ response, if there has been one, to client only */
+static void sendLastNITZ(RilClient *client) {
+    pthread_mutex_lock(&s_lastNITZMutex);
+    if (s_lastNITZTimeData != NULL) {
+        sendUnsolicitedRaw(client, s_lastNITZTimeData, s_lastNITZTimeDataSize,
+                RIL_UNSOL_NITZ_TIME_RECEIVED);
     }
+    pthread_mutex_unlock(&s_lastNITZMutex);
 }
 
-
-static void onNewCommandConnect() {
+static void onNewCommandConnect(RilClient *client) {
     // Inform we are connected and the ril version
     int rilVer = s_callbacks.version;
-    RIL_onUnsolicitedResponse(RIL_UNSOL_RIL_CONNECTED,
+    onUnsolicitedResponse(client, RIL_UNSOL_RIL_CONNECTED,
                                     &rilVer, sizeof(rilVer));
 
     // implicit radio state changed
-    RIL_onUnsolicitedResponse(RIL_UNSOL_RESPONSE_RADIO_STATE_CHANGED,
+    onUnsolicitedResponse(client, RIL_UNSOL_RESPONSE_RADIO_STATE_CHANGED,
                                     NULL, 0);
 
     // Send last NITZ time data, in case it was missed
-    if (s_lastNITZTimeData != NULL) {
-        sendResponseRaw(s_lastNITZTimeData, s_lastNITZTimeDataSize);
-
-        free(s_lastNITZTimeData);
-        s_lastNITZTimeData = NULL;
+    if (isSubscribed(client->unsolMask,
+            RIL_UNSOL_NITZ_TIME_RECEIVED - RIL_UNSOL_RESPONSE_BASE)) {
+        sendLastNITZ(client);
     }
 
     // Get version string
@@ -2467,11 +3344,34 @@ static void onNewCommandConnect() {
 
 }
 
+/**
+ * True if the user is named in PROPERTY_RIL_CLIENTS
+ */
+static bool isExtraClient(const char *name) {
+    char value[PROPERTY_VALUE_MAX];
+    size_t len = strlen(name);
+    const char *p;
+
+    property_get(PROPERTY_RIL_CLIENTS, value, "");
+
+    for (p = value; *p != '\0'; ) {
+        size_t n = strcspn(p, ", ");
+
+        if (n == len && strncmp(p, name, len) == 0) {
+            return true;
+        }
+        p += n;
+        p += strspn(p, ", ");
+    }
+    return false;
+}
+
 static void listenCallback (int fd, short flags, void *param) {
     int ret;
     int err;
-    int is_phone_socket;
-    RecordStream *p_rs;
+    int fdCommand;
+    bool is_phone_socket;
+    RilClient *client = NULL;
 
     struct sockaddr_un peeraddr;
     socklen_t socklen = sizeof (peeraddr);
@@ -2481,34 +3381,32 @@ static void listenCallback (int fd, short flags, void *param) {
 
     struct passwd *pwd = NULL;
 
-    assert (s_fdCommand < 0);
     assert (fd == s_fdListen);
 
-    s_fdCommand = accept(s_fdListen, (sockaddr *) &peeraddr, &socklen);
+    fdCommand = accept(s_fdListen, (sockaddr *) &peeraddr, &socklen);
 
-    if (s_fdCommand < 0 ) {
+    if (fdCommand < 0 ) {
         ALOGE("Error on accept() errno:%d", errno);
-        /* start listening for new connections again */
-        rilEventAddWakeup(&s_listen_event);
 	      return;
     }
 
-    /* check the credential of the other side and only accept socket from
-     * phone process
+    /* check the credential of the other side and only accept sockets
+     * from the phone process and the users in PROPERTY_RIL_CLIENTS
      */
     errno = 0;
-    is_phone_socket = 0;
+    is_phone_socket = false;
 
-    err = getsockopt(s_fdCommand, SOL_SOCKET, SO_PEERCRED, &creds, &szCreds);
+    err = getsockopt(fdCommand, SOL_SOCKET, SO_PEERCRED, &creds, &szCreds);
 
     if (err == 0 && szCreds > 0) {
         errno = 0;
         pwd = getpwuid(creds.uid);
         if (pwd != NULL) {
             if (strcmp(pwd->pw_name, PHONE_PROCESS) == 0) {
-                is_phone_socket = 1;
-            } else {
+                is_phone_socket = true;
+            } else if (!isExtraClient(pwd->pw_name)) {
                 ALOGE("RILD can't accept socket from process %s", pwd->pw_name);
+                pwd = NULL;
             }
         } else {
             ALOGE("Error on getpwuid() errno: %d", errno);
@@ -2517,36 +3415,124 @@ static void listenCallback (int fd, short flags, void *param) {
         ALOGD("Error on getsockopt() errno: %d", errno);
     }
 
-    if ( !is_phone_socket ) {
+    if (pwd == NULL) {
       ALOGE("RILD must accept socket from %s", PHONE_PROCESS);
+      close(fdCommand);
+      return;
+    }
+
+    for (int i = 0; i < MAX_CLIENTS; i++) {
+        if (s_clients[i].id == 0) {
+            client = &s_clients[i];
+            break;
+        }
+    }
+    if (client == NULL) {
+        ALOGE("RILD already has %d connections; refusing %s", MAX_CLIENTS, pwd->pw_name);
+        close(fdCommand);
+        return;
+    }
 
-      close(s_fdCommand);
-      s_fdCommand = -1;
+    ret = fcntl(fdCommand, F_SETFL, O_NONBLOCK);
 
-      onCommandsSocketClosed();
+    if (ret < 0) {
+        ALOGE ("Error setting O_NONBLOCK errno:%d", errno);
+    }
 
-      /* start listening for new connections again */
-      rilEventAddWakeup(&s_listen_event);
+    client->fd = fdCommand;
+    client->isPhone = is_phone_socket;
 
-      return;
+    if (openOutbound(client) < 0) {
+        close(fdCommand);
+        client->fd = -1;
+        return;
     }
 
-    ret = fcntl(s_fdCommand, F_SETFL, O_NONBLOCK);
+    ALOGI("libril: new connection from %s", pwd->pw_name);
 
-    if (ret < 0) {
-        ALOGE ("Error setting O_NONBLOCK errno:%d", errno);
+    // the phone process gets everything; others choose
+    pthread_mutex_lock(&s_writeMutex);
+    if (++s_nextClientId == 0) {
+        s_nextClientId = 1;
     }
+    client->id = s_nextClientId;
+    memset(client->unsolMask, is_phone_socket ? 0xff : 0, sizeof(client->unsolMask));
+    updateUnsolSubscribedLocked();
+    pthread_mutex_unlock(&s_writeMutex);
+
+    client->p_rs = record_stream_new(fdCommand, MAX_COMMAND_BYTES);
 
-    ALOGI("libril: new connection");
+    ril_event_set (&client->commandsEvent, fdCommand, 1,
+        processCommandsCallback, client, RIL_EVENT_PRIORITY_HIGH);
 
-    p_rs = record_stream_new(s_fdCommand, MAX_COMMAND_BYTES);
+    rilEventAddWakeup (&client->commandsEvent);
 
-    ril_event_set (&s_commands_event, s_fdCommand, 1,
-        processCommandsCallback, p_rs);
+    onNewCommandConnect(client);
+}
+
+static void dumpHistogram(const char *name, const struct ril_histogram *h) {
+    ALOGI("  %s: count %u, p50 %uus, p90 %uus, p99 %uus, max %uus", name,
+            (unsigned int) h->count,
+            (unsigned int) ril_histogram_percentile(h, 50),
+            (unsigned int) ril_histogram_percentile(h, 90),
+            (unsigned int) ril_histogram_percentile(h, 99),
+            (unsigned int) h->max);
+}
+
+static void dumpRequestStats() {
+    for (int i = 0; i < (int)NUM_ELEMS(s_requestStats); i++) {
+        const RequestStats *stats = s_requestStats[i];
+
+        if (stats == NULL) {
+            continue;
+        }
+        ALOGI("request %s: %u errors", requestToString(i), (unsigned int) stats->errors);
+        dumpHistogram("dispatched", &stats->latency_us[REQUEST_DISPATCHED]);
+        dumpHistogram("completed", &stats->latency_us[REQUEST_COMPLETED]);
+        dumpHistogram("written", &stats->latency_us[REQUEST_WRITTEN]);
+    }
 
-    rilEventAddWakeup (&s_commands_event);
+    for (int i = 0; i < ERRNO_STATS; i++) {
+        if (s_errnoCounts[i] != 0) {
+            ALOGI("completed with %s: %u",
+                    (i < ERRNO_STATS - 1) ? failCauseToString((RIL_Errno) i) : "other",
+                    (unsigned int) s_errnoCounts[i]);
+        }
+    }
+}
 
-    onNewCommandConnect();
+static void dumpStats() {
+    int32_t requests = s_wakeupRequests;
+    int32_t writes = s_wakeupWrites;
+
+    ALOGI("event loop wakeups: %d requested, %d written, %d coalesced (%s)",
+            requests, writes, requests - writes,
+            s_wakeupIsEventfd ? "eventfd" : "pipe");
+    ril_event_dump_stats();
+    ALOGI("outbound: %d dropped, %d replaced", s_outboundDropped, s_outboundReplaced);
+
+    pthread_mutex_lock(&s_wakeLockMutex);
+    int64_t heldMs = s_wakeLockHeldMs;
+    if (s_wakeLockRefs > 0) {
+        heldMs += elapsedRealtime() - s_wakeLockHeldSince;
+    }
+    ALOGI("wake lock: %d grabs, %d acquisitions, held %lld ms%s",
+            s_wakeLockGrabs, s_wakeLockAcquisitions, (long long) heldMs,
+            (s_wakeLockRefs > 0) ? " (held now)" : "");
+    pthread_mutex_unlock(&s_wakeLockMutex);
+
+    pthread_mutex_lock(&s_coalesceMutex);
+    for (int i = 0; i < (int)NUM_ELEMS(s_coalesceState); i++) {
+        if (s_coalesceState[i].suppressed > 0) {
+            ALOGI("coalesced %s: %d suppressed",
+                    requestToString(i + RIL_UNSOL_RESPONSE_BASE),
+                    s_coalesceState[i].suppressed);
+        }
+    }
+    pthread_mutex_unlock(&s_coalesceMutex);
+    ril_pool_dump_stats(&s_requestInfoPool);
+    ril_pool_dump_stats(&s_userCallbackPool);
+    dumpRequestStats();
 }
 
 static void freeDebugCallbackArgs(int number, char **args) {
@@ -2612,9 +3598,12 @@ static void debugCallback (int fd, short flags, void *param) {
             ALOGI ("Connection on debug port: issuing radio power off.");
             data = 0;
             issueLocalRequest(RIL_REQUEST_RADIO_POWER, &data, sizeof(int));
-            // Close the socket
-            close(s_fdCommand);
-            s_fdCommand = -1;
+            // Close the phone process's sockets
+            for (int i = 0; i < MAX_CLIENTS; i++) {
+                if (s_clients[i].id != 0 && s_clients[i].isPhone) {
+                    closeClient(&s_clients[i]);
+                }
+            }
             break;
         case 2:
             ALOGI ("Debug port: issuing unsolicited voice network change.");
@@ -2677,6 +3666,23 @@ static void debugCallback (int fd, short flags, void *param) {
             issueLocalRequest(RIL_REQUEST_HANGUP, &hangupData,
                               sizeof(hangupData));
             break;
+        case 11:
+            ALOGI("Debug port: Dump stats");
+            dumpStats();
+            break;
+        case 12:
+            ril_event_set_stats_enabled(!ril_event_get_stats_enabled());
+            ALOGI("Debug port: Event loop stats %s",
+                    ril_event_get_stats_enabled() ? "enabled" : "disabled");
+            break;
+        case 13:
+            ALOGI("Debug port: Dump request latency");
+            dumpRequestStats();
+            break;
+        case 14:
+            ALOGI("Debug port: Dump trace");
+            RIL_traceDump();
+            break;
         default:
             ALOGE ("Invalid request");
             break;
@@ -2686,20 +3692,29 @@ static void debugCallback (int fd, short flags, void *param) {
 }
 
 
+static void releaseTimedCallbackSlot(int slot);
+
 static void userTimerCallback (int fd, short flags, void *param) {
     UserCallbackInfo *p_info;
 
     p_info = (UserCallbackInfo *)param;
 
-    p_info->p_callback(p_info->userParam);
-
+    // Cancelled; internalCancelTimedCallback already released the handle
+    if (flags & RIL_EVENT_CANCELLED) {
+        ril_pool_free(&s_userCallbackPool, p_info);
+        return;
+    }
 
-    // FIXME generalize this...there should be a cancel mechanism
-    if (s_last_wake_timeout_info != NULL && s_last_wake_timeout_info == p_info) {
-        s_last_wake_timeout_info = NULL;
+    // The handle is invalid once the callback starts running
+    if (p_info->slot >= 0) {
+        pthread_mutex_lock(&s_timedCallbackMutex);
+        releaseTimedCallbackSlot(p_info->slot);
+        pthread_mutex_unlock(&s_timedCallbackMutex);
     }
 
-    free(p_info);
+    p_info->p_callback(p_info->userParam);
+
+    ril_pool_free(&s_userCallbackPool, p_info);
 }
 
 
@@ -2717,20 +3732,29 @@ eventLoop(void *param) {
 
     pthread_mutex_unlock(&s_startupMutex);
 
-    ret = pipe(filedes);
+    ret = eventfd(0, 0);
 
-    if (ret < 0) {
-        ALOGE("Error in pipe() errno:%d", errno);
-        return NULL;
-    }
+    if (ret >= 0) {
+        s_fdWakeupRead = s_fdWakeupWrite = ret;
+        s_wakeupIsEventfd = true;
+    } else {
+        ALOGW("eventfd() failed errno:%d, using a pipe for wakeups", errno);
+
+        ret = pipe(filedes);
 
-    s_fdWakeupRead = filedes[0];
-    s_fdWakeupWrite = filedes[1];
+        if (ret < 0) {
+            ALOGE("Error in pipe() errno:%d", errno);
+            return NULL;
+        }
+
+        s_fdWakeupRead = filedes[0];
+        s_fdWakeupWrite = filedes[1];
+    }
 
     fcntl(s_fdWakeupRead, F_SETFL, O_NONBLOCK);
 
     ril_event_set (&s_wakeupfd_event, s_fdWakeupRead, true,
-                processWakeupCallback, NULL);
+                processWakeupCallback, NULL, RIL_EVENT_PRIORITY_HIGH);
 
     rilEventAddWakeup (&s_wakeupfd_event);
 
@@ -2773,6 +3797,40 @@ extern "C" void RIL_setcallbacks (const RIL_RadioFunctions *callbacks) {
     memcpy(&s_callbacks, callbacks, sizeof (RIL_RadioFunctions));
 }
 
+static int
+readCoalesceWindow(const char *property, int defaultMs) {
+    char value[PROPERTY_VALUE_MAX];
+    int ms;
+
+    if (property_get(property, value, "") <= 0) {
+        return defaultMs;
+    }
+
+    ms = atoi(value);
+    if (ms < 0) {
+        ms = 0;
+    } else if (ms > MAX_UNSOL_COALESCE_MS) {
+        ALOGW("%s: %d ms is too long, using %d", property, ms, MAX_UNSOL_COALESCE_MS);
+        ms = MAX_UNSOL_COALESCE_MS;
+    }
+    return ms;
+}
+
+static void
+openCapture() {
+    char value[PROPERTY_VALUE_MAX];
+    int kb;
+
+    if (property_get(PROPERTY_RIL_CAPTURE_KB, value, "") <= 0) {
+        return;
+    }
+
+    kb = atoi(value);
+    if (kb > 0) {
+        ril_capture_open(RIL_CAPTURE_PATH, (size_t) kb * 1024);
+    }
+}
+
 extern "C" void
 RIL_register (const RIL_RadioFunctions *callbacks, const char *clientId) {
     int ret;
@@ -2803,18 +3861,14 @@ RIL_register (const RIL_RadioFunctions *callbacks, const char *clientId) {
 
     memcpy(&s_callbacks, callbacks, sizeof (RIL_RadioFunctions));
 
-    s_registerCalled = 1;
-
-    // Little self-check
+    s_collapseWindowMs = readCoalesceWindow(PROPERTY_UNSOL_COLLAPSE_MS,
+            DEFAULT_UNSOL_COLLAPSE_MS);
+    s_minIntervalMs = readCoalesceWindow(PROPERTY_UNSOL_MIN_INTERVAL_MS,
+            DEFAULT_UNSOL_MIN_INTERVAL_MS);
 
-    for (int i = 0; i < (int)NUM_ELEMS(s_commands); i++) {
-        assert(i == s_commands[i].requestNumber);
-    }
+    openCapture();
 
-    for (int i = 0; i < (int)NUM_ELEMS(s_unsolResponses); i++) {
-        assert(i + RIL_UNSOL_RESPONSE_BASE
-                == s_unsolResponses[i].requestNumber);
-    }
+    s_registerCalled = 1;
 
     // New rild impl calls RIL_startEventLoop() first
     // old standalone impl wants it here.
@@ -2853,9 +3907,9 @@ RIL_register (const RIL_RadioFunctions *callbacks, const char *clientId) {
 #endif
 
 
-    /* note: non-persistent so we can accept only one connection at a time */
-    ril_event_set (&s_listen_event, s_fdListen, false,
-                listenCallback, NULL);
+    /* persistent: up to MAX_CLIENTS connections are served at once */
+    ril_event_set (&s_listen_event, s_fdListen, true,
+                listenCallback, NULL, RIL_EVENT_PRIORITY_LOW);
 
     rilEventAddWakeup (&s_listen_event);
 
@@ -2878,13 +3932,18 @@ RIL_register (const RIL_RadioFunctions *callbacks, const char *clientId) {
     }
 
     ril_event_set (&s_debug_event, s_fdDebug, true,
-                debugCallback, NULL);
+                debugCallback, NULL, RIL_EVENT_PRIORITY_LOW);
 
     rilEventAddWakeup (&s_debug_event);
 #endif
 
 }
 
+/**
+ * Removes pRI from the pending set, and marks it cancelled if the
+ * connection it came in on has closed since. Returns 0 if pRI is not a
+ * pending request, without dereferencing it.
+ */
 static int
 checkAndDequeueRequestInfo(struct RequestInfo *pRI) {
     int ret = 0;
@@ -2895,15 +3954,43 @@ checkAndDequeueRequestInfo(struct RequestInfo *pRI) {
 
     pthread_mutex_lock(&s_pendingRequestsMutex);
 
-    for(RequestInfo **ppCur = &s_pendingRequests
-        ; *ppCur != NULL
-        ; ppCur = &((*ppCur)->p_next)
-    ) {
-        if (pRI == *ppCur) {
+    if (s_pendingRequestsSize > 0) {
+        size_t mask = s_pendingRequestsSize - 1;
+        size_t i = pendingRequestHash(pRI, s_pendingRequestsShift);
+
+        while (s_pendingRequests[i] != NULL && s_pendingRequests[i] != pRI) {
+            i = (i + 1) & mask;
+        }
+
+        if (s_pendingRequests[i] == pRI) {
+            size_t j = i;
+
             ret = 1;
+            // read without s_writeMutex, so only a hint: sendResponseRaw
+            // checks again before anything is queued
+            if (pRI->client != NULL && pRI->client->id != pRI->clientId) {
+                pRI->cancelled = 1;
+            }
 
-            *ppCur = (*ppCur)->p_next;
-            break;
+            // Shift later members of the probe run back into the hole,
+            // unless that would move them before their home slot
+            s_pendingRequests[i] = NULL;
+            for (;;) {
+                size_t home;
+
+                j = (j + 1) & mask;
+                if (s_pendingRequests[j] == NULL) {
+                    break;
+                }
+                home = pendingRequestHash(s_pendingRequests[j], s_pendingRequestsShift);
+                if ((i <= j) ? (i < home && home <= j) : (i < home || home <= j)) {
+                    continue;
+                }
+                s_pendingRequests[i] = s_pendingRequests[j];
+                s_pendingRequests[j] = NULL;
+                i = j;
+            }
+            s_pendingRequestsCount--;
         }
     }
 
@@ -2926,14 +4013,20 @@ RIL_onRequestComplete(RIL_Token t, RIL_Errno e, void *response, size_t responsel
         return;
     }
 
+    recordRequestLatency(pRI->pCI->requestNumber, REQUEST_COMPLETED, pRI->intakeUs);
+    recordRequestErrno(pRI->pCI->requestNumber, e);
+
     if (pRI->local > 0) {
         // Locally issued command...void only!
         // response does not go back up the command socket
-        ALOGD("C[locl]< %s", requestToString(pRI->pCI->requestNumber));
+        RIL_trace(RIL_TRACE_LOCAL_RESPONSE, pRI->pCI->requestNumber, e, 0);
 
         goto done;
     }
 
+    RIL_trace(RIL_TRACE_RESPONSE, pRI->token, pRI->pCI->requestNumber, e);
+
+    clearPrintBuf;
     appendPrintBuf("[%04d]< %s",
         pRI->token, requestToString(pRI->pCI->requestNumber));
 
@@ -2958,45 +4051,232 @@ RIL_onRequestComplete(RIL_Token t, RIL_Errno e, void *response, size_t responsel
         }
 
         if (e != RIL_E_SUCCESS) {
-            appendPrintBuf("%s fails by %s", printBuf, failCauseToString(e));
+            appendPrintBuf(" fails by %s", failCauseToString(e));
         }
 
-        if (s_fdCommand < 0) {
+        if (sendResponse(pRI, p) < 0) {
             ALOGD ("RIL onRequestComplete: Command channel closed");
         }
-        sendResponse(p);
     }
 
 done:
-    free(pRI);
+    ril_pool_free(&s_requestInfoPool, pRI);
 }
 
 
+/**
+ * Take a reference on the partial wake lock. The kernel lock is only
+ * taken when the first reference is.
+ */
 static void
 grabPartialWakeLock() {
-    acquire_wake_lock(PARTIAL_WAKE_LOCK, ANDROID_WAKE_LOCK_NAME);
+    pthread_mutex_lock(&s_wakeLockMutex);
+    s_wakeLockGrabs++;
+    if (s_wakeLockRefs++ == 0) {
+        acquire_wake_lock(PARTIAL_WAKE_LOCK, ANDROID_WAKE_LOCK_NAME);
+        s_wakeLockAcquisitions++;
+        s_wakeLockHeldSince = elapsedRealtime();
+    }
+    pthread_mutex_unlock(&s_wakeLockMutex);
 }
 
+/**
+ * Drop a reference taken by grabPartialWakeLock. The kernel lock is
+ * released with the last one.
+ */
 static void
 releaseWakeLock() {
-    release_wake_lock(ANDROID_WAKE_LOCK_NAME);
+    pthread_mutex_lock(&s_wakeLockMutex);
+    if (s_wakeLockRefs <= 0) {
+        ALOGE("releaseWakeLock: wake lock is not held");
+    } else if (--s_wakeLockRefs == 0) {
+        release_wake_lock(ANDROID_WAKE_LOCK_NAME);
+        s_wakeLockHeldMs += elapsedRealtime() - s_wakeLockHeldSince;
+    }
+    pthread_mutex_unlock(&s_wakeLockMutex);
 }
 
 /**
- * Timer callback to put us back to sleep before the default timeout
+ * Fires at the wake deadline, or at a deadline it has since been pushed
+ * past, in which case it waits out the rest
  */
 static void
-wakeTimeoutCallback (void *param) {
-    // We're using "param != NULL" as a cancellation mechanism
-    if (param == NULL) {
-        //ALOGD("wakeTimeout: releasing wake lock");
+wakeTimeoutCallback (int fd, short flags, void *param) {
+    struct timeval now;
+    struct timeval remaining;
+
+    pthread_mutex_lock(&s_wakeLockMutex);
+    ril_event_get_time(&now);
+    if (!(flags & RIL_EVENT_CANCELLED) && timercmp(&now, &s_wakeDeadline, <)) {
+        timersub(&s_wakeDeadline, &now, &remaining);
+        ril_timer_add(&s_wake_timeout_event, &remaining);
+        pthread_mutex_unlock(&s_wakeLockMutex);
+        return;
+    }
+    s_wakeTimerArmed = false;
+    pthread_mutex_unlock(&s_wakeLockMutex);
 
-        releaseWakeLock();
+    //ALOGD("wakeTimeout: releasing wake lock");
+    releaseWakeLock();
+}
+
+/**
+ * Keep the wake lock held for at least timeout from now. A single timer
+ * holds one reference for as long as there is a deadline; moving the
+ * deadline only moves a time, so bursts cost no timers or sysfs writes.
+ */
+static void
+holdWakeLock(const struct timeval *timeout) {
+    struct timeval now;
+    struct timeval deadline;
+    bool arm = false;
+
+    grabPartialWakeLock();
+
+    pthread_mutex_lock(&s_wakeLockMutex);
+    ril_event_get_time(&now);
+    timeradd(&now, timeout, &deadline);
+    if (timercmp(&deadline, &s_wakeDeadline, >)) {
+        s_wakeDeadline = deadline;
+    }
+    if (!s_wakeTimerArmed) {
+        // the timer takes over the reference grabbed above
+        s_wakeTimerArmed = true;
+        arm = true;
+        ril_event_set(&s_wake_timeout_event, -1, false, wakeTimeoutCallback, NULL);
+        ril_timer_add(&s_wake_timeout_event, (struct timeval *) timeout);
+    }
+    pthread_mutex_unlock(&s_wakeLockMutex);
+
+    if (arm) {
+        triggerEvLoop();
     } else {
-        //ALOGD("wakeTimeout: releasing wake lock CANCELLED");
+        releaseWakeLock();
     }
 }
 
+/**
+ * Send the response held back for an unsolicited response, if any
+ */
+static void
+flushCoalesced(int unsolResponseIndex) {
+    CoalesceState *state = &s_coalesceState[unsolResponseIndex];
+    bool wake = (s_unsolResponses[unsolResponseIndex].wakeType == WAKE_PARTIAL);
+    void *held;
+    size_t heldSize;
+
+    pthread_mutex_lock(&s_coalesceMutex);
+    held = state->held;
+    heldSize = state->heldSize;
+    state->held = NULL;
+    if (held != NULL) {
+        state->lastSent = elapsedRealtime();
+    }
+    pthread_mutex_unlock(&s_coalesceMutex);
+
+    if (held == NULL) {
+        return;
+    }
+
+    sendUnsolicitedRaw(NULL, held, heldSize, unsolResponseIndex + RIL_UNSOL_RESPONSE_BASE);
+    free(held);
+
+    // drop the reference coalesceUnsolicited took for it
+    if (wake) {
+        holdWakeLock(&TIMEVAL_WAKE_TIMEOUT);
+        releaseWakeLock();
+    }
+}
+
+static void
+coalesceTimerCallback(void *param) {
+    flushCoalesced((int) (intptr_t) param);
+}
+
+/**
+ * Returns true if the marshalled response in p is to be held back rather
+ * than sent now. It then replaces any older one still held for the same
+ * ID, and goes out from the event loop when the window closes.
+ */
+static bool
+coalesceUnsolicited(int unsolResponseIndex, Parcel &p) {
+    CoalesceState *state = &s_coalesceState[unsolResponseIndex];
+    bool wake = (s_unsolResponses[unsolResponseIndex].wakeType == WAKE_PARTIAL);
+    struct timeval delay;
+    int64_t window;
+    int64_t now;
+    void *copy;
+
+    switch (s_unsolResponses[unsolResponseIndex].coalescePolicy) {
+        case COALESCE_COLLAPSE:
+            window = s_collapseWindowMs;
+            break;
+        case COALESCE_LATEST:
+            window = s_minIntervalMs;
+            break;
+        case COALESCE_NONE:
+        default:
+            return false;
+    }
+    if (window <= 0) {
+        return false;
+    }
+
+    now = elapsedRealtime();
+
+    pthread_mutex_lock(&s_coalesceMutex);
+
+    if (state->held == NULL && now - state->lastSent >= window) {
+        state->lastSent = now;
+        pthread_mutex_unlock(&s_coalesceMutex);
+        return false;
+    }
+
+    copy = malloc(p.dataSize());
+    if (copy == NULL) {
+        // send this one now; the one it supersedes must not follow it
+        if (state->held != NULL) {
+            free(state->held);
+            state->held = NULL;
+            state->suppressed++;
+            if (wake) {
+                releaseWakeLock();
+            }
+        }
+        state->lastSent = now;
+        pthread_mutex_unlock(&s_coalesceMutex);
+        return false;
+    }
+    memcpy(copy, p.data(), p.dataSize());
+
+    if (state->held != NULL) {
+        // the timer is already running
+        free(state->held);
+        state->held = copy;
+        state->heldSize = p.dataSize();
+        state->suppressed++;
+        pthread_mutex_unlock(&s_coalesceMutex);
+        return true;
+    }
+
+    // the held response keeps the device awake until it has been sent
+    if (wake) {
+        grabPartialWakeLock();
+    }
+    state->held = copy;
+    state->heldSize = p.dataSize();
+    window -= now - state->lastSent;
+    pthread_mutex_unlock(&s_coalesceMutex);
+
+    delay.tv_sec = window / 1000;
+    delay.tv_usec = (window % 1000) * 1000;
+    if (internalRequestTimedCallback(coalesceTimerCallback,
+            (void *) (intptr_t) unsolResponseIndex, &delay, NULL) == NULL) {
+        flushCoalesced(unsolResponseIndex);
+    }
+    return true;
+}
+
 static int
 decodeVoiceRadioTechnology (RIL_RadioState radioState) {
     switch (radioState) {
@@ -3114,8 +4394,12 @@ processRadioState(RIL_RadioState newRadioState) {
     return newRadioState;
 }
 
-extern "C"
-void RIL_onUnsolicitedResponse(int unsolResponse, void *data,
+/**
+ * Marshal an unsolicited response and send it to the clients subscribed
+ * to it, or only to target if that is not NULL
+ */
+static void
+onUnsolicitedResponse(RilClient *target, int unsolResponse, void *data,
                                 size_t datalen)
 {
     int unsolResponseIndex;
@@ -3138,6 +4422,15 @@ void RIL_onUnsolicitedResponse(int unsolResponse, void *data,
         return;
     }
 
+    // Nobody to send it to. Radio state changes and NITZ are handled
+    // regardless: the former updates our idea of the radio state, the
+    // latter is kept for the next client
+    if (target == NULL && !hasUnsolSubscriber(unsolResponseIndex)
+            && unsolResponse != RIL_UNSOL_RESPONSE_RADIO_STATE_CHANGED
+            && unsolResponse != RIL_UNSOL_NITZ_TIME_RECEIVED) {
+        return;
+    }
+
     // Grab a wake lock if needed for this reponse,
     // as we exit we'll either release it immediately
     // or set a timer to release it later.
@@ -3162,6 +4455,9 @@ void RIL_onUnsolicitedResponse(int unsolResponse, void *data,
         timeReceived = elapsedRealtime();
     }
 
+    RIL_trace(RIL_TRACE_UNSOL, unsolResponse, 0, 0);
+
+    clearPrintBuf;
     appendPrintBuf("[UNSL]< %s", requestToString(unsolResponse));
 
     Parcel p;
@@ -3181,7 +4477,7 @@ void RIL_onUnsolicitedResponse(int unsolResponse, void *data,
         case RIL_UNSOL_RESPONSE_RADIO_STATE_CHANGED:
             newState = processRadioState(s_callbacks.onStateRequest());
             p.writeInt32(newState);
-            appendPrintBuf("%s {%s}", printBuf,
+            appendPrintBuf(" {%s}",
                 radioStateToString(s_callbacks.onStateRequest()));
         break;
 
@@ -3196,36 +4492,38 @@ void RIL_onUnsolicitedResponse(int unsolResponse, void *data,
         break;
     }
 
-    ret = sendResponse(p);
-    if (ret != 0 && unsolResponse == RIL_UNSOL_NITZ_TIME_RECEIVED) {
-
+    if (target == NULL && unsolResponse == RIL_UNSOL_NITZ_TIME_RECEIVED) {
         // Unfortunately, NITZ time is not poll/update like everything
-        // else in the system. So, if the upstream client isn't connected,
-        // keep a copy of the last NITZ response (with receive time noted
-        // above) around so we can deliver it when it is connected
-
-        if (s_lastNITZTimeData != NULL) {
-            free (s_lastNITZTimeData);
-            s_lastNITZTimeData = NULL;
+        // else in the system. So keep a copy of the last NITZ response
+        // (with receive time noted above) around, so we can deliver it
+        // to any client that connects or subscribes to it later, such
+        // as the phone process coming back after a restart
+        void *copy = malloc(p.dataSize());
+
+        if (copy != NULL) {
+            memcpy(copy, p.data(), p.dataSize());
         }
 
-        s_lastNITZTimeData = malloc(p.dataSize());
-        s_lastNITZTimeDataSize = p.dataSize();
-        memcpy(s_lastNITZTimeData, p.data(), p.dataSize());
+        pthread_mutex_lock(&s_lastNITZMutex);
+        free(s_lastNITZTimeData);
+        s_lastNITZTimeData = copy;
+        s_lastNITZTimeDataSize = (copy != NULL) ? p.dataSize() : 0;
+        pthread_mutex_unlock(&s_lastNITZMutex);
+    }
+
+    if (target == NULL && coalesceUnsolicited(unsolResponseIndex, p)) {
+        goto send_done;
     }
 
+    ret = sendUnsolResponse(target, p, unsolResponse);
+
+send_done:
     // For now, we automatically go back to sleep after TIMEVAL_WAKE_TIMEOUT
     // FIXME The java code should handshake here to release wake lock
 
     if (shouldScheduleTimeout) {
-        // Cancel the previous request
-        if (s_last_wake_timeout_info != NULL) {
-            s_last_wake_timeout_info->userParam = (void *)1;
-        }
-
-        s_last_wake_timeout_info
-            = internalRequestTimedCallback(wakeTimeoutCallback, NULL,
-                                            &TIMEVAL_WAKE_TIMEOUT);
+        holdWakeLock(&TIMEVAL_WAKE_TIMEOUT);
+        releaseWakeLock();
     }
 
     // Normal exit
@@ -3237,20 +4535,116 @@ error_exit:
     }
 }
 
-/** FIXME generalize this if you track UserCAllbackInfo, clear it
-    when the callback occurs
-*/
+extern "C"
+void RIL_onUnsolicitedResponse(int unsolResponse, void *data,
+                                size_t datalen)
+{
+    onUnsolicitedResponse(NULL, unsolResponse, data, datalen);
+}
+
+/**
+ * Claim a handle slot for p_info. Called with s_timedCallbackMutex held.
+ * Returns NULL if no slot is available.
+ */
+static RIL_TimedCallbackHandle
+claimTimedCallbackSlot(UserCallbackInfo *p_info) {
+    int slot;
+
+    if (s_timedCallbackFreeSlot < 0) {
+        int size = (s_timedCallbackSlotsSize == 0) ? 16 : s_timedCallbackSlotsSize * 2;
+        TimedCallbackSlot *slots;
+
+        if (size > TIMED_CALLBACK_SLOT_MAX) {
+            return NULL;
+        }
+        slots = (TimedCallbackSlot *) realloc(s_timedCallbackSlots,
+                                            size * sizeof(TimedCallbackSlot));
+        if (slots == NULL) {
+            return NULL;
+        }
+        for (int i = s_timedCallbackSlotsSize; i < size; i++) {
+            slots[i].p_info = NULL;
+            slots[i].generation = 0;
+            slots[i].nextFree = (i + 1 < size) ? i + 1 : -1;
+        }
+        s_timedCallbackFreeSlot = s_timedCallbackSlotsSize;
+        s_timedCallbackFreeTail = size - 1;
+        s_timedCallbackSlots = slots;
+        s_timedCallbackSlotsSize = size;
+    }
+
+    slot = s_timedCallbackFreeSlot;
+    s_timedCallbackFreeSlot = s_timedCallbackSlots[slot].nextFree;
+    if (s_timedCallbackFreeSlot < 0) {
+        s_timedCallbackFreeTail = -1;
+    }
+
+    // generation 0 is skipped so that a handle is never NULL
+    s_timedCallbackSlots[slot].generation =
+            (s_timedCallbackSlots[slot].generation + 1) & TIMED_CALLBACK_GENERATION_MASK;
+    if (s_timedCallbackSlots[slot].generation == 0) {
+        s_timedCallbackSlots[slot].generation = 1;
+    }
+    s_timedCallbackSlots[slot].p_info = p_info;
+    p_info->slot = slot;
+
+    return (RIL_TimedCallbackHandle) (uintptr_t)
+        ((s_timedCallbackSlots[slot].generation << TIMED_CALLBACK_SLOT_BITS) | slot);
+}
+
+/**
+ * Called with s_timedCallbackMutex held. Does not touch the
+ * UserCallbackInfo, which may already be gone after a cancel.
+ */
+static void
+releaseTimedCallbackSlot(int slot) {
+    s_timedCallbackSlots[slot].p_info = NULL;
+    s_timedCallbackSlots[slot].nextFree = -1;
+    if (s_timedCallbackFreeTail < 0) {
+        s_timedCallbackFreeSlot = slot;
+    } else {
+        s_timedCallbackSlots[s_timedCallbackFreeTail].nextFree = slot;
+    }
+    s_timedCallbackFreeTail = slot;
+}
+
+/**
+ * If pHandle is not NULL, a cancellation handle is stored there before
+ * the timer is armed. If no handle can be allocated, *pHandle is set
+ * to NULL and the callback is not scheduled.
+ */
 static UserCallbackInfo *
 internalRequestTimedCallback (RIL_TimedCallback callback, void *param,
-                                const struct timeval *relativeTime)
+                                const struct timeval *relativeTime,
+                                RIL_TimedCallbackHandle *pHandle)
 {
     struct timeval myRelativeTime;
     UserCallbackInfo *p_info;
 
-    p_info = (UserCallbackInfo *) malloc (sizeof(UserCallbackInfo));
+    p_info = (UserCallbackInfo *) ril_pool_alloc(&s_userCallbackPool);
+    if (p_info == NULL) {
+        ALOGE("RIL_requestTimedCallback: out of memory");
+        if (pHandle != NULL) {
+            *pHandle = NULL;
+        }
+        return NULL;
+    }
 
     p_info->p_callback = callback;
     p_info->userParam = param;
+    p_info->slot = -1;
+
+    if (pHandle != NULL) {
+        pthread_mutex_lock(&s_timedCallbackMutex);
+        *pHandle = claimTimedCallbackSlot(p_info);
+        pthread_mutex_unlock(&s_timedCallbackMutex);
+
+        if (*pHandle == NULL) {
+            ALOGE("RIL_requestTimedCallbackEx: out of callback handles");
+            ril_pool_free(&s_userCallbackPool, p_info);
+            return NULL;
+        }
+    }
 
     if (relativeTime == NULL) {
         /* treat null parameter as a 0 relative time */
@@ -3261,6 +4655,9 @@ internalRequestTimedCallback (RIL_TimedCallback callback, void *param,
     }
 
     ril_event_set(&(p_info->event), -1, false, userTimerCallback, p_info);
+    // Every vendor timer goes through userTimerCallback; time each under
+    // the vendor callback it runs instead
+    ril_event_set_stats_key(&(p_info->event), (const void *) callback);
 
     ril_timer_add(&(p_info->event), &myRelativeTime);
 
@@ -3269,223 +4666,157 @@ internalRequestTimedCallback (RIL_TimedCallback callback, void *param,
 }
 
 
+static int
+internalCancelTimedCallback(RIL_TimedCallbackHandle handle) {
+    uint32_t value = (uint32_t) (uintptr_t) handle;
+    int slot = value & (TIMED_CALLBACK_SLOT_MAX - 1);
+    uint32_t generation = value >> TIMED_CALLBACK_SLOT_BITS;
+    UserCallbackInfo *p_info;
+
+    pthread_mutex_lock(&s_timedCallbackMutex);
+
+    if (slot >= s_timedCallbackSlotsSize
+            || s_timedCallbackSlots[slot].generation != generation
+            || s_timedCallbackSlots[slot].p_info == NULL) {
+        pthread_mutex_unlock(&s_timedCallbackMutex);
+        return -1;
+    }
+
+    p_info = s_timedCallbackSlots[slot].p_info;
+
+    // The slot is still claimed, so the callback has not started; this
+    // only fails if the loop thread is about to fire it
+    if (!ril_event_del(&(p_info->event))) {
+        pthread_mutex_unlock(&s_timedCallbackMutex);
+        return -1;
+    }
+
+    // p_info now belongs to the loop, which frees it through
+    // userTimerCallback
+    releaseTimedCallbackSlot(slot);
+    pthread_mutex_unlock(&s_timedCallbackMutex);
+
+    triggerEvLoop();
+    return 0;
+}
+
 extern "C" void
 RIL_requestTimedCallback (RIL_TimedCallback callback, void *param,
                                 const struct timeval *relativeTime) {
-    internalRequestTimedCallback (callback, param, relativeTime);
+    internalRequestTimedCallback (callback, param, relativeTime, NULL);
 }
 
+extern "C" RIL_TimedCallbackHandle
+RIL_requestTimedCallbackEx (RIL_TimedCallback callback, void *param,
+                                const struct timeval *relativeTime) {
+    RIL_TimedCallbackHandle handle;
+
+    internalRequestTimedCallback (callback, param, relativeTime, &handle);
+    return handle;
+}
+
+extern "C" int
+RIL_cancelTimedCallback (RIL_TimedCallbackHandle handle) {
+    if (handle == NULL) {
+        return -1;
+    }
+    return internalCancelTimedCallback(handle);
+}
+
+/* Indexed by RIL_Errno */
+static const char * const s_failCauseNames[] = {
+    "E_SUCCESS",
+    "E_RADIO_NOT_AVAILABLE",
+    "E_GENERIC_FAILURE",
+    "E_PASSWORD_INCORRECT",
+    "E_SIM_PIN2",
+    "E_SIM_PUK2",
+    "E_REQUEST_NOT_SUPPORTED",
+    "E_CANCELLED",
+    "E_OP_NOT_ALLOWED_DURING_VOICE_CALL",
+    "E_OP_NOT_ALLOWED_BEFORE_REG_TO_NW",
+    "E_SMS_SEND_FAIL_RETRY",
+    "E_SIM_ABSENT",
+    "E_SUBSCRIPTION_NOT_AVAILABLE",
+    "E_MODE_NOT_SUPPORTED",
+    "E_FDN_CHECK_FAILURE",
+    "E_ILLEGAL_SIM_OR_ME",
+};
+RIL_COMPILE_ASSERT(NUM_ELEMS(s_failCauseNames) == RIL_E_ILLEGAL_SIM_OR_ME + 1,
+        s_failCauseNames_does_not_match_RIL_Errno);
+
+/* Indexed by RIL_RadioState */
+static const char * const s_radioStateNames[] = {
+    "RADIO_OFF",
+    "RADIO_UNAVAILABLE",
+    "RADIO_SIM_NOT_READY",
+    "RADIO_SIM_LOCKED_OR_ABSENT",
+    "RADIO_SIM_READY",
+    "RADIO_RUIM_NOT_READY",
+    "RADIO_RUIM_READY",
+    "RADIO_RUIM_LOCKED_OR_ABSENT",
+    "RADIO_NV_NOT_READY",
+    "RADIO_NV_READY",
+    "RADIO_ON",
+};
+RIL_COMPILE_ASSERT(NUM_ELEMS(s_radioStateNames) == RADIO_STATE_ON + 1,
+        s_radioStateNames_does_not_match_RIL_RadioState);
+
+/* Indexed by RIL_CallState */
+static const char * const s_callStateNames[] = {
+    "ACTIVE",
+    "HOLDING",
+    "DIALING",
+    "ALERTING",
+    "INCOMING",
+    "WAITING",
+};
+RIL_COMPILE_ASSERT(NUM_ELEMS(s_callStateNames) == RIL_CALL_WAITING + 1,
+        s_callStateNames_does_not_match_RIL_CallState);
+
 const char *
 failCauseToString(RIL_Errno e) {
-    switch(e) {
-        case RIL_E_SUCCESS: return "E_SUCCESS";
-        case RIL_E_RADIO_NOT_AVAILABLE: return "E_RAIDO_NOT_AVAILABLE";
-        case RIL_E_GENERIC_FAILURE: return "E_GENERIC_FAILURE";
-        case RIL_E_PASSWORD_INCORRECT: return "E_PASSWORD_INCORRECT";
-        case RIL_E_SIM_PIN2: return "E_SIM_PIN2";
-        case RIL_E_SIM_PUK2: return "E_SIM_PUK2";
-        case RIL_E_REQUEST_NOT_SUPPORTED: return "E_REQUEST_NOT_SUPPORTED";
-        case RIL_E_CANCELLED: return "E_CANCELLED";
-        case RIL_E_OP_NOT_ALLOWED_DURING_VOICE_CALL: return "E_OP_NOT_ALLOWED_DURING_VOICE_CALL";
-        case RIL_E_OP_NOT_ALLOWED_BEFORE_REG_TO_NW: return "E_OP_NOT_ALLOWED_BEFORE_REG_TO_NW";
-        case RIL_E_SMS_SEND_FAIL_RETRY: return "E_SMS_SEND_FAIL_RETRY";
-        case RIL_E_SIM_ABSENT:return "E_SIM_ABSENT";
-        case RIL_E_ILLEGAL_SIM_OR_ME:return "E_ILLEGAL_SIM_OR_ME";
-#ifdef FEATURE_MULTIMODE_ANDROID
-        case RIL_E_SUBSCRIPTION_NOT_AVAILABLE:return "E_SUBSCRIPTION_NOT_AVAILABLE";
-        case RIL_E_MODE_NOT_SUPPORTED:return "E_MODE_NOT_SUPPORTED";
-#endif
-        default: return "<unknown error>";
+    if ((unsigned int) e < NUM_ELEMS(s_failCauseNames)) {
+        return s_failCauseNames[e];
     }
+    return "<unknown error>";
 }
 
 const char *
 radioStateToString(RIL_RadioState s) {
-    switch(s) {
-        case RADIO_STATE_OFF: return "RADIO_OFF";
-        case RADIO_STATE_UNAVAILABLE: return "RADIO_UNAVAILABLE";
-        case RADIO_STATE_SIM_NOT_READY: return "RADIO_SIM_NOT_READY";
-        case RADIO_STATE_SIM_LOCKED_OR_ABSENT: return "RADIO_SIM_LOCKED_OR_ABSENT";
-        case RADIO_STATE_SIM_READY: return "RADIO_SIM_READY";
-        case RADIO_STATE_RUIM_NOT_READY:return"RADIO_RUIM_NOT_READY";
-        case RADIO_STATE_RUIM_READY:return"RADIO_RUIM_READY";
-        case RADIO_STATE_RUIM_LOCKED_OR_ABSENT:return"RADIO_RUIM_LOCKED_OR_ABSENT";
-        case RADIO_STATE_NV_NOT_READY:return"RADIO_NV_NOT_READY";
-        case RADIO_STATE_NV_READY:return"RADIO_NV_READY";
-        case RADIO_STATE_ON:return"RADIO_ON";
-        default: return "<unknown state>";
+    if ((unsigned int) s < NUM_ELEMS(s_radioStateNames)) {
+        return s_radioStateNames[s];
     }
+    return "<unknown state>";
 }
 
 const char *
 callStateToString(RIL_CallState s) {
-    switch(s) {
-        case RIL_CALL_ACTIVE : return "ACTIVE";
-        case RIL_CALL_HOLDING: return "HOLDING";
-        case RIL_CALL_DIALING: return "DIALING";
-        case RIL_CALL_ALERTING: return "ALERTING";
-        case RIL_CALL_INCOMING: return "INCOMING";
-        case RIL_CALL_WAITING: return "WAITING";
-        default: return "<unknown state>";
+    if ((unsigned int) s < NUM_ELEMS(s_callStateNames)) {
+        return s_callStateNames[s];
     }
+    return "<unknown state>";
 }
 
+/**
+ * Name of a request or unsolicited response, from the tables in
+ * ril_commands.h and ril_unsol_commands.h
+ */
 const char *
 requestToString(int request) {
-/*
- cat libs/telephony/ril_commands.h \
- | egrep "^ *{RIL_" \
- | sed -re 's/\{RIL_([^,]+),[^,]+,([^}]+).+/case RIL_\1: return "\1";/'
-
-
- cat libs/telephony/ril_unsol_commands.h \
- | egrep "^ *{RIL_" \
- | sed -re 's/\{RIL_([^,]+),([^}]+).+/case RIL_\1: return "\1";/'
+    unsigned int unsolIndex = request - RIL_UNSOL_RESPONSE_BASE;
 
-*/
-    switch(request) {
-        case RIL_REQUEST_GET_SIM_STATUS: return "GET_SIM_STATUS";
-        case RIL_REQUEST_ENTER_SIM_PIN: return "ENTER_SIM_PIN";
-        case RIL_REQUEST_ENTER_SIM_PUK: return "ENTER_SIM_PUK";
-        case RIL_REQUEST_ENTER_SIM_PIN2: return "ENTER_SIM_PIN2";
-        case RIL_REQUEST_ENTER_SIM_PUK2: return "ENTER_SIM_PUK2";
-        case RIL_REQUEST_CHANGE_SIM_PIN: return "CHANGE_SIM_PIN";
-        case RIL_REQUEST_CHANGE_SIM_PIN2: return "CHANGE_SIM_PIN2";
-        case RIL_REQUEST_ENTER_NETWORK_DEPERSONALIZATION: return "ENTER_NETWORK_DEPERSONALIZATION";
-        case RIL_REQUEST_GET_CURRENT_CALLS: return "GET_CURRENT_CALLS";
-        case RIL_REQUEST_DIAL: return "DIAL";
-        case RIL_REQUEST_GET_IMSI: return "GET_IMSI";
-        case RIL_REQUEST_HANGUP: return "HANGUP";
-        case RIL_REQUEST_HANGUP_WAITING_OR_BACKGROUND: return "HANGUP_WAITING_OR_BACKGROUND";
-        case RIL_REQUEST_HANGUP_FOREGROUND_RESUME_BACKGROUND: return "HANGUP_FOREGROUND_RESUME_BACKGROUND";
-        case RIL_REQUEST_SWITCH_WAITING_OR_HOLDING_AND_ACTIVE: return "SWITCH_WAITING_OR_HOLDING_AND_ACTIVE";
-        case RIL_REQUEST_CONFERENCE: return "CONFERENCE";
-        case RIL_REQUEST_UDUB: return "UDUB";
-        case RIL_REQUEST_LAST_CALL_FAIL_CAUSE: return "LAST_CALL_FAIL_CAUSE";
-        case RIL_REQUEST_SIGNAL_STRENGTH: return "SIGNAL_STRENGTH";
-        case RIL_REQUEST_VOICE_REGISTRATION_STATE: return "VOICE_REGISTRATION_STATE";
-        case RIL_REQUEST_DATA_REGISTRATION_STATE: return "DATA_REGISTRATION_STATE";
-        case RIL_REQUEST_OPERATOR: return "OPERATOR";
-        case RIL_REQUEST_RADIO_POWER: return "RADIO_POWER";
-        case RIL_REQUEST_DTMF: return "DTMF";
-        case RIL_REQUEST_SEND_SMS: return "SEND_SMS";
-        case RIL_REQUEST_SEND_SMS_EXPECT_MORE: return "SEND_SMS_EXPECT_MORE";
-        case RIL_REQUEST_SETUP_DATA_CALL: return "SETUP_DATA_CALL";
-        case RIL_REQUEST_SIM_IO: return "SIM_IO";
-        case RIL_REQUEST_SEND_USSD: return "SEND_USSD";
-        case RIL_REQUEST_CANCEL_USSD: return "CANCEL_USSD";
-        case RIL_REQUEST_GET_CLIR: return "GET_CLIR";
-        case RIL_REQUEST_SET_CLIR: return "SET_CLIR";
-        case RIL_REQUEST_QUERY_CALL_FORWARD_STATUS: return "QUERY_CALL_FORWARD_STATUS";
-        case RIL_REQUEST_SET_CALL_FORWARD: return "SET_CALL_FORWARD";
-        case RIL_REQUEST_QUERY_CALL_WAITING: return "QUERY_CALL_WAITING";
-        case RIL_REQUEST_SET_CALL_WAITING: return "SET_CALL_WAITING";
-        case RIL_REQUEST_SMS_ACKNOWLEDGE: return "SMS_ACKNOWLEDGE";
-        case RIL_REQUEST_GET_IMEI: return "GET_IMEI";
-        case RIL_REQUEST_GET_IMEISV: return "GET_IMEISV";
-        case RIL_REQUEST_ANSWER: return "ANSWER";
-        case RIL_REQUEST_DEACTIVATE_DATA_CALL: return "DEACTIVATE_DATA_CALL";
-        case RIL_REQUEST_QUERY_FACILITY_LOCK: return "QUERY_FACILITY_LOCK";
-        case RIL_REQUEST_SET_FACILITY_LOCK: return "SET_FACILITY_LOCK";
-        case RIL_REQUEST_CHANGE_BARRING_PASSWORD: return "CHANGE_BARRING_PASSWORD";
-        case RIL_REQUEST_QUERY_NETWORK_SELECTION_MODE: return "QUERY_NETWORK_SELECTION_MODE";
-        case RIL_REQUEST_SET_NETWORK_SELECTION_AUTOMATIC: return "SET_NETWORK_SELECTION_AUTOMATIC";
-        case RIL_REQUEST_SET_NETWORK_SELECTION_MANUAL: return "SET_NETWORK_SELECTION_MANUAL";
-        case RIL_REQUEST_QUERY_AVAILABLE_NETWORKS : return "QUERY_AVAILABLE_NETWORKS ";
-        case RIL_REQUEST_DTMF_START: return "DTMF_START";
-        case RIL_REQUEST_DTMF_STOP: return "DTMF_STOP";
-        case RIL_REQUEST_BASEBAND_VERSION: return "BASEBAND_VERSION";
-        case RIL_REQUEST_SEPARATE_CONNECTION: return "SEPARATE_CONNECTION";
-        case RIL_REQUEST_SET_PREFERRED_NETWORK_TYPE: return "SET_PREFERRED_NETWORK_TYPE";
-        case RIL_REQUEST_GET_PREFERRED_NETWORK_TYPE: return "GET_PREFERRED_NETWORK_TYPE";
-        case RIL_REQUEST_GET_NEIGHBORING_CELL_IDS: return "GET_NEIGHBORING_CELL_IDS";
-        case RIL_REQUEST_SET_MUTE: return "SET_MUTE";
-        case RIL_REQUEST_GET_MUTE: return "GET_MUTE";
-        case RIL_REQUEST_QUERY_CLIP: return "QUERY_CLIP";
-        case RIL_REQUEST_LAST_DATA_CALL_FAIL_CAUSE: return "LAST_DATA_CALL_FAIL_CAUSE";
-        case RIL_REQUEST_DATA_CALL_LIST: return "DATA_CALL_LIST";
-        case RIL_REQUEST_RESET_RADIO: return "RESET_RADIO";
-        case RIL_REQUEST_OEM_HOOK_RAW: return "OEM_HOOK_RAW";
-        case RIL_REQUEST_OEM_HOOK_STRINGS: return "OEM_HOOK_STRINGS";
-        case RIL_REQUEST_SET_BAND_MODE: return "SET_BAND_MODE";
-        case RIL_REQUEST_QUERY_AVAILABLE_BAND_MODE: return "QUERY_AVAILABLE_BAND_MODE";
-        case RIL_REQUEST_STK_GET_PROFILE: return "STK_GET_PROFILE";
-        case RIL_REQUEST_STK_SET_PROFILE: return "STK_SET_PROFILE";
-        case RIL_REQUEST_STK_SEND_ENVELOPE_COMMAND: return "STK_SEND_ENVELOPE_COMMAND";
-        case RIL_REQUEST_STK_SEND_TERMINAL_RESPONSE: return "STK_SEND_TERMINAL_RESPONSE";
-        case RIL_REQUEST_STK_HANDLE_CALL_SETUP_REQUESTED_FROM_SIM: return "STK_HANDLE_CALL_SETUP_REQUESTED_FROM_SIM";
-        case RIL_REQUEST_SCREEN_STATE: return "SCREEN_STATE";
-        case RIL_REQUEST_EXPLICIT_CALL_TRANSFER: return "EXPLICIT_CALL_TRANSFER";
-        case RIL_REQUEST_SET_LOCATION_UPDATES: return "SET_LOCATION_UPDATES";
-        case RIL_REQUEST_CDMA_SET_SUBSCRIPTION_SOURCE:return"CDMA_SET_SUBSCRIPTION_SOURCE";
-        case RIL_REQUEST_CDMA_SET_ROAMING_PREFERENCE:return"CDMA_SET_ROAMING_PREFERENCE";
-        case RIL_REQUEST_CDMA_QUERY_ROAMING_PREFERENCE:return"CDMA_QUERY_ROAMING_PREFERENCE";
-        case RIL_REQUEST_SET_TTY_MODE:return"SET_TTY_MODE";
-        case RIL_REQUEST_QUERY_TTY_MODE:return"QUERY_TTY_MODE";
-        case RIL_REQUEST_CDMA_SET_PREFERRED_VOICE_PRIVACY_MODE:return"CDMA_SET_PREFERRED_VOICE_PRIVACY_MODE";
-        case RIL_REQUEST_CDMA_QUERY_PREFERRED_VOICE_PRIVACY_MODE:return"CDMA_QUERY_PREFERRED_VOICE_PRIVACY_MODE";
-        case RIL_REQUEST_CDMA_FLASH:return"CDMA_FLASH";
-        case RIL_REQUEST_CDMA_BURST_DTMF:return"CDMA_BURST_DTMF";
-        case RIL_REQUEST_CDMA_SEND_SMS:return"CDMA_SEND_SMS";
-        case RIL_REQUEST_CDMA_SMS_ACKNOWLEDGE:return"CDMA_SMS_ACKNOWLEDGE";
-        case RIL_REQUEST_GSM_GET_BROADCAST_SMS_CONFIG:return"GSM_GET_BROADCAST_SMS_CONFIG";
-        case RIL_REQUEST_GSM_SET_BROADCAST_SMS_CONFIG:return"GSM_SET_BROADCAST_SMS_CONFIG";
-        case RIL_REQUEST_CDMA_GET_BROADCAST_SMS_CONFIG:return "CDMA_GET_BROADCAST_SMS_CONFIG";
-        case RIL_REQUEST_CDMA_SET_BROADCAST_SMS_CONFIG:return "CDMA_SET_BROADCAST_SMS_CONFIG";
-        case RIL_REQUEST_CDMA_SMS_BROADCAST_ACTIVATION:return "CDMA_SMS_BROADCAST_ACTIVATION";
-        case RIL_REQUEST_CDMA_VALIDATE_AND_WRITE_AKEY: return"CDMA_VALIDATE_AND_WRITE_AKEY";
-        case RIL_REQUEST_CDMA_SUBSCRIPTION: return"CDMA_SUBSCRIPTION";
-        case RIL_REQUEST_CDMA_WRITE_SMS_TO_RUIM: return "CDMA_WRITE_SMS_TO_RUIM";
-        case RIL_REQUEST_CDMA_DELETE_SMS_ON_RUIM: return "CDMA_DELETE_SMS_ON_RUIM";
-        case RIL_REQUEST_DEVICE_IDENTITY: return "DEVICE_IDENTITY";
-        case RIL_REQUEST_EXIT_EMERGENCY_CALLBACK_MODE: return "EXIT_EMERGENCY_CALLBACK_MODE";
-        case RIL_REQUEST_GET_SMSC_ADDRESS: return "GET_SMSC_ADDRESS";
-        case RIL_REQUEST_SET_SMSC_ADDRESS: return "SET_SMSC_ADDRESS";
-        case RIL_REQUEST_REPORT_SMS_MEMORY_STATUS: return "REPORT_SMS_MEMORY_STATUS";
-        case RIL_REQUEST_REPORT_STK_SERVICE_IS_RUNNING: return "REPORT_STK_SERVICE_IS_RUNNING";
-        case RIL_REQUEST_CDMA_GET_SUBSCRIPTION_SOURCE: return "CDMA_GET_SUBSCRIPTION_SOURCE";
-        case RIL_REQUEST_ISIM_AUTHENTICATION: return "ISIM_AUTHENTICATION";
-        case RIL_REQUEST_ACKNOWLEDGE_INCOMING_GSM_SMS_WITH_PDU: return "RIL_REQUEST_ACKNOWLEDGE_INCOMING_GSM_SMS_WITH_PDU";
-        case RIL_REQUEST_STK_SEND_ENVELOPE_WITH_STATUS: return "RIL_REQUEST_STK_SEND_ENVELOPE_WITH_STATUS";
-        case RIL_REQUEST_VOICE_RADIO_TECH: return "VOICE_RADIO_TECH";
-        case RIL_REQUEST_GET_UNLOCK_RETRY_COUNT: return "GET_UNLOCK_RETRY_COUNT";
-        case RIL_UNSOL_RESPONSE_RADIO_STATE_CHANGED: return "UNSOL_RESPONSE_RADIO_STATE_CHANGED";
-        case RIL_UNSOL_RESPONSE_CALL_STATE_CHANGED: return "UNSOL_RESPONSE_CALL_STATE_CHANGED";
-        case RIL_UNSOL_RESPONSE_VOICE_NETWORK_STATE_CHANGED: return "UNSOL_RESPONSE_VOICE_NETWORK_STATE_CHANGED";
-        case RIL_UNSOL_RESPONSE_NEW_SMS: return "UNSOL_RESPONSE_NEW_SMS";
-        case RIL_UNSOL_RESPONSE_NEW_SMS_STATUS_REPORT: return "UNSOL_RESPONSE_NEW_SMS_STATUS_REPORT";
-        case RIL_UNSOL_RESPONSE_NEW_SMS_ON_SIM: return "UNSOL_RESPONSE_NEW_SMS_ON_SIM";
-        case RIL_UNSOL_ON_USSD: return "UNSOL_ON_USSD";
-        case RIL_UNSOL_ON_USSD_REQUEST: return "UNSOL_ON_USSD_REQUEST(obsolete)";
-        case RIL_UNSOL_NITZ_TIME_RECEIVED: return "UNSOL_NITZ_TIME_RECEIVED";
-        case RIL_UNSOL_SIGNAL_STRENGTH: return "UNSOL_SIGNAL_STRENGTH";
-        case RIL_UNSOL_STK_SESSION_END: return "UNSOL_STK_SESSION_END";
-        case RIL_UNSOL_STK_PROACTIVE_COMMAND: return "UNSOL_STK_PROACTIVE_COMMAND";
-        case RIL_UNSOL_STK_EVENT_NOTIFY: return "UNSOL_STK_EVENT_NOTIFY";
-        case RIL_UNSOL_STK_CALL_SETUP: return "UNSOL_STK_CALL_SETUP";
-        case RIL_UNSOL_SIM_SMS_STORAGE_FULL: return "UNSOL_SIM_SMS_STORAGE_FUL";
-        case RIL_UNSOL_SIM_REFRESH: return "UNSOL_SIM_REFRESH";
-        case RIL_UNSOL_DATA_CALL_LIST_CHANGED: return "UNSOL_DATA_CALL_LIST_CHANGED";
-        case RIL_UNSOL_CALL_RING: return "UNSOL_CALL_RING";
-        case RIL_UNSOL_RESPONSE_SIM_STATUS_CHANGED: return "UNSOL_RESPONSE_SIM_STATUS_CHANGED";
-        case RIL_UNSOL_RESPONSE_CDMA_NEW_SMS: return "UNSOL_NEW_CDMA_SMS";
-        case RIL_UNSOL_RESPONSE_NEW_BROADCAST_SMS: return "UNSOL_NEW_BROADCAST_SMS";
-        case RIL_UNSOL_CDMA_RUIM_SMS_STORAGE_FULL: return "UNSOL_CDMA_RUIM_SMS_STORAGE_FULL";
-        case RIL_UNSOL_RESTRICTED_STATE_CHANGED: return "UNSOL_RESTRICTED_STATE_CHANGED";
-        case RIL_UNSOL_ENTER_EMERGENCY_CALLBACK_MODE: return "UNSOL_ENTER_EMERGENCY_CALLBACK_MODE";
-        case RIL_UNSOL_CDMA_CALL_WAITING: return "UNSOL_CDMA_CALL_WAITING";
-        case RIL_UNSOL_CDMA_OTA_PROVISION_STATUS: return "UNSOL_CDMA_OTA_PROVISION_STATUS";
-        case RIL_UNSOL_CDMA_INFO_REC: return "UNSOL_CDMA_INFO_REC";
-        case RIL_UNSOL_OEM_HOOK_RAW: return "UNSOL_OEM_HOOK_RAW";
-        case RIL_UNSOL_RINGBACK_TONE: return "UNSOL_RINGBACK_TONE";
-        case RIL_UNSOL_RESEND_INCALL_MUTE: return "UNSOL_RESEND_INCALL_MUTE";
-        case RIL_UNSOL_CDMA_SUBSCRIPTION_SOURCE_CHANGED: return "UNSOL_CDMA_SUBSCRIPTION_SOURCE_CHANGED";
-        case RIL_UNSOL_CDMA_PRL_CHANGED: return "UNSOL_CDMA_PRL_CHANGED";
-        case RIL_UNSOL_EXIT_EMERGENCY_CALLBACK_MODE: return "UNSOL_EXIT_EMERGENCY_CALLBACK_MODE";
-        case RIL_UNSOL_RIL_CONNECTED: return "UNSOL_RIL_CONNECTED";
-        case RIL_UNSOL_VOICE_RADIO_TECH_CHANGED: return "UNSOL_VOICE_RADIO_TECH_CHANGED";
-        default: return "<unknown request>";
+    if ((unsigned int) request < NUM_ELEMS(s_commands)
+            && s_commands[request].name != NULL) {
+        return s_commands[request].name;
+    }
+    if (unsolIndex < NUM_ELEMS(s_unsolResponses)) {
+        return s_unsolResponses[unsolIndex].name;
+    }
+    if (request == RIL_REQUEST_SET_UNSOLICITED_SUBSCRIPTIONS) {
+        return "SET_UNSOLICITED_SUBSCRIPTIONS";
     }
+    return "<unknown request>";
 }
 
 } /* namespace android */
@@ -0,0 +1,85 @@
+/* //device/libs/telephony/ril_arena.cpp
+**
+** Copyright 2008, The Android Open Source Project
+**
+** Licensed under the Apache License, Version 2.0 (the "License");
+** you may not use this file except in compliance with the License.
+** You may obtain a copy of the License at
+**
+**     http://www.apache.org/licenses/LICENSE-2.0
+**
+** Unless required by applicable law or agreed to in writing, software
+** distributed under the License is distributed on an "AS IS" BASIS,
+** WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+** See the License for the specific language governing permissions and
+** limitations under the License.
+*/
+
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <ril_arena.h>
+
+#define ALIGNMENT 8
+
+struct ril_arena_chunk {
+    struct ril_arena_chunk *next;
+    size_t size;
+    size_t used;
+    uint64_t data[1];   // keeps the payload aligned
+};
+
+#define CHUNK_HEADER offsetof(struct ril_arena_chunk, data)
+
+void * ril_arena_alloc(struct ril_arena * arena, size_t len)
+{
+    struct ril_arena_chunk * chunk;
+    void * p;
+
+    len = (len + ALIGNMENT - 1) & ~(size_t) (ALIGNMENT - 1);
+    if (len == 0) {
+        len = ALIGNMENT;
+    }
+
+    if (arena->chunks == NULL && len <= arena->size - arena->used) {
+        p = arena->base + arena->used;
+        arena->used += len;
+        return p;
+    }
+
+    chunk = arena->chunks;
+    if (chunk == NULL || len > chunk->size - chunk->used) {
+        size_t size = (len > arena->size) ? len : arena->size;
+
+        chunk = (struct ril_arena_chunk *) malloc(CHUNK_HEADER + size);
+        if (chunk == NULL) {
+            return NULL;
+        }
+        chunk->next = arena->chunks;
+        chunk->size = size;
+        chunk->used = 0;
+        arena->chunks = chunk;
+    }
+
+    p = (char *) chunk->data + chunk->used;
+    chunk->used += len;
+    return p;
+}
+
+void ril_arena_reset(struct ril_arena * arena, bool scrub)
+{
+    while (arena->chunks != NULL) {
+        struct ril_arena_chunk * chunk = arena->chunks;
+
+        arena->chunks = chunk->next;
+        if (scrub) {
+            memset(chunk->data, 0, chunk->used);
+        }
+        free(chunk);
+    }
+
+    if (scrub) {
+        memset(arena->base, 0, arena->used);
+    }
+    arena->used = 0;
+}
@@ -0,0 +1,47 @@
+/* //device/libs/telephony/ril_arena.h
+**
+** Copyright 2008, The Android Open Source Project
+**
+** Licensed under the Apache License, Version 2.0 (the "License");
+** you may not use this file except in compliance with the License.
+** You may obtain a copy of the License at
+**
+**     http://www.apache.org/licenses/LICENSE-2.0
+**
+** Unless required by applicable law or agreed to in writing, software
+** distributed under the License is distributed on an "AS IS" BASIS,
+** WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+** See the License for the specific language governing permissions and
+** limitations under the License.
+*/
+
+#ifndef RIL_ARENA_H
+#define RIL_ARENA_H
+
+#include <stddef.h>
+
+// Bump-pointer arena for short-lived allocations that are all released
+// together. Allocations come out of a caller-supplied buffer; only if
+// that runs out are overflow chunks taken from malloc, and those are
+// freed again on reset. Not thread-safe.
+
+struct ril_arena_chunk;
+
+struct ril_arena {
+    char *base;
+    size_t size;
+    size_t used;
+    struct ril_arena_chunk *chunks;     // overflow, newest first
+};
+
+// buffer must be aligned for any type
+#define RIL_ARENA_INITIALIZER(buffer, size) { (char *) (buffer), size, 0, NULL }
+
+// Returns len bytes aligned for any type, or NULL if out of memory
+void * ril_arena_alloc(struct ril_arena * arena, size_t len);
+
+// Release everything allocated since the last reset. With scrub, the
+// memory is zeroed first so that stale pointers read nothing useful.
+void ril_arena_reset(struct ril_arena * arena, bool scrub);
+
+#endif /* RIL_ARENA_H */
@@ -0,0 +1,143 @@
+/* //device/libs/telephony/ril_capture.cpp
+**
+** Copyright 2008, The Android Open Source Project
+**
+** Licensed under the Apache License, Version 2.0 (the "License");
+** you may not use this file except in compliance with the License.
+** You may obtain a copy of the License at
+**
+**     http://www.apache.org/licenses/LICENSE-2.0
+**
+** Unless required by applicable law or agreed to in writing, software
+** distributed under the License is distributed on an "AS IS" BASIS,
+** WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+** See the License for the specific language governing permissions and
+** limitations under the License.
+*/
+
+#define LOG_TAG "RILC"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <utils/Log.h>
+#include <ril_capture.h>
+
+static struct ril_capture_header * s_header = NULL;
+static uint8_t * s_ring;
+static uint32_t s_ringSize;
+static size_t s_mapSize;
+
+// Copy into the ring at pos, wrapping around its end
+static void copyIn(uint32_t pos, const void * data, size_t length)
+{
+    uint32_t offset = pos & (s_ringSize - 1);
+    size_t first = s_ringSize - offset;
+
+    if (first >= length) {
+        memcpy(s_ring + offset, data, length);
+    } else {
+        memcpy(s_ring + offset, data, first);
+        memcpy(s_ring, (const uint8_t *) data + first, length - first);
+    }
+}
+
+bool ril_capture_open(const char * path, size_t ring_size)
+{
+    struct ril_capture_header * header;
+    uint32_t size = RIL_CAPTURE_MIN_RING;
+    int fd;
+
+    while (size < RIL_CAPTURE_MAX_RING && (size_t) size * 2 <= ring_size) {
+        size *= 2;
+    }
+
+    ril_capture_close();
+
+    fd = open(path, O_RDWR | O_CREAT | O_TRUNC, 0600);
+    if (fd < 0) {
+        ALOGE("capture: can't open %s errno:%d", path, errno);
+        return false;
+    }
+    if (ftruncate(fd, RIL_CAPTURE_HEADER_SIZE + size) < 0) {
+        ALOGE("capture: can't size %s errno:%d", path, errno);
+        close(fd);
+        return false;
+    }
+    header = (struct ril_capture_header *) mmap(NULL, RIL_CAPTURE_HEADER_SIZE + size,
+            PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (header == MAP_FAILED) {
+        ALOGE("capture: can't map %s errno:%d", path, errno);
+        return false;
+    }
+
+    header->magic = RIL_CAPTURE_MAGIC;
+    header->version = RIL_CAPTURE_VERSION;
+    header->ring_size = size;
+    header->head = 0;
+    header->filled = 0;
+
+    s_ring = (uint8_t *) header + RIL_CAPTURE_HEADER_SIZE;
+    s_ringSize = size;
+    s_mapSize = RIL_CAPTURE_HEADER_SIZE + size;
+    s_header = header;
+
+    ALOGI("capture: recording to %s, %u byte ring", path, (unsigned int) size);
+    return true;
+}
+
+void ril_capture_close()
+{
+    if (s_header != NULL) {
+        munmap(s_header, s_mapSize);
+        s_header = NULL;
+    }
+}
+
+void ril_capture_record(enum ril_capture_direction direction, uint32_t client,
+        const void * data, size_t length)
+{
+    struct ril_capture_header * header = s_header;
+    struct ril_capture_frame frame;
+    struct timespec ts;
+    uint32_t total;
+    uint32_t pos;
+    uint32_t invalid;
+
+    if (header == NULL) {
+        return;
+    }
+
+    total = RIL_CAPTURE_FRAME_SIZE(length);
+    if (total > s_ringSize / 2) {
+        return;
+    }
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    pos = __sync_fetch_and_add(&header->head, total);
+    if (!header->filled && pos + total >= s_ringSize) {
+        header->filled = 1;
+    }
+
+    // frames are 8-byte aligned, so pos itself never wraps; mark the
+    // frame invalid until all of it is in place
+    invalid = ~pos;
+    copyIn(pos, &invalid, sizeof(invalid));
+
+    frame.pos = pos;
+    frame.direction = direction;
+    frame.reserved = 0;
+    frame.client = client;
+    frame.length = length;
+    frame.timestamp_ns = (int64_t) ts.tv_sec * 1000000000LL + ts.tv_nsec;
+    copyIn(pos + sizeof(frame.pos), (const uint8_t *) &frame + sizeof(frame.pos),
+            sizeof(frame) - sizeof(frame.pos));
+    copyIn(pos + sizeof(frame), data, length);
+
+    __sync_synchronize();
+    copyIn(pos, &pos, sizeof(pos));
+}
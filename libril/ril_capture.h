@@ -0,0 +1,92 @@
+/* //device/libs/telephony/ril_capture.h
+**
+** Copyright 2008, The Android Open Source Project
+**
+** Licensed under the Apache License, Version 2.0 (the "License");
+** you may not use this file except in compliance with the License.
+** You may obtain a copy of the License at
+**
+**     http://www.apache.org/licenses/LICENSE-2.0
+**
+** Unless required by applicable law or agreed to in writing, software
+** distributed under the License is distributed on an "AS IS" BASIS,
+** WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+** See the License for the specific language governing permissions and
+** limitations under the License.
+*/
+
+#ifndef RIL_CAPTURE_H
+#define RIL_CAPTURE_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+// Capture of command socket traffic into a ring in a memory-mapped
+// file, for replaying what libril saw offline. Recording a message is
+// an atomic add to reserve space and a copy into the mapping; the
+// kernel writes the pages back on its own, so there is no system call
+// per message beyond reading CLOCK_MONOTONIC, which the vDSO serves.
+//
+// A request is recorded as it is read, before dispatch. A response or
+// unsolicited response is recorded once per client, when its last byte
+// has been written to that client's socket, so anything the outbound
+// policies dropped or replaced on a slow client's queue is absent.
+//
+// File layout: a struct ril_capture_header, padded to
+// RIL_CAPTURE_HEADER_SIZE, then ring_size bytes of ring. Frames start
+// 8-byte aligned and may wrap around the end of the ring. Positions
+// count every byte ever reserved, modulo 2^32; a position maps to ring
+// offset pos & (ring_size - 1).
+
+#define RIL_CAPTURE_MAGIC 0x50414352    // "RCAP"
+#define RIL_CAPTURE_VERSION 1
+#define RIL_CAPTURE_HEADER_SIZE 64
+
+// Smallest and largest ring; sizes in between are rounded down to a
+// power of two
+#define RIL_CAPTURE_MIN_RING (64 * 1024)
+#define RIL_CAPTURE_MAX_RING (256 * 1024 * 1024)
+
+enum ril_capture_direction {
+    RIL_CAPTURE_IN = 0,         // request read from a client
+    RIL_CAPTURE_OUT = 1         // response or unsolicited response written
+};
+
+struct ril_capture_header {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t ring_size;
+    volatile uint32_t head;     // position of the next frame
+    // Set once ring_size bytes have been reserved. head alone can't
+    // tell, since it wraps after 4GB
+    volatile uint32_t filled;
+};
+
+struct ril_capture_frame {
+    // The frame's own position, written last: a frame whose pos does
+    // not match where it was found is torn or has been overwritten
+    volatile uint32_t pos;
+    uint16_t direction;
+    uint16_t reserved;
+    uint32_t client;            // connection id
+    uint32_t length;            // of the Parcel data that follows
+    int64_t timestamp_ns;       // CLOCK_MONOTONIC
+};
+
+// Ring bytes taken by a frame with the given payload length
+#define RIL_CAPTURE_FRAME_SIZE(length) \
+    ((sizeof(struct ril_capture_frame) + (length) + 7) & ~(size_t) 7)
+
+// Create or truncate the capture file and start recording into it.
+// Not to be called while anything is being recorded.
+bool ril_capture_open(const char * path, size_t ring_size);
+
+// Stop recording. Not to be called while anything is being recorded.
+void ril_capture_close();
+
+// Append a frame; does nothing unless a capture file is open. Any
+// thread may call it.
+void ril_capture_record(enum ril_capture_direction direction, uint32_t client,
+        const void * data, size_t length);
+
+#endif /* RIL_CAPTURE_H */
@@ -14,156 +14,164 @@
 ** See the License for the specific language governing permissions and
 ** limitations under the License.
 */
-    {0, NULL, NULL},                   //none
-    {RIL_REQUEST_GET_SIM_STATUS, dispatchVoid, responseSimStatus},
-    {RIL_REQUEST_ENTER_SIM_PIN, dispatchStrings, responseInts},
-    {RIL_REQUEST_ENTER_SIM_PUK, dispatchStrings, responseInts},
-    {RIL_REQUEST_ENTER_SIM_PIN2, dispatchStrings, responseInts},
-    {RIL_REQUEST_ENTER_SIM_PUK2, dispatchStrings, responseInts},
-    {RIL_REQUEST_CHANGE_SIM_PIN, dispatchStrings, responseInts},
-    {RIL_REQUEST_CHANGE_SIM_PIN2, dispatchStrings, responseInts},
-    {RIL_REQUEST_ENTER_NETWORK_DEPERSONALIZATION, dispatchStrings, responseInts},
-    {RIL_REQUEST_GET_CURRENT_CALLS, dispatchVoid, responseCallList},
-    {RIL_REQUEST_DIAL, dispatchDial, responseVoid},
-    {RIL_REQUEST_GET_IMSI, dispatchStrings, responseString},
-    {RIL_REQUEST_HANGUP, dispatchInts, responseVoid},
-    {RIL_REQUEST_HANGUP_WAITING_OR_BACKGROUND, dispatchVoid, responseVoid},
-    {RIL_REQUEST_HANGUP_FOREGROUND_RESUME_BACKGROUND, dispatchVoid, responseVoid},
-    {RIL_REQUEST_SWITCH_WAITING_OR_HOLDING_AND_ACTIVE, dispatchVoid, responseVoid},
-    {RIL_REQUEST_CONFERENCE, dispatchVoid, responseVoid},
-    {RIL_REQUEST_UDUB, dispatchVoid, responseVoid},
-    {RIL_REQUEST_LAST_CALL_FAIL_CAUSE, dispatchVoid, responseInts},
-    {RIL_REQUEST_SIGNAL_STRENGTH, dispatchVoid, responseRilSignalStrength},
-    {RIL_REQUEST_VOICE_REGISTRATION_STATE, dispatchVoid, responseStrings},
-    {RIL_REQUEST_DATA_REGISTRATION_STATE, dispatchVoid, responseStrings},
-    {RIL_REQUEST_OPERATOR, dispatchVoid, responseStrings},
-    {RIL_REQUEST_RADIO_POWER, dispatchInts, responseVoid},
-    {RIL_REQUEST_DTMF, dispatchString, responseVoid},
-    {RIL_REQUEST_SEND_SMS, dispatchStrings, responseSMS},
-    {RIL_REQUEST_SEND_SMS_EXPECT_MORE, dispatchStrings, responseSMS},
-    {RIL_REQUEST_SETUP_DATA_CALL, dispatchDataCall, responseSetupDataCall},
-    {RIL_REQUEST_SIM_IO, dispatchSIM_IO, responseSIM_IO},
-    {RIL_REQUEST_SEND_USSD, dispatchString, responseVoid},
-    {RIL_REQUEST_CANCEL_USSD, dispatchVoid, responseVoid},
-    {RIL_REQUEST_GET_CLIR, dispatchVoid, responseInts},
-    {RIL_REQUEST_SET_CLIR, dispatchInts, responseVoid},
-    {RIL_REQUEST_QUERY_CALL_FORWARD_STATUS, dispatchCallForward, responseCallForwards},
-    {RIL_REQUEST_SET_CALL_FORWARD, dispatchCallForward, responseVoid},
-    {RIL_REQUEST_QUERY_CALL_WAITING, dispatchInts, responseInts},
-    {RIL_REQUEST_SET_CALL_WAITING, dispatchInts, responseVoid},
-    {RIL_REQUEST_SMS_ACKNOWLEDGE, dispatchInts, responseVoid},
-    {RIL_REQUEST_GET_IMEI, dispatchVoid, responseString},
-    {RIL_REQUEST_GET_IMEISV, dispatchVoid, responseString},
-    {RIL_REQUEST_ANSWER,dispatchVoid, responseVoid},
-    {RIL_REQUEST_DEACTIVATE_DATA_CALL, dispatchStrings, responseVoid},
-    {RIL_REQUEST_QUERY_FACILITY_LOCK, dispatchStrings, responseInts},
-    {RIL_REQUEST_SET_FACILITY_LOCK, dispatchStrings, responseInts},
-    {RIL_REQUEST_CHANGE_BARRING_PASSWORD, dispatchStrings, responseVoid},
-    {RIL_REQUEST_QUERY_NETWORK_SELECTION_MODE, dispatchVoid, responseInts},
-    {RIL_REQUEST_SET_NETWORK_SELECTION_AUTOMATIC, dispatchVoid, responseVoid},
-    {RIL_REQUEST_SET_NETWORK_SELECTION_MANUAL, dispatchString, responseVoid},
-    {RIL_REQUEST_QUERY_AVAILABLE_NETWORKS , dispatchVoid, responseStrings},
-    {RIL_REQUEST_DTMF_START, dispatchString, responseVoid},
-    {RIL_REQUEST_DTMF_STOP, dispatchVoid, responseVoid},
-    {RIL_REQUEST_BASEBAND_VERSION, dispatchVoid, responseString},
-    {RIL_REQUEST_SEPARATE_CONNECTION, dispatchInts, responseVoid},
-    {RIL_REQUEST_SET_MUTE, dispatchInts, responseVoid},
-    {RIL_REQUEST_GET_MUTE, dispatchVoid, responseInts},
-    {RIL_REQUEST_QUERY_CLIP, dispatchVoid, responseInts},
-    {RIL_REQUEST_LAST_DATA_CALL_FAIL_CAUSE, dispatchVoid, responseInts},
-    {RIL_REQUEST_DATA_CALL_LIST, dispatchVoid, responseDataCallList},
-    {RIL_REQUEST_RESET_RADIO, dispatchVoid, responseVoid},
-    {RIL_REQUEST_OEM_HOOK_RAW, dispatchRaw, responseRaw},
-    {RIL_REQUEST_OEM_HOOK_STRINGS, dispatchStrings, responseStrings},
-    {RIL_REQUEST_SCREEN_STATE, dispatchInts, responseVoid},
-    {RIL_REQUEST_SET_SUPP_SVC_NOTIFICATION, dispatchInts, responseVoid},
-    {RIL_REQUEST_WRITE_SMS_TO_SIM, dispatchSmsWrite, responseInts},
-    {RIL_REQUEST_DELETE_SMS_ON_SIM, dispatchInts, responseVoid},
-    {RIL_REQUEST_SET_BAND_MODE, dispatchInts, responseVoid},
-    {RIL_REQUEST_QUERY_AVAILABLE_BAND_MODE, dispatchVoid, responseInts},
-    {RIL_REQUEST_STK_GET_PROFILE, dispatchVoid, responseString},
-    {RIL_REQUEST_STK_SET_PROFILE, dispatchString, responseVoid},
-    {RIL_REQUEST_STK_SEND_ENVELOPE_COMMAND, dispatchString, responseString},
-    {RIL_REQUEST_STK_SEND_TERMINAL_RESPONSE, dispatchString, responseVoid},
-    {RIL_REQUEST_STK_HANDLE_CALL_SETUP_REQUESTED_FROM_SIM, dispatchInts, responseVoid},
-    {RIL_REQUEST_EXPLICIT_CALL_TRANSFER, dispatchVoid, responseVoid},
-    {RIL_REQUEST_SET_PREFERRED_NETWORK_TYPE, dispatchInts, responseVoid},
-    {RIL_REQUEST_GET_PREFERRED_NETWORK_TYPE, dispatchVoid, responseInts},
-    {RIL_REQUEST_GET_NEIGHBORING_CELL_IDS, dispatchVoid, responseCellList},
-    {RIL_REQUEST_SET_LOCATION_UPDATES, dispatchInts, responseVoid},
-    {RIL_REQUEST_CDMA_SET_SUBSCRIPTION_SOURCE, dispatchInts, responseVoid},
-    {RIL_REQUEST_CDMA_SET_ROAMING_PREFERENCE, dispatchInts, responseVoid},
-    {RIL_REQUEST_CDMA_QUERY_ROAMING_PREFERENCE, dispatchVoid, responseInts},
-    {RIL_REQUEST_SET_TTY_MODE, dispatchInts, responseVoid},
-    {RIL_REQUEST_QUERY_TTY_MODE, dispatchVoid, responseInts},
-    {RIL_REQUEST_CDMA_SET_PREFERRED_VOICE_PRIVACY_MODE, dispatchInts, responseVoid},
-    {RIL_REQUEST_CDMA_QUERY_PREFERRED_VOICE_PRIVACY_MODE, dispatchVoid, responseInts},
-    {RIL_REQUEST_CDMA_FLASH, dispatchString, responseVoid},
-    {RIL_REQUEST_CDMA_BURST_DTMF, dispatchStrings, responseVoid},
-    {RIL_REQUEST_CDMA_VALIDATE_AND_WRITE_AKEY, dispatchString, responseVoid},
-    {RIL_REQUEST_CDMA_SEND_SMS, dispatchCdmaSms, responseSMS},
-    {RIL_REQUEST_CDMA_SMS_ACKNOWLEDGE, dispatchCdmaSmsAck, responseVoid},
-    {RIL_REQUEST_GSM_GET_BROADCAST_SMS_CONFIG, dispatchVoid, responseGsmBrSmsCnf},
-    {RIL_REQUEST_GSM_SET_BROADCAST_SMS_CONFIG, dispatchGsmBrSmsCnf, responseVoid},
-    {RIL_REQUEST_GSM_SMS_BROADCAST_ACTIVATION, dispatchInts, responseVoid},
-    {RIL_REQUEST_CDMA_GET_BROADCAST_SMS_CONFIG, dispatchVoid, responseCdmaBrSmsCnf},
-    {RIL_REQUEST_CDMA_SET_BROADCAST_SMS_CONFIG, dispatchCdmaBrSmsCnf, responseVoid},
-    {RIL_REQUEST_CDMA_SMS_BROADCAST_ACTIVATION, dispatchInts, responseVoid},
-    {RIL_REQUEST_CDMA_SUBSCRIPTION, dispatchVoid, responseStrings},
-    {RIL_REQUEST_CDMA_WRITE_SMS_TO_RUIM, dispatchRilCdmaSmsWriteArgs, responseInts},
-    {RIL_REQUEST_CDMA_DELETE_SMS_ON_RUIM, dispatchInts, responseVoid},
-    {RIL_REQUEST_DEVICE_IDENTITY, dispatchVoid, responseStrings},
-    {RIL_REQUEST_EXIT_EMERGENCY_CALLBACK_MODE, dispatchVoid, responseVoid},
-    {RIL_REQUEST_GET_SMSC_ADDRESS, dispatchVoid, responseString},
-    {RIL_REQUEST_SET_SMSC_ADDRESS, dispatchString, responseVoid},
-    {RIL_REQUEST_REPORT_SMS_MEMORY_STATUS, dispatchInts, responseVoid},
-    {RIL_REQUEST_REPORT_STK_SERVICE_IS_RUNNING, dispatchVoid, responseVoid},
-    {RIL_REQUEST_CDMA_GET_SUBSCRIPTION_SOURCE, dispatchCdmaSubscriptionSource, responseInts},
-    {RIL_REQUEST_ISIM_AUTHENTICATION, dispatchString, responseString},
-    {RIL_REQUEST_ACKNOWLEDGE_INCOMING_GSM_SMS_WITH_PDU, dispatchStrings, responseVoid},
-    {RIL_REQUEST_STK_SEND_ENVELOPE_WITH_STATUS, dispatchString, responseSIM_IO},
-    {RIL_REQUEST_VOICE_RADIO_TECH, dispatchVoiceRadioTech, responseInts},
+/*
+ * One line per request number, in order:
+ *   RIL_REQUEST_ENTRY(name, dispatch function, response function)
+ *   RIL_REQUEST_UNUSED(number)
+ * where name is the RIL_REQUEST_ constant without its prefix. Define
+ * both macros before including this file; ril.cpp checks at compile time
+ * that every line sits at its request number.
+ */
+    RIL_REQUEST_UNUSED(0)
+    RIL_REQUEST_ENTRY(GET_SIM_STATUS, dispatchVoid, responseSimStatus)
+    RIL_REQUEST_ENTRY(ENTER_SIM_PIN, dispatchStrings, responseInts)
+    RIL_REQUEST_ENTRY(ENTER_SIM_PUK, dispatchStrings, responseInts)
+    RIL_REQUEST_ENTRY(ENTER_SIM_PIN2, dispatchStrings, responseInts)
+    RIL_REQUEST_ENTRY(ENTER_SIM_PUK2, dispatchStrings, responseInts)
+    RIL_REQUEST_ENTRY(CHANGE_SIM_PIN, dispatchStrings, responseInts)
+    RIL_REQUEST_ENTRY(CHANGE_SIM_PIN2, dispatchStrings, responseInts)
+    RIL_REQUEST_ENTRY(ENTER_NETWORK_DEPERSONALIZATION, dispatchStrings, responseInts)
+    RIL_REQUEST_ENTRY(GET_CURRENT_CALLS, dispatchVoid, responseCallList)
+    RIL_REQUEST_ENTRY(DIAL, dispatchDial, responseVoid)
+    RIL_REQUEST_ENTRY(GET_IMSI, dispatchStrings, responseString)
+    RIL_REQUEST_ENTRY(HANGUP, dispatchInts, responseVoid)
+    RIL_REQUEST_ENTRY(HANGUP_WAITING_OR_BACKGROUND, dispatchVoid, responseVoid)
+    RIL_REQUEST_ENTRY(HANGUP_FOREGROUND_RESUME_BACKGROUND, dispatchVoid, responseVoid)
+    RIL_REQUEST_ENTRY(SWITCH_WAITING_OR_HOLDING_AND_ACTIVE, dispatchVoid, responseVoid)
+    RIL_REQUEST_ENTRY(CONFERENCE, dispatchVoid, responseVoid)
+    RIL_REQUEST_ENTRY(UDUB, dispatchVoid, responseVoid)
+    RIL_REQUEST_ENTRY(LAST_CALL_FAIL_CAUSE, dispatchVoid, responseInts)
+    RIL_REQUEST_ENTRY(SIGNAL_STRENGTH, dispatchVoid, responseRilSignalStrength)
+    RIL_REQUEST_ENTRY(VOICE_REGISTRATION_STATE, dispatchVoid, responseStrings)
+    RIL_REQUEST_ENTRY(DATA_REGISTRATION_STATE, dispatchVoid, responseStrings)
+    RIL_REQUEST_ENTRY(OPERATOR, dispatchVoid, responseStrings)
+    RIL_REQUEST_ENTRY(RADIO_POWER, dispatchInts, responseVoid)
+    RIL_REQUEST_ENTRY(DTMF, dispatchString, responseVoid)
+    RIL_REQUEST_ENTRY(SEND_SMS, dispatchStrings, responseSMS)
+    RIL_REQUEST_ENTRY(SEND_SMS_EXPECT_MORE, dispatchStrings, responseSMS)
+    RIL_REQUEST_ENTRY(SETUP_DATA_CALL, dispatchDataCall, responseSetupDataCall)
+    RIL_REQUEST_ENTRY(SIM_IO, dispatchSIM_IO, responseSIM_IO)
+    RIL_REQUEST_ENTRY(SEND_USSD, dispatchString, responseVoid)
+    RIL_REQUEST_ENTRY(CANCEL_USSD, dispatchVoid, responseVoid)
+    RIL_REQUEST_ENTRY(GET_CLIR, dispatchVoid, responseInts)
+    RIL_REQUEST_ENTRY(SET_CLIR, dispatchInts, responseVoid)
+    RIL_REQUEST_ENTRY(QUERY_CALL_FORWARD_STATUS, dispatchCallForward, responseCallForwards)
+    RIL_REQUEST_ENTRY(SET_CALL_FORWARD, dispatchCallForward, responseVoid)
+    RIL_REQUEST_ENTRY(QUERY_CALL_WAITING, dispatchInts, responseInts)
+    RIL_REQUEST_ENTRY(SET_CALL_WAITING, dispatchInts, responseVoid)
+    RIL_REQUEST_ENTRY(SMS_ACKNOWLEDGE, dispatchInts, responseVoid)
+    RIL_REQUEST_ENTRY(GET_IMEI, dispatchVoid, responseString)
+    RIL_REQUEST_ENTRY(GET_IMEISV, dispatchVoid, responseString)
+    RIL_REQUEST_ENTRY(ANSWER, dispatchVoid, responseVoid)
+    RIL_REQUEST_ENTRY(DEACTIVATE_DATA_CALL, dispatchStrings, responseVoid)
+    RIL_REQUEST_ENTRY(QUERY_FACILITY_LOCK, dispatchStrings, responseInts)
+    RIL_REQUEST_ENTRY(SET_FACILITY_LOCK, dispatchStrings, responseInts)
+    RIL_REQUEST_ENTRY(CHANGE_BARRING_PASSWORD, dispatchStrings, responseVoid)
+    RIL_REQUEST_ENTRY(QUERY_NETWORK_SELECTION_MODE, dispatchVoid, responseInts)
+    RIL_REQUEST_ENTRY(SET_NETWORK_SELECTION_AUTOMATIC, dispatchVoid, responseVoid)
+    RIL_REQUEST_ENTRY(SET_NETWORK_SELECTION_MANUAL, dispatchString, responseVoid)
+    RIL_REQUEST_ENTRY(QUERY_AVAILABLE_NETWORKS, dispatchVoid, responseStrings)
+    RIL_REQUEST_ENTRY(DTMF_START, dispatchString, responseVoid)
+    RIL_REQUEST_ENTRY(DTMF_STOP, dispatchVoid, responseVoid)
+    RIL_REQUEST_ENTRY(BASEBAND_VERSION, dispatchVoid, responseString)
+    RIL_REQUEST_ENTRY(SEPARATE_CONNECTION, dispatchInts, responseVoid)
+    RIL_REQUEST_ENTRY(SET_MUTE, dispatchInts, responseVoid)
+    RIL_REQUEST_ENTRY(GET_MUTE, dispatchVoid, responseInts)
+    RIL_REQUEST_ENTRY(QUERY_CLIP, dispatchVoid, responseInts)
+    RIL_REQUEST_ENTRY(LAST_DATA_CALL_FAIL_CAUSE, dispatchVoid, responseInts)
+    RIL_REQUEST_ENTRY(DATA_CALL_LIST, dispatchVoid, responseDataCallList)
+    RIL_REQUEST_ENTRY(RESET_RADIO, dispatchVoid, responseVoid)
+    RIL_REQUEST_ENTRY(OEM_HOOK_RAW, dispatchRaw, responseRaw)
+    RIL_REQUEST_ENTRY(OEM_HOOK_STRINGS, dispatchStrings, responseStrings)
+    RIL_REQUEST_ENTRY(SCREEN_STATE, dispatchInts, responseVoid)
+    RIL_REQUEST_ENTRY(SET_SUPP_SVC_NOTIFICATION, dispatchInts, responseVoid)
+    RIL_REQUEST_ENTRY(WRITE_SMS_TO_SIM, dispatchSmsWrite, responseInts)
+    RIL_REQUEST_ENTRY(DELETE_SMS_ON_SIM, dispatchInts, responseVoid)
+    RIL_REQUEST_ENTRY(SET_BAND_MODE, dispatchInts, responseVoid)
+    RIL_REQUEST_ENTRY(QUERY_AVAILABLE_BAND_MODE, dispatchVoid, responseInts)
+    RIL_REQUEST_ENTRY(STK_GET_PROFILE, dispatchVoid, responseString)
+    RIL_REQUEST_ENTRY(STK_SET_PROFILE, dispatchString, responseVoid)
+    RIL_REQUEST_ENTRY(STK_SEND_ENVELOPE_COMMAND, dispatchString, responseString)
+    RIL_REQUEST_ENTRY(STK_SEND_TERMINAL_RESPONSE, dispatchString, responseVoid)
+    RIL_REQUEST_ENTRY(STK_HANDLE_CALL_SETUP_REQUESTED_FROM_SIM, dispatchInts, responseVoid)
+    RIL_REQUEST_ENTRY(EXPLICIT_CALL_TRANSFER, dispatchVoid, responseVoid)
+    RIL_REQUEST_ENTRY(SET_PREFERRED_NETWORK_TYPE, dispatchInts, responseVoid)
+    RIL_REQUEST_ENTRY(GET_PREFERRED_NETWORK_TYPE, dispatchVoid, responseInts)
+    RIL_REQUEST_ENTRY(GET_NEIGHBORING_CELL_IDS, dispatchVoid, responseCellList)
+    RIL_REQUEST_ENTRY(SET_LOCATION_UPDATES, dispatchInts, responseVoid)
+    RIL_REQUEST_ENTRY(CDMA_SET_SUBSCRIPTION_SOURCE, dispatchInts, responseVoid)
+    RIL_REQUEST_ENTRY(CDMA_SET_ROAMING_PREFERENCE, dispatchInts, responseVoid)
+    RIL_REQUEST_ENTRY(CDMA_QUERY_ROAMING_PREFERENCE, dispatchVoid, responseInts)
+    RIL_REQUEST_ENTRY(SET_TTY_MODE, dispatchInts, responseVoid)
+    RIL_REQUEST_ENTRY(QUERY_TTY_MODE, dispatchVoid, responseInts)
+    RIL_REQUEST_ENTRY(CDMA_SET_PREFERRED_VOICE_PRIVACY_MODE, dispatchInts, responseVoid)
+    RIL_REQUEST_ENTRY(CDMA_QUERY_PREFERRED_VOICE_PRIVACY_MODE, dispatchVoid, responseInts)
+    RIL_REQUEST_ENTRY(CDMA_FLASH, dispatchString, responseVoid)
+    RIL_REQUEST_ENTRY(CDMA_BURST_DTMF, dispatchStrings, responseVoid)
+    RIL_REQUEST_ENTRY(CDMA_VALIDATE_AND_WRITE_AKEY, dispatchString, responseVoid)
+    RIL_REQUEST_ENTRY(CDMA_SEND_SMS, dispatchCdmaSms, responseSMS)
+    RIL_REQUEST_ENTRY(CDMA_SMS_ACKNOWLEDGE, dispatchCdmaSmsAck, responseVoid)
+    RIL_REQUEST_ENTRY(GSM_GET_BROADCAST_SMS_CONFIG, dispatchVoid, responseGsmBrSmsCnf)
+    RIL_REQUEST_ENTRY(GSM_SET_BROADCAST_SMS_CONFIG, dispatchGsmBrSmsCnf, responseVoid)
+    RIL_REQUEST_ENTRY(GSM_SMS_BROADCAST_ACTIVATION, dispatchInts, responseVoid)
+    RIL_REQUEST_ENTRY(CDMA_GET_BROADCAST_SMS_CONFIG, dispatchVoid, responseCdmaBrSmsCnf)
+    RIL_REQUEST_ENTRY(CDMA_SET_BROADCAST_SMS_CONFIG, dispatchCdmaBrSmsCnf, responseVoid)
+    RIL_REQUEST_ENTRY(CDMA_SMS_BROADCAST_ACTIVATION, dispatchInts, responseVoid)
+    RIL_REQUEST_ENTRY(CDMA_SUBSCRIPTION, dispatchVoid, responseStrings)
+    RIL_REQUEST_ENTRY(CDMA_WRITE_SMS_TO_RUIM, dispatchRilCdmaSmsWriteArgs, responseInts)
+    RIL_REQUEST_ENTRY(CDMA_DELETE_SMS_ON_RUIM, dispatchInts, responseVoid)
+    RIL_REQUEST_ENTRY(DEVICE_IDENTITY, dispatchVoid, responseStrings)
+    RIL_REQUEST_ENTRY(EXIT_EMERGENCY_CALLBACK_MODE, dispatchVoid, responseVoid)
+    RIL_REQUEST_ENTRY(GET_SMSC_ADDRESS, dispatchVoid, responseString)
+    RIL_REQUEST_ENTRY(SET_SMSC_ADDRESS, dispatchString, responseVoid)
+    RIL_REQUEST_ENTRY(REPORT_SMS_MEMORY_STATUS, dispatchInts, responseVoid)
+    RIL_REQUEST_ENTRY(REPORT_STK_SERVICE_IS_RUNNING, dispatchVoid, responseVoid)
+    RIL_REQUEST_ENTRY(CDMA_GET_SUBSCRIPTION_SOURCE, dispatchCdmaSubscriptionSource, responseInts)
+    RIL_REQUEST_ENTRY(ISIM_AUTHENTICATION, dispatchString, responseString)
+    RIL_REQUEST_ENTRY(ACKNOWLEDGE_INCOMING_GSM_SMS_WITH_PDU, dispatchStrings, responseVoid)
+    RIL_REQUEST_ENTRY(STK_SEND_ENVELOPE_WITH_STATUS, dispatchString, responseSIM_IO)
+    RIL_REQUEST_ENTRY(VOICE_RADIO_TECH, dispatchVoiceRadioTech, responseInts)
     /* unsupported/unused request numbers below */
-    {0, NULL, NULL},
-    {0, NULL, NULL}, /* 110 */
-    {0, NULL, NULL},
-    {0, NULL, NULL},
-    {0, NULL, NULL},
-    {0, NULL, NULL},
-    {0, NULL, NULL},
-    {0, NULL, NULL},
-    {0, NULL, NULL},
-    {0, NULL, NULL},
-    {0, NULL, NULL},
-    {0, NULL, NULL}, /* 120 */
-    {0, NULL, NULL},
-    {0, NULL, NULL},
-    {0, NULL, NULL},
-    {0, NULL, NULL},
-    {0, NULL, NULL},
-    {0, NULL, NULL},
-    {0, NULL, NULL},
-    {0, NULL, NULL},
-    {0, NULL, NULL},
-    {0, NULL, NULL}, /* 130 */
-    {0, NULL, NULL},
-    {0, NULL, NULL},
-    {0, NULL, NULL},
-    {0, NULL, NULL},
-    {0, NULL, NULL},
-    {0, NULL, NULL},
-    {0, NULL, NULL},
-    {0, NULL, NULL},
-    {0, NULL, NULL},
-    {0, NULL, NULL}, /* 140 */
-    {0, NULL, NULL},
-    {0, NULL, NULL},
-    {0, NULL, NULL},
-    {0, NULL, NULL},
-    {0, NULL, NULL},
-    {0, NULL, NULL},
-    {0, NULL, NULL},
-    {0, NULL, NULL},
-    {0, NULL, NULL},
+    RIL_REQUEST_UNUSED(109)
+    RIL_REQUEST_UNUSED(110)
+    RIL_REQUEST_UNUSED(111)
+    RIL_REQUEST_UNUSED(112)
+    RIL_REQUEST_UNUSED(113)
+    RIL_REQUEST_UNUSED(114)
+    RIL_REQUEST_UNUSED(115)
+    RIL_REQUEST_UNUSED(116)
+    RIL_REQUEST_UNUSED(117)
+    RIL_REQUEST_UNUSED(118)
+    RIL_REQUEST_UNUSED(119)
+    RIL_REQUEST_UNUSED(120)
+    RIL_REQUEST_UNUSED(121)
+    RIL_REQUEST_UNUSED(122)
+    RIL_REQUEST_UNUSED(123)
+    RIL_REQUEST_UNUSED(124)
+    RIL_REQUEST_UNUSED(125)
+    RIL_REQUEST_UNUSED(126)
+    RIL_REQUEST_UNUSED(127)
+    RIL_REQUEST_UNUSED(128)
+    RIL_REQUEST_UNUSED(129)
+    RIL_REQUEST_UNUSED(130)
+    RIL_REQUEST_UNUSED(131)
+    RIL_REQUEST_UNUSED(132)
+    RIL_REQUEST_UNUSED(133)
+    RIL_REQUEST_UNUSED(134)
+    RIL_REQUEST_UNUSED(135)
+    RIL_REQUEST_UNUSED(136)
+    RIL_REQUEST_UNUSED(137)
+    RIL_REQUEST_UNUSED(138)
+    RIL_REQUEST_UNUSED(139)
+    RIL_REQUEST_UNUSED(140)
+    RIL_REQUEST_UNUSED(141)
+    RIL_REQUEST_UNUSED(142)
+    RIL_REQUEST_UNUSED(143)
+    RIL_REQUEST_UNUSED(144)
+    RIL_REQUEST_UNUSED(145)
+    RIL_REQUEST_UNUSED(146)
+    RIL_REQUEST_UNUSED(147)
+    RIL_REQUEST_UNUSED(148)
+    RIL_REQUEST_UNUSED(149)
     /* Mozilla-defined requests below */
-    {RIL_REQUEST_GET_UNLOCK_RETRY_COUNT, dispatchStrings, responseInts},
+    RIL_REQUEST_ENTRY(GET_UNLOCK_RETRY_COUNT, dispatchStrings, responseInts)
@@ -20,19 +20,25 @@
 #include <stdlib.h>
 #include <unistd.h>
 #include <errno.h>
+#include <limits.h>
 #include <fcntl.h>
 #include <utils/Log.h>
 #include <ril_event.h>
+#include <stdio.h>
 #include <string.h>
 #include <sys/time.h>
 #include <time.h>
 
+#if defined(__linux__) && !defined(RIL_EVENT_NO_EPOLL)
+#define RIL_EVENT_HAVE_EPOLL 1
+#include <sys/epoll.h>
+#endif
+
 #include <pthread.h>
-static pthread_mutex_t listMutex;
-#define MUTEX_ACQUIRE() pthread_mutex_lock(&listMutex)
-#define MUTEX_RELEASE() pthread_mutex_unlock(&listMutex)
-#define MUTEX_INIT() pthread_mutex_init(&listMutex, NULL)
-#define MUTEX_DESTROY() pthread_mutex_destroy(&listMutex)
+#define MUTEX_ACQUIRE() pthread_mutex_lock(&base->listMutex)
+#define MUTEX_RELEASE() pthread_mutex_unlock(&base->listMutex)
+#define MUTEX_INIT() pthread_mutex_init(&base->listMutex, NULL)
+#define MUTEX_DESTROY() pthread_mutex_destroy(&base->listMutex)
 
 #ifndef timeradd
 #define timeradd(tvp, uvp, vvp)						\
@@ -65,12 +71,80 @@ static pthread_mutex_t listMutex;
     } while(0);
 #endif
 
-static fd_set readFds;
-static int nfds = 0;
+// Initial size of the watch table; it doubles whenever it fills up.
+#define WATCH_TABLE_INITIAL_SIZE 8
+
+// Callbacks run per loop iteration at each priority before fds are
+// polled again; leftovers stay pending for the next iteration
+static const int priority_budget[RIL_EVENT_PRIORITY_COUNT] = {
+    INT_MAX,    // RIL_EVENT_PRIORITY_HIGH
+    64,         // RIL_EVENT_PRIORITY_NORMAL
+    4,          // RIL_EVENT_PRIORITY_LOW
+};
+
+// Timer life cycle. Other threads only post timers and change their
+// state; everything else about timers belongs to the loop thread.
+enum {
+    TIMER_IDLE,             // owned by the caller
+    TIMER_SUBMITTED,        // in the submission queue
+    TIMER_ARMED,            // in the timer heap
+    TIMER_PENDING,          // expired, waiting in a pending list
+    TIMER_CANCELLED,        // cancelled while submitted or pending
+    TIMER_CANCEL_QUEUED     // cancelled while armed, and queued again
+                            // so the loop takes it out of the heap
+};
+
+// All state of one event loop
+struct ril_event_base {
+    pthread_mutex_t listMutex;
+
+    enum ril_event_backend backend;
+
+    fd_set readFds;
+    fd_set writeFds;
+    int nfds;
+
+#ifdef RIL_EVENT_HAVE_EPOLL
+    int epollFd;
+    struct epoll_event * epoll_events;
+    int epoll_events_size;
+#endif
+
+    // Dense table of watched events; ev->index is the slot of ev.
+    struct ril_event ** watch_table;
+    int watch_table_size;
+    int watch_count;
+
+    // Lock-free multi-producer, single-consumer queue of timers posted to
+    // the loop (Vyukov's intrusive MPSC queue). The stub keeps it non-empty.
+    struct ril_event submit_stub;
+    struct ril_event * volatile submit_tail;
+    struct ril_event * submit_head;
 
-static struct ril_event * watch_table[MAX_FD_EVENTS];
-static struct ril_event timer_list;
-static struct ril_event pending_list;
+    // Binary min-heap of pending timers ordered by (timeout, seq);
+    // ev->index is the position of ev in the heap. Loop thread only.
+    struct ril_event ** timer_heap;
+    int timer_heap_size;
+    int timer_count;
+    unsigned int timer_seq;
+    struct ril_event pending_lists[RIL_EVENT_PRIORITY_COUNT];
+
+    // Clock used for timers; NULL means the system clock
+    ril_event_clock clock_func;
+
+    // Virtual time: the loop never sleeps for a timer, it jumps the
+    // clock to the next one whenever no fd is ready
+    bool virtual_time;
+    struct timeval virtual_now;
+    pthread_mutex_t clockMutex;
+
+    // Loop instrumentation; only touched by the loop thread while enabled
+    volatile bool stats_enabled;
+    struct ril_event_stats stats;
+};
+
+// Used by the functions that do not take a base
+static struct ril_event_base default_base;
 
 #define DEBUG 0
 
@@ -93,7 +167,7 @@ static void dump_event(struct ril_event * ev)
 #define dump_event(x) do {} while(0)
 #endif
 
-static void getNow(struct timeval * tv)
+static void getSystemTime(struct timeval * tv)
 {
 #ifdef HAVE_POSIX_CLOCKS
     struct timespec ts;
@@ -105,6 +179,19 @@ static void getNow(struct timeval * tv)
 #endif
 }
 
+static void getNow(struct ril_event_base * base, struct timeval * tv)
+{
+    if (base->virtual_time) {
+        pthread_mutex_lock(&base->clockMutex);
+        *tv = base->virtual_now;
+        pthread_mutex_unlock(&base->clockMutex);
+    } else if (base->clock_func != NULL) {
+        base->clock_func(tv);
+    } else {
+        getSystemTime(tv);
+    }
+}
+
 static void init_list(struct ril_event * list)
 {
     memset(list, 0, sizeof(struct ril_event));
@@ -122,6 +209,21 @@ static void addToList(struct ril_event * ev, struct ril_event * list)
     dump_event(ev);
 }
 
+static void addToPending(struct ril_event_base * base, struct ril_event * ev)
+{
+    addToList(ev, &base->pending_lists[ev->priority]);
+}
+
+static bool hasPending(struct ril_event_base * base)
+{
+    for (int i = 0; i < RIL_EVENT_PRIORITY_COUNT; i++) {
+        if (base->pending_lists[i].next != &base->pending_lists[i]) {
+            return true;
+        }
+    }
+    return false;
+}
+
 static void removeFromList(struct ril_event * ev)
 {
     dlog("~~~~ Removing event ~~~~");
@@ -134,63 +236,263 @@ static void removeFromList(struct ril_event * ev)
 }
 
 
-static void removeWatch(struct ril_event * ev, int index)
+static void removeWatch(struct ril_event_base * base, struct ril_event * ev, int index)
 {
-    watch_table[index] = NULL;
+    // keep the table dense by moving the last watch into the hole
+    base->watch_count--;
+    if (index != base->watch_count) {
+        base->watch_table[index] = base->watch_table[base->watch_count];
+        base->watch_table[index]->index = index;
+    }
+    base->watch_table[base->watch_count] = NULL;
     ev->index = -1;
 
-    FD_CLR(ev->fd, &readFds);
+#ifdef RIL_EVENT_HAVE_EPOLL
+    if (base->backend == RIL_EVENT_BACKEND_EPOLL) {
+        // fails harmlessly if the fd was already closed
+        epoll_ctl(base->epollFd, EPOLL_CTL_DEL, ev->fd, NULL);
+        return;
+    }
+#endif
+
+    FD_CLR(ev->fd, ev->write ? &base->writeFds : &base->readFds);
 
-    if (ev->fd+1 == nfds) {
+    if (ev->fd+1 == base->nfds) {
         int n = 0;
 
-        for (int i = 0; i < MAX_FD_EVENTS; i++) {
-            struct ril_event * rev = watch_table[i];
+        for (int i = 0; i < base->watch_count; i++) {
+            struct ril_event * rev = base->watch_table[i];
 
-            if ((rev != NULL) && (rev->fd > n)) {
+            if (rev->fd > n) {
                 n = rev->fd;
             }
         }
-        nfds = n + 1;
-        dlog("~~~~ nfds = %d ~~~~", nfds);
+        base->nfds = n + 1;
+        dlog("~~~~ nfds = %d ~~~~", base->nfds);
+    }
+}
+
+static bool growWatchTable(struct ril_event_base * base)
+{
+    int size = (base->watch_table_size == 0) ? WATCH_TABLE_INITIAL_SIZE : base->watch_table_size * 2;
+    struct ril_event ** table;
+
+    table = (struct ril_event **) realloc(base->watch_table, size * sizeof(struct ril_event *));
+    if (table == NULL) {
+        return false;
+    }
+    memset(table + base->watch_table_size, 0,
+            (size - base->watch_table_size) * sizeof(struct ril_event *));
+    base->watch_table = table;
+    base->watch_table_size = size;
+    dlog("~~~~ watch table grown to %d ~~~~", size);
+    return true;
+}
+
+// Timers with equal timeouts fire in the order they were added
+static bool timerBefore(struct ril_event * a, struct ril_event * b)
+{
+    if (timercmp(&a->timeout, &b->timeout, !=)) {
+        return timercmp(&a->timeout, &b->timeout, <);
+    }
+    return (int)(a->seq - b->seq) < 0;
+}
+
+static void heapSet(struct ril_event_base * base, int i, struct ril_event * ev)
+{
+    base->timer_heap[i] = ev;
+    ev->index = i;
+}
+
+static void siftUp(struct ril_event_base * base, int i)
+{
+    struct ril_event * ev = base->timer_heap[i];
+
+    while (i > 0) {
+        int parent = (i - 1) / 2;
+        if (!timerBefore(ev, base->timer_heap[parent])) {
+            break;
+        }
+        heapSet(base, i, base->timer_heap[parent]);
+        i = parent;
+    }
+    heapSet(base, i, ev);
+}
+
+static void siftDown(struct ril_event_base * base, int i)
+{
+    struct ril_event * ev = base->timer_heap[i];
+
+    for (;;) {
+        int child = 2 * i + 1;
+        if (child >= base->timer_count) {
+            break;
+        }
+        if (child + 1 < base->timer_count && timerBefore(base->timer_heap[child + 1], base->timer_heap[child])) {
+            child++;
+        }
+        if (!timerBefore(base->timer_heap[child], ev)) {
+            break;
+        }
+        heapSet(base, i, base->timer_heap[child]);
+        i = child;
+    }
+    heapSet(base, i, ev);
+}
+
+static bool heapInsert(struct ril_event_base * base, struct ril_event * ev)
+{
+    if (base->timer_count == base->timer_heap_size) {
+        int size = (base->timer_heap_size == 0) ? WATCH_TABLE_INITIAL_SIZE : base->timer_heap_size * 2;
+        struct ril_event ** heap;
+
+        heap = (struct ril_event **) realloc(base->timer_heap, size * sizeof(struct ril_event *));
+        if (heap == NULL) {
+            return false;
+        }
+        base->timer_heap = heap;
+        base->timer_heap_size = size;
+    }
+    ev->seq = base->timer_seq++;
+    heapSet(base, base->timer_count++, ev);
+    siftUp(base, ev->index);
+    return true;
+}
+
+static void heapRemove(struct ril_event_base * base, struct ril_event * ev)
+{
+    int i = ev->index;
+    struct ril_event * last = base->timer_heap[--base->timer_count];
+
+    ev->index = -1;
+    if (i != base->timer_count) {
+        heapSet(base, i, last);
+        if (i > 0 && timerBefore(last, base->timer_heap[(i - 1) / 2])) {
+            siftUp(base, i);
+        } else {
+            siftDown(base, i);
+        }
+    }
+}
+
+static void submitPush(struct ril_event_base * base, struct ril_event * ev)
+{
+    struct ril_event * prev;
+
+    ev->submit_next = NULL;
+    // ev must be complete before it becomes reachable
+    __sync_synchronize();
+    prev = __sync_lock_test_and_set(&base->submit_tail, ev);
+    prev->submit_next = ev;
+}
+
+// Returns NULL once the queue is empty. An entry whose producer has not
+// linked it in yet is left for a later iteration; the producer wakes
+// the loop after posting anyway.
+static struct ril_event * submitPop(struct ril_event_base * base)
+{
+    struct ril_event * head = base->submit_head;
+    struct ril_event * next = head->submit_next;
+
+    if (head == &base->submit_stub) {
+        if (next == NULL) {
+            return NULL;
+        }
+        base->submit_head = next;
+        head = next;
+        next = next->submit_next;
+    }
+    if (next == NULL) {
+        if (head != base->submit_tail) {
+            return NULL;
+        }
+        submitPush(base, &base->submit_stub);
+        next = head->submit_next;
+        if (next == NULL) {
+            return NULL;
+        }
+    }
+    base->submit_head = next;
+    __sync_synchronize();
+    return head;
+}
+
+// Hand a cancelled timer back to its owner
+static void releaseCancelled(struct ril_event * ev)
+{
+    dlog("~~~~ releasing cancelled timer ~~~~");
+    ev->timer_state = TIMER_IDLE;
+    ev->func(ev->fd, RIL_EVENT_CANCELLED, ev->param);
+}
+
+// Move posted timers into the heap and apply queued cancellations
+static void drainSubmitted(struct ril_event_base * base)
+{
+    struct ril_event * ev;
+
+    while ((ev = submitPop(base)) != NULL) {
+        if (__sync_bool_compare_and_swap(&ev->timer_state, TIMER_SUBMITTED, TIMER_ARMED)) {
+            if (!heapInsert(base, ev)
+                    && __sync_bool_compare_and_swap(&ev->timer_state,
+                            TIMER_ARMED, TIMER_PENDING)) {
+                // better early than never
+                ALOGE("ril_event: no memory to add timer, firing it now");
+                MUTEX_ACQUIRE();
+                addToPending(base, ev);
+                MUTEX_RELEASE();
+            }
+        } else if (ev->timer_state == TIMER_CANCEL_QUEUED) {
+            if (ev->index >= 0) {
+                heapRemove(base, ev);
+            }
+            releaseCancelled(ev);
+        } else {
+            // cancelled before it reached the heap
+            releaseCancelled(ev);
+        }
     }
 }
 
-static void processTimeouts()
+static void processTimeouts(struct ril_event_base * base, const struct timeval * now)
 {
     dlog("~~~~ +processTimeouts ~~~~");
     MUTEX_ACQUIRE();
-    struct timeval now;
-    struct ril_event * tev = timer_list.next;
-    struct ril_event * next;
 
-    getNow(&now);
-    // walk list, see if now >= ev->timeout for any events
+    // pop the heap while now > ev->timeout
 
-    dlog("~~~~ Looking for timers <= %ds + %dus ~~~~", (int)now.tv_sec, (int)now.tv_usec);
-    while ((tev != &timer_list) && (timercmp(&now, &tev->timeout, >))) {
+    dlog("~~~~ Looking for timers <= %ds + %dus ~~~~", (int)now->tv_sec, (int)now->tv_usec);
+    while (base->timer_count > 0 && timercmp(now, &base->timer_heap[0]->timeout, >)) {
         // Timer expired
+        struct ril_event * tev = base->timer_heap[0];
         dlog("~~~~ firing timer ~~~~");
-        next = tev->next;
-        removeFromList(tev);
-        addToList(tev, &pending_list);
-        tev = next;
+        heapRemove(base, tev);
+        // a timer cancelled while armed is released once its cancel
+        // request is drained
+        if (__sync_bool_compare_and_swap(&tev->timer_state, TIMER_ARMED, TIMER_PENDING)) {
+            addToPending(base, tev);
+        }
     }
     MUTEX_RELEASE();
     dlog("~~~~ -processTimeouts ~~~~");
 }
 
-static void processReadReadies(fd_set * rfds, int n)
+static void processReadReadies(struct ril_event_base * base, fd_set * rfds, fd_set * wfds, int n)
 {
     dlog("~~~~ +processReadReadies (%d) ~~~~", n);
     MUTEX_ACQUIRE();
 
-    for (int i = 0; (i < MAX_FD_EVENTS) && (n > 0); i++) {
-        struct ril_event * rev = watch_table[i];
-        if (rev != NULL && FD_ISSET(rev->fd, rfds)) {
-            addToList(rev, &pending_list);
-            if (rev->persist == false) {
-                removeWatch(rev, i);
+    // walk backwards so removing a one-shot watch only moves an
+    // already visited entry into the current slot
+    for (int i = base->watch_count - 1; (i >= 0) && (n > 0); i--) {
+        struct ril_event * rev = base->watch_table[i];
+        if (FD_ISSET(rev->fd, rev->write ? wfds : rfds)) {
+            // a persistent watch may still be pending from an earlier
+            // iteration if its priority ran out of budget
+            if (rev->next == NULL) {
+                addToPending(base, rev);
+                if (rev->persist == false) {
+                    removeWatch(base, rev, i);
+                }
             }
             n--;
         }
@@ -200,85 +502,462 @@ static void processReadReadies(fd_set * rfds, int n)
     dlog("~~~~ -processReadReadies (%d) ~~~~", n);
 }
 
-static void firePending()
+#ifdef RIL_EVENT_HAVE_EPOLL
+static void processEpollReadies(struct ril_event_base * base, int n)
+{
+    dlog("~~~~ +processEpollReadies (%d) ~~~~", n);
+    MUTEX_ACQUIRE();
+
+    for (int i = 0; i < n; i++) {
+        struct ril_event * rev = (struct ril_event *) base->epoll_events[i].data.ptr;
+
+        // the watch may have been removed since epoll_wait() returned
+        if (rev->index < 0 || base->watch_table[rev->index] != rev) {
+            continue;
+        }
+        // or may still be pending from an earlier iteration
+        if (rev->next != NULL) {
+            continue;
+        }
+        addToPending(base, rev);
+        if (rev->persist == false) {
+            removeWatch(base, rev, rev->index);
+        }
+    }
+
+    MUTEX_RELEASE();
+    dlog("~~~~ -processEpollReadies (%d) ~~~~", n);
+}
+#endif
+
+static uint32_t elapsedUs(const struct timeval * from, const struct timeval * to)
+{
+    struct timeval delta;
+
+    if (timercmp(to, from, <)) {
+        return 0;
+    }
+    timersub(to, from, &delta);
+    if (delta.tv_sec >= 4294) {
+        // saturate rather than wrap
+        return 0xffffffff;
+    }
+    return delta.tv_sec * 1000000 + delta.tv_usec;
+}
+
+// Histogram for the given callback, claiming a slot on first use
+static struct ril_histogram * callbackHistogram(struct ril_event_base * base, const void * key)
+{
+    int start = (int) (((uintptr_t) key >> 2) % RIL_EVENT_STATS_CALLBACKS);
+
+    for (int i = 0; i < RIL_EVENT_STATS_CALLBACKS; i++) {
+        struct ril_event_callback_stats * cs =
+                &base->stats.callbacks[(start + i) % RIL_EVENT_STATS_CALLBACKS];
+
+        if (cs->key == key) {
+            return &cs->run_us;
+        }
+        if (cs->key == NULL) {
+            // the histogram is still zeroed; publish the key after it
+            __sync_synchronize();
+            cs->key = key;
+            return &cs->run_us;
+        }
+    }
+    return &base->stats.other_run_us;
+}
+
+static void fireTimed(struct ril_event_base * base, struct ril_event * ev)
+{
+    struct timeval start;
+    struct timeval end;
+    // the callback may free ev
+    ril_event_cb func = ev->func;
+    const void * key = ev->stats_key;
+
+    getNow(base, &start);
+    if (ev->fd < 0) {
+        ril_histogram_record(&base->stats.late_us, elapsedUs(&ev->timeout, &start));
+    }
+    func(ev->fd, 0, ev->param);
+    getNow(base, &end);
+    ril_histogram_record(callbackHistogram(base, key), elapsedUs(&start, &end));
+}
+
+// Returns the number of callbacks fired
+static int firePending(struct ril_event_base * base)
 {
     dlog("~~~~ +firePending ~~~~");
-    struct ril_event * ev = pending_list.next;
-    while (ev != &pending_list) {
-        struct ril_event * next = ev->next;
+    int fired = 0;
+    int budget[RIL_EVENT_PRIORITY_COUNT];
+
+    memcpy(budget, priority_budget, sizeof(budget));
+    for (;;) {
+        struct ril_event * ev = NULL;
+
+        // pop under the lock: ril_event_del may unlink a pending event
+        // from another thread
+        MUTEX_ACQUIRE();
+        for (int i = 0; i < RIL_EVENT_PRIORITY_COUNT; i++) {
+            if (budget[i] > 0 && base->pending_lists[i].next != &base->pending_lists[i]) {
+                ev = base->pending_lists[i].next;
+                budget[i]--;
+                break;
+            }
+        }
+        if (ev == NULL) {
+            MUTEX_RELEASE();
+            break;
+        }
         removeFromList(ev);
-        ev->func(ev->fd, 0, ev->param);
-        ev = next;
+        MUTEX_RELEASE();
+
+        if (ev->fd < 0
+                && !__sync_bool_compare_and_swap(&ev->timer_state, TIMER_PENDING, TIMER_IDLE)) {
+            releaseCancelled(ev);
+            continue;
+        }
+
+        if (base->stats_enabled) {
+            fireTimed(base, ev);
+        } else {
+            ev->func(ev->fd, 0, ev->param);
+        }
+        fired++;
     }
     dlog("~~~~ -firePending ~~~~");
+    return fired;
 }
 
-static int calcNextTimeout(struct timeval * tv)
+static int calcNextTimeout(struct ril_event_base * base, struct timeval * tv, const struct timeval * now)
 {
-    struct ril_event * tev = timer_list.next;
-    struct timeval now;
+    MUTEX_ACQUIRE();
 
-    getNow(&now);
+    if (hasPending(base)) {
+        // work left over from the last iteration; just poll
+        tv->tv_sec = tv->tv_usec = 0;
+        MUTEX_RELEASE();
+        return 0;
+    }
 
-    // Sorted list, so calc based on first node
-    if (tev == &timer_list) {
+    // Min-heap, so calc based on the root
+    if (base->timer_count == 0) {
         // no pending timers
+        MUTEX_RELEASE();
         return -1;
     }
 
-    dlog("~~~~ now = %ds + %dus ~~~~", (int)now.tv_sec, (int)now.tv_usec);
+    struct ril_event * tev = base->timer_heap[0];
+    dlog("~~~~ now = %ds + %dus ~~~~", (int)now->tv_sec, (int)now->tv_usec);
     dlog("~~~~ next = %ds + %dus ~~~~",
             (int)tev->timeout.tv_sec, (int)tev->timeout.tv_usec);
-    if (timercmp(&tev->timeout, &now, >)) {
-        timersub(&tev->timeout, &now, tv);
+    if (!base->virtual_time && timercmp(&tev->timeout, now, >)) {
+        timersub(&tev->timeout, now, tv);
     } else {
-        // timer already expired.
+        // timer already expired, or virtual time where we only poll
         tv->tv_sec = tv->tv_usec = 0;
     }
+    MUTEX_RELEASE();
     return 0;
 }
 
+// Jump the virtual clock just past the first timer, since timers
+// only expire once the clock is beyond their timeout
+static void advanceVirtualTime(struct ril_event_base * base)
+{
+    static const struct timeval tick = {0, 1};
+
+    MUTEX_ACQUIRE();
+    // time stands still while there is work left to run
+    if (base->timer_count > 0 && !hasPending(base)) {
+        struct timeval next;
+
+        timeradd(&base->timer_heap[0]->timeout, &tick, &next);
+        pthread_mutex_lock(&base->clockMutex);
+        if (timercmp(&next, &base->virtual_now, >)) {
+            dlog("~~~~ advancing virtual time to %ds + %dus ~~~~",
+                    (int)next.tv_sec, (int)next.tv_usec);
+            base->virtual_now = next;
+        }
+        pthread_mutex_unlock(&base->clockMutex);
+    }
+    MUTEX_RELEASE();
+}
+
+static void initBase(struct ril_event_base * base, enum ril_event_backend requested)
+{
+    MUTEX_INIT();
+    pthread_mutex_init(&base->clockMutex, NULL);
+
+    FD_ZERO(&base->readFds);
+    FD_ZERO(&base->writeFds);
+    for (int i = 0; i < RIL_EVENT_PRIORITY_COUNT; i++) {
+        init_list(&base->pending_lists[i]);
+    }
+    base->timer_count = 0;
+    base->watch_count = 0;
+    memset(&base->submit_stub, 0, sizeof(base->submit_stub));
+    base->submit_tail = base->submit_head = &base->submit_stub;
+    growWatchTable(base);
+
+    base->backend = RIL_EVENT_BACKEND_SELECT;
+#ifdef RIL_EVENT_HAVE_EPOLL
+    base->epollFd = -1;
+    if (requested != RIL_EVENT_BACKEND_SELECT) {
+        base->epollFd = epoll_create(WATCH_TABLE_INITIAL_SIZE);
+        // The loop only ever grows the ready array, so it must start out
+        // with room; epoll_wait rejects maxevents of 0
+        base->epoll_events = (struct epoll_event *)
+                malloc(WATCH_TABLE_INITIAL_SIZE * sizeof(struct epoll_event));
+        base->epoll_events_size = (base->epoll_events != NULL) ? WATCH_TABLE_INITIAL_SIZE : 0;
+        if (base->epollFd >= 0 && base->epoll_events != NULL) {
+            fcntl(base->epollFd, F_SETFD, FD_CLOEXEC);
+            base->backend = RIL_EVENT_BACKEND_EPOLL;
+        } else {
+            ALOGW("ril_event: epoll setup failed (%d), falling back to select", errno);
+            if (base->epollFd >= 0) {
+                close(base->epollFd);
+                base->epollFd = -1;
+            }
+            free(base->epoll_events);
+            base->epoll_events = NULL;
+            base->epoll_events_size = 0;
+        }
+    }
+#endif
+    dlog("~~~~ using %s backend ~~~~",
+            (base->backend == RIL_EVENT_BACKEND_EPOLL) ? "epoll" : "select");
+}
+
 // Initialize internal data structs
 void ril_event_init()
 {
-    MUTEX_INIT();
+    ril_event_init_backend(RIL_EVENT_BACKEND_DEFAULT);
+}
+
+// Initialize internal data structs, using the given readiness backend
+void ril_event_init_backend(enum ril_event_backend requested)
+{
+    initBase(&default_base, requested);
+}
+
+// Create an independent event loop
+struct ril_event_base * ril_event_base_new(enum ril_event_backend requested)
+{
+    struct ril_event_base * base;
 
-    FD_ZERO(&readFds);
-    init_list(&timer_list);
-    init_list(&pending_list);
-    memset(watch_table, 0, sizeof(watch_table));
+    base = (struct ril_event_base *) calloc(1, sizeof(struct ril_event_base));
+    if (base == NULL) {
+        return NULL;
+    }
+    initBase(base, requested);
+    if (base->watch_table == NULL) {
+        free(base);
+        return NULL;
+    }
+    return base;
+}
+
+struct ril_event_base * ril_event_default_base()
+{
+    return &default_base;
+}
+
+// Readiness backend selected by ril_event_init
+enum ril_event_backend ril_event_get_backend()
+{
+    return ril_event_base_get_backend(&default_base);
+}
+
+enum ril_event_backend ril_event_base_get_backend(struct ril_event_base * base)
+{
+    return base->backend;
+}
+
+void ril_event_set_clock(ril_event_clock clock)
+{
+    ril_event_base_set_clock(&default_base, clock);
+}
+
+void ril_event_base_set_clock(struct ril_event_base * base, ril_event_clock clock)
+{
+    base->virtual_time = false;
+    base->clock_func = clock;
+}
+
+void ril_event_set_virtual_time(bool enabled)
+{
+    ril_event_base_set_virtual_time(&default_base, enabled);
+}
+
+void ril_event_base_set_virtual_time(struct ril_event_base * base, bool enabled)
+{
+    if (enabled && !base->virtual_time) {
+        // start from the current time so already queued timers keep
+        // their relative order and spacing
+        getNow(base, &base->virtual_now);
+    }
+    base->virtual_time = enabled;
+}
+
+void ril_event_get_time(struct timeval * tv)
+{
+    ril_event_base_get_time(&default_base, tv);
+}
+
+void ril_event_base_get_time(struct ril_event_base * base, struct timeval * tv)
+{
+    getNow(base, tv);
+}
+
+void ril_event_set_stats_enabled(bool enabled)
+{
+    ril_event_base_set_stats_enabled(&default_base, enabled);
+}
+
+void ril_event_base_set_stats_enabled(struct ril_event_base * base, bool enabled)
+{
+    base->stats_enabled = enabled;
+}
+
+bool ril_event_get_stats_enabled()
+{
+    return ril_event_base_get_stats_enabled(&default_base);
+}
+
+bool ril_event_base_get_stats_enabled(struct ril_event_base * base)
+{
+    return base->stats_enabled;
+}
+
+const struct ril_event_stats * ril_event_get_stats()
+{
+    return ril_event_base_get_stats(&default_base);
+}
+
+const struct ril_event_stats * ril_event_base_get_stats(struct ril_event_base * base)
+{
+    return &base->stats;
+}
+
+static void dumpHistogram(const char * name, const struct ril_histogram * h)
+{
+    ALOGI("%s: count %u, p50 %uus, p90 %uus, p99 %uus, max %uus", name,
+            (unsigned int) h->count,
+            (unsigned int) ril_histogram_percentile(h, 50),
+            (unsigned int) ril_histogram_percentile(h, 90),
+            (unsigned int) ril_histogram_percentile(h, 99),
+            (unsigned int) h->max);
+}
+
+void ril_event_dump_stats()
+{
+    ril_event_base_dump_stats(&default_base);
+}
+
+void ril_event_base_dump_stats(struct ril_event_base * base)
+{
+    const struct ril_event_stats * stats = &base->stats;
+    char name[32];
+
+    ALOGI("event loop %p stats (%s)", base, base->stats_enabled ? "enabled" : "disabled");
+    dumpHistogram("wait", &stats->wait_us);
+    dumpHistogram("timer lateness", &stats->late_us);
+    for (int i = 0; i < RIL_EVENT_STATS_CALLBACKS; i++) {
+        const struct ril_event_callback_stats * cs = &stats->callbacks[i];
+
+        if (cs->key != NULL) {
+            snprintf(name, sizeof(name), "callback %p", cs->key);
+            dumpHistogram(name, &cs->run_us);
+        }
+    }
+    if (stats->other_run_us.count > 0) {
+        dumpHistogram("other callbacks", &stats->other_run_us);
+    }
 }
 
 // Initialize an event
-void ril_event_set(struct ril_event * ev, int fd, bool persist, ril_event_cb func, void * param)
+void ril_event_set(struct ril_event * ev, int fd, bool persist, ril_event_cb func, void * param,
+        enum ril_event_priority priority)
+{
+    ril_event_base_set(&default_base, ev, fd, persist, func, param, priority);
+}
+
+// Initialize an event belonging to the given loop
+void ril_event_base_set(struct ril_event_base * base, struct ril_event * ev, int fd,
+        bool persist, ril_event_cb func, void * param, enum ril_event_priority priority)
 {
     dlog("~~~~ ril_event_set %x ~~~~", (unsigned int)ev);
     memset(ev, 0, sizeof(struct ril_event));
+    ev->base = base;
     ev->fd = fd;
     ev->index = -1;
     ev->persist = persist;
     ev->func = func;
     ev->param = param;
+    ev->stats_key = (const void *) func;
+    ev->priority = (priority >= 0 && priority < RIL_EVENT_PRIORITY_COUNT)
+            ? priority : RIL_EVENT_PRIORITY_NORMAL;
     fcntl(fd, F_SETFL, O_NONBLOCK);
 }
 
+// Watch for writability instead
+void ril_event_set_write(struct ril_event * ev)
+{
+    ev->write = true;
+}
+
+// Time the event under key in the loop stats
+void ril_event_set_stats_key(struct ril_event * ev, const void * key)
+{
+    ev->stats_key = key;
+}
+
 // Add event to watch list
 void ril_event_add(struct ril_event * ev)
 {
+    struct ril_event_base * base = ev->base;
+
     dlog("~~~~ +ril_event_add ~~~~");
     MUTEX_ACQUIRE();
-    for (int i = 0; i < MAX_FD_EVENTS; i++) {
-        if (watch_table[i] == NULL) {
-            watch_table[i] = ev;
-            ev->index = i;
-            dlog("~~~~ added at %d ~~~~", i);
-            dump_event(ev);
-            FD_SET(ev->fd, &readFds);
-            if (ev->fd >= nfds) nfds = ev->fd+1;
-            dlog("~~~~ nfds = %d ~~~~", nfds);
-            break;
+
+    if (base->watch_count == base->watch_table_size && !growWatchTable(base)) {
+        ALOGE("ril_event: no memory to watch fd %d", ev->fd);
+        MUTEX_RELEASE();
+        return;
+    }
+
+#ifdef RIL_EVENT_HAVE_EPOLL
+    if (base->backend == RIL_EVENT_BACKEND_EPOLL) {
+        struct epoll_event eev;
+
+        memset(&eev, 0, sizeof(eev));
+        eev.events = ev->write ? EPOLLOUT : EPOLLIN;
+        eev.data.ptr = ev;
+        if (epoll_ctl(base->epollFd, EPOLL_CTL_ADD, ev->fd, &eev) < 0) {
+            ALOGE("ril_event: epoll_ctl add fd %d error (%d)", ev->fd, errno);
+            MUTEX_RELEASE();
+            return;
+        }
+    } else
+#endif
+    {
+        // An fd_set has no room past FD_SETSIZE; FD_SET would write off its end
+        if (ev->fd < 0 || ev->fd >= FD_SETSIZE) {
+            ALOGE("ril_event: fd %d out of range for select", ev->fd);
+            MUTEX_RELEASE();
+            return;
         }
+        FD_SET(ev->fd, ev->write ? &base->writeFds : &base->readFds);
+        if (ev->fd >= base->nfds) base->nfds = ev->fd+1;
+        dlog("~~~~ nfds = %d ~~~~", base->nfds);
     }
+
+    base->watch_table[base->watch_count] = ev;
+    ev->index = base->watch_count++;
+    dlog("~~~~ added at %d ~~~~", ev->index);
+    dump_event(ev);
+
     MUTEX_RELEASE();
     dlog("~~~~ -ril_event_add ~~~~");
 }
@@ -286,76 +965,184 @@ void ril_event_add(struct ril_event * ev)
 // Add timer event
 void ril_timer_add(struct ril_event * ev, struct timeval * tv)
 {
+    struct ril_event_base * base = ev->base;
+
     dlog("~~~~ +ril_timer_add ~~~~");
-    MUTEX_ACQUIRE();
 
-    struct ril_event * list;
     if (tv != NULL) {
-        // add to timer list
-        list = timer_list.next;
-        ev->fd = -1; // make sure fd is invalid
-
         struct timeval now;
-        getNow(&now);
+        getNow(base, &now);
+
+        ev->fd = -1; // make sure fd is invalid
         timeradd(&now, tv, &ev->timeout);
 
-        // keep list sorted
-        while (timercmp(&list->timeout, &ev->timeout, < )
-                && (list != &timer_list)) {
-            list = list->next;
-        }
-        // list now points to the first event older than ev
-        addToList(ev, list);
+        // the loop moves it to the timer heap
+        ev->timer_state = TIMER_SUBMITTED;
+        submitPush(base, ev);
     }
 
-    MUTEX_RELEASE();
     dlog("~~~~ -ril_timer_add ~~~~");
 }
 
 // Remove event from watch or timer list
-void ril_event_del(struct ril_event * ev)
+bool ril_event_del(struct ril_event * ev)
 {
+    struct ril_event_base * base = ev->base;
+
     dlog("~~~~ +ril_event_del ~~~~");
-    MUTEX_ACQUIRE();
 
-    if (ev->index < 0 || ev->index >= MAX_FD_EVENTS) {
-        MUTEX_RELEASE();
-        return;
+    // timers are only flagged here; the loop thread does the removal
+    while (ev->fd < 0) {
+        int state = ev->timer_state;
+
+        if (state == TIMER_SUBMITTED || state == TIMER_PENDING) {
+            if (__sync_bool_compare_and_swap(&ev->timer_state, state, TIMER_CANCELLED)) {
+                return true;
+            }
+        } else if (state == TIMER_ARMED) {
+            if (__sync_bool_compare_and_swap(&ev->timer_state, state, TIMER_CANCEL_QUEUED)) {
+                submitPush(base, ev);
+                return true;
+            }
+        } else {
+            return false;
+        }
     }
 
-    removeWatch(ev, ev->index);
+    MUTEX_ACQUIRE();
+
+    bool queued = false;
+
+    if (ev->index >= 0 && ev->index < base->watch_count && base->watch_table[ev->index] == ev) {
+        removeWatch(base, ev, ev->index);
+        queued = true;
+    }
+    if (ev->next != NULL) {
+        // ready, but deferred to a later iteration
+        removeFromList(ev);
+        queued = true;
+    }
 
     MUTEX_RELEASE();
     dlog("~~~~ -ril_event_del ~~~~");
+    return queued;
 }
 
 #if DEBUG
-static void printReadies(fd_set * rfds)
+static void printReadies(struct ril_event_base * base, fd_set * rfds)
 {
-    for (int i = 0; (i < MAX_FD_EVENTS); i++) {
-        struct ril_event * rev = watch_table[i];
-        if (rev != NULL && FD_ISSET(rev->fd, rfds)) {
+    for (int i = 0; i < base->watch_count; i++) {
+        struct ril_event * rev = base->watch_table[i];
+        if (FD_ISSET(rev->fd, rfds)) {
           dlog("DON: fd=%d is ready", rev->fd);
         }
     }
 }
 #else
-#define printReadies(rfds) do {} while(0)
+#define printReadies(base, rfds) do {} while(0)
+#endif
+
+#ifdef RIL_EVENT_HAVE_EPOLL
+static void epoll_event_loop(struct ril_event_base * base)
+{
+    int n;
+    int timeoutMs;
+    struct timeval tv;
+    struct timeval now;
+    struct timeval waitStart;
+
+    getNow(base, &now);
+    for (;;) {
+
+        // take in timers posted since the last iteration
+        drainSubmitted(base);
+        if (-1 == calcNextTimeout(base, &tv, &now)) {
+            // no pending timers; block indefinitely
+            dlog("~~~~ no timers; blocking indefinitely ~~~~");
+            timeoutMs = -1;
+        } else {
+            dlog("~~~~ blocking for %ds + %dus ~~~~", (int)tv.tv_sec, (int)tv.tv_usec);
+            // round up so we never wake before the first timer is due
+            timeoutMs = tv.tv_sec * 1000 + (tv.tv_usec + 999) / 1000;
+        }
+
+        // size the ready array to the watch table so one call sees every
+        // fd; if that fails, the old array still works, a few fds a call
+        MUTEX_ACQUIRE();
+        if (base->epoll_events_size < base->watch_table_size) {
+            struct epoll_event * events = (struct epoll_event *)
+                    realloc(base->epoll_events, base->watch_table_size * sizeof(struct epoll_event));
+            if (events != NULL) {
+                base->epoll_events = events;
+                base->epoll_events_size = base->watch_table_size;
+            }
+        }
+        MUTEX_RELEASE();
+
+        n = epoll_wait(base->epollFd, base->epoll_events, base->epoll_events_size, timeoutMs);
+        dlog("~~~~ %d events fired ~~~~", n);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+
+            ALOGE("ril_event: epoll_wait error (%d)", errno);
+            // bail?
+            return;
+        }
+
+        if (n == 0 && base->virtual_time) {
+            advanceVirtualTime(base);
+        }
+
+        // One clock sample serves both the expiry pass and the
+        // next timeout, unless callbacks ran in between
+        waitStart = now;
+        getNow(base, &now);
+        if (base->stats_enabled) {
+            ril_histogram_record(&base->stats.wait_us, elapsedUs(&waitStart, &now));
+        }
+        // Check for timeouts
+        processTimeouts(base, &now);
+        // Check for read-ready
+        processEpollReadies(base, n);
+        // Fire away
+        if (firePending(base) > 0) {
+            getNow(base, &now);
+        }
+    }
+}
 #endif
 
 void ril_event_loop()
+{
+    ril_event_base_loop(&default_base);
+}
+
+void ril_event_base_loop(struct ril_event_base * base)
 {
     int n;
     fd_set rfds;
+    fd_set wfds;
     struct timeval tv;
     struct timeval * ptv;
+    struct timeval now;
+    struct timeval waitStart;
 
+#ifdef RIL_EVENT_HAVE_EPOLL
+    if (base->backend == RIL_EVENT_BACKEND_EPOLL) {
+        epoll_event_loop(base);
+        return;
+    }
+#endif
 
+    getNow(base, &now);
     for (;;) {
 
-        // make local copy of read fd_set
-        memcpy(&rfds, &readFds, sizeof(fd_set));
-        if (-1 == calcNextTimeout(&tv)) {
+        // make local copies of the fd_sets
+        memcpy(&rfds, &base->readFds, sizeof(fd_set));
+        memcpy(&wfds, &base->writeFds, sizeof(fd_set));
+        // take in timers posted since the last iteration
+        drainSubmitted(base);
+        if (-1 == calcNextTimeout(base, &tv, &now)) {
             // no pending timers; block indefinitely
             dlog("~~~~ no timers; blocking indefinitely ~~~~");
             ptv = NULL;
@@ -363,9 +1150,9 @@ void ril_event_loop()
             dlog("~~~~ blocking for %ds + %dus ~~~~", (int)tv.tv_sec, (int)tv.tv_usec);
             ptv = &tv;
         }
-        printReadies(&rfds);
-        n = select(nfds, &rfds, NULL, NULL, ptv);
-        printReadies(&rfds);
+        printReadies(base, &rfds);
+        n = select(base->nfds, &rfds, &wfds, NULL, ptv);
+        printReadies(base, &rfds);
         dlog("~~~~ %d events fired ~~~~", n);
         if (n < 0) {
             if (errno == EINTR) continue;
@@ -375,11 +1162,24 @@ void ril_event_loop()
             return;
         }
 
+        if (n == 0 && base->virtual_time) {
+            advanceVirtualTime(base);
+        }
+
+        // One clock sample serves both the expiry pass and the
+        // next timeout, unless callbacks ran in between
+        waitStart = now;
+        getNow(base, &now);
+        if (base->stats_enabled) {
+            ril_histogram_record(&base->stats.wait_us, elapsedUs(&waitStart, &now));
+        }
         // Check for timeouts
-        processTimeouts();
+        processTimeouts(base, &now);
         // Check for read-ready
-        processReadReadies(&rfds, n);
+        processReadReadies(base, &rfds, &wfds, n);
         // Fire away
-        firePending();
+        if (firePending(base) > 0) {
+            getNow(base, &now);
+        }
     }
 }
@@ -15,38 +15,164 @@
 ** limitations under the License.
 */
 
-// Max number of fd's we watch at any one time.  Increase if necessary.
-#define MAX_FD_EVENTS 8
+#include "ril_histogram.h"
 
 typedef void (*ril_event_cb)(int fd, short events, void *userdata);
 
+// Passed in events when a cancelled timer is handed back to its callback
+#define RIL_EVENT_CANCELLED 0x1
+
+// Order in which ready events are dispatched within one loop iteration.
+// High priority events always run; normal and low priority ones run up
+// to a per-iteration budget, and the rest wait until fds have been
+// polled again.
+enum ril_event_priority {
+    RIL_EVENT_PRIORITY_HIGH,
+    RIL_EVENT_PRIORITY_NORMAL,
+    RIL_EVENT_PRIORITY_LOW,
+    RIL_EVENT_PRIORITY_COUNT
+};
+
+// One event loop; see ril_event_base_new
+struct ril_event_base;
+
 struct ril_event {
     struct ril_event *next;
     struct ril_event *prev;
+    struct ril_event_base *base;
 
     int fd;
-    int index;
+    int index;          // slot in the watch table or timer heap
     bool persist;
+    bool write;         // watch fd for writability rather than readability
     struct timeval timeout;
+    unsigned int seq;   // orders timers with equal timeouts
+    enum ril_event_priority priority;
+    volatile int timer_state;
+    struct ril_event * volatile submit_next;    // timer submission queue link
     ril_event_cb func;
     void *param;
+    const void *stats_key;  // what the loop stats time func as
+};
+
+// How the loop waits for fd readiness. select() is always available;
+// epoll is used on Linux unless built with RIL_EVENT_NO_EPOLL.
+enum ril_event_backend {
+    RIL_EVENT_BACKEND_DEFAULT,
+    RIL_EVENT_BACKEND_SELECT,
+    RIL_EVENT_BACKEND_EPOLL
+};
+
+// Number of distinct callbacks timed individually by the loop stats
+#define RIL_EVENT_STATS_CALLBACKS 16
+
+struct ril_event_callback_stats {
+    const void * key;               // NULL while the slot is unused
+    struct ril_histogram run_us;
+};
+
+// Event loop instrumentation, all in microseconds. Only the loop thread
+// writes it; other threads may read it while the loop is running.
+struct ril_event_stats {
+    struct ril_histogram wait_us;   // time blocked waiting for fds or timers
+    struct ril_histogram late_us;   // timer fire time minus ev->timeout
+    struct ril_event_callback_stats callbacks[RIL_EVENT_STATS_CALLBACKS];
+    struct ril_histogram other_run_us;  // callbacks that found no free slot
 };
 
 // Initialize internal data structs
 void ril_event_init();
 
+// Initialize internal data structs, using the given readiness backend.
+// Falls back to select if the backend is unavailable.
+void ril_event_init_backend(enum ril_event_backend backend);
+
+// Readiness backend selected by ril_event_init
+enum ril_event_backend ril_event_get_backend();
+
+// Create an event loop independent of the default one, e.g. one per
+// radio. It needs its own thread running ril_event_base_loop. Returns
+// NULL if out of memory.
+//
+// The ril_event_* functions without a base argument act on the default
+// loop set up by ril_event_init; the ril_event_base_* ones below are
+// their counterparts for any loop. Adding and removing an event acts on
+// the loop the event was set up for.
+struct ril_event_base * ril_event_base_new(enum ril_event_backend backend);
+
+// The loop behind the functions that take no base
+struct ril_event_base * ril_event_default_base();
+
+enum ril_event_backend ril_event_base_get_backend(struct ril_event_base * base);
+
+// Source of the current time for timers. It must never go backwards.
+typedef void (*ril_event_clock)(struct timeval * tv);
+
+// Use the given clock for timers, or the system clock if NULL.
+// Must be called before the loop starts and before any timer is added.
+void ril_event_set_clock(ril_event_clock clock);
+void ril_event_base_set_clock(struct ril_event_base * base, ril_event_clock clock);
+
+// Run timers in virtual time, starting from the current clock: the loop
+// only polls fds, and when none is ready it jumps the clock straight to
+// the next timer instead of sleeping. Timers due at the same time fire
+// in the order they were added. Must be called before the loop starts.
+void ril_event_set_virtual_time(bool enabled);
+void ril_event_base_set_virtual_time(struct ril_event_base * base, bool enabled);
+
+// Current time as seen by the loop's timers
+void ril_event_get_time(struct timeval * tv);
+void ril_event_base_get_time(struct ril_event_base * base, struct timeval * tv);
+
 // Initialize an event
-void ril_event_set(struct ril_event * ev, int fd, bool persist, ril_event_cb func, void * param);
+void ril_event_set(struct ril_event * ev, int fd, bool persist, ril_event_cb func, void * param,
+        enum ril_event_priority priority = RIL_EVENT_PRIORITY_NORMAL);
+void ril_event_base_set(struct ril_event_base * base, struct ril_event * ev, int fd,
+        bool persist, ril_event_cb func, void * param,
+        enum ril_event_priority priority = RIL_EVENT_PRIORITY_NORMAL);
+
+// Make an event set up by ril_event_set fire when its fd is writable
+// instead of readable. With the epoll backend an fd can only be watched
+// once per loop, so to watch both ways, watch a dup() of it for one.
+void ril_event_set_write(struct ril_event * ev);
+
+// Time an event set up by ril_event_set under key in the loop stats
+// instead of under its callback, e.g. to tell apart the callers of a
+// shared trampoline
+void ril_event_set_stats_key(struct ril_event * ev, const void * key);
 
 // Add event to watch list
 void ril_event_add(struct ril_event * ev);
 
-// Add timer event
+// Add timer event. Never blocks, so any thread may call it; the loop
+// picks the timer up on its next iteration, so wake it if it may be
+// sleeping.
 void ril_timer_add(struct ril_event * ev, struct timeval * tv);
 
-// Remove event from watch list
-void ril_event_del(struct ril_event * ev);
+// Remove event from watch list or timer heap. Returns true if the event
+// was still queued; an event removed this way will not fire.
+// A cancelled timer still belongs to the loop until its callback is
+// called with RIL_EVENT_CANCELLED in events; only then may it be freed
+// or added again.
+bool ril_event_del(struct ril_event * ev);
+
+// Turn loop instrumentation on or off. Off by default, in which case
+// the loop does not read the clock any more than it needs to.
+void ril_event_set_stats_enabled(bool enabled);
+void ril_event_base_set_stats_enabled(struct ril_event_base * base, bool enabled);
+
+bool ril_event_get_stats_enabled();
+bool ril_event_base_get_stats_enabled(struct ril_event_base * base);
+
+// Live view of the loop stats
+const struct ril_event_stats * ril_event_get_stats();
+const struct ril_event_stats * ril_event_base_get_stats(struct ril_event_base * base);
+
+// Log a summary of the loop stats
+void ril_event_dump_stats();
+void ril_event_base_dump_stats(struct ril_event_base * base);
 
 // Event loop
 void ril_event_loop();
+void ril_event_base_loop(struct ril_event_base * base);
 
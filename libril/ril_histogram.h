@@ -0,0 +1,110 @@
+/* //device/libs/telephony/ril_histogram.h
+**
+** Copyright 2008, The Android Open Source Project
+**
+** Licensed under the Apache License, Version 2.0 (the "License");
+** you may not use this file except in compliance with the License.
+** You may obtain a copy of the License at
+**
+**     http://www.apache.org/licenses/LICENSE-2.0
+**
+** Unless required by applicable law or agreed to in writing, software
+** distributed under the License is distributed on an "AS IS" BASIS,
+** WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+** See the License for the specific language governing permissions and
+** limitations under the License.
+*/
+
+#ifndef RIL_HISTOGRAM_H
+#define RIL_HISTOGRAM_H
+
+#include <stdint.h>
+#include <string.h>
+
+// Log-linear histogram of 32-bit values (usually microseconds).
+// Values below RIL_HISTOGRAM_SUB_BUCKETS get a bucket each; above that,
+// every power of two is split into RIL_HISTOGRAM_SUB_BUCKETS linear
+// buckets, so a bucket is at most 25% wide.
+//
+// Recording is a few atomic adds and never blocks; readers may look at
+// a histogram while it is being updated and see a slightly stale count.
+#define RIL_HISTOGRAM_SUB_BITS 2
+#define RIL_HISTOGRAM_SUB_BUCKETS (1 << RIL_HISTOGRAM_SUB_BITS)
+#define RIL_HISTOGRAM_BUCKETS ((32 - RIL_HISTOGRAM_SUB_BITS + 1) * RIL_HISTOGRAM_SUB_BUCKETS)
+
+struct ril_histogram {
+    volatile uint32_t count;
+    volatile uint32_t max;
+    volatile uint32_t buckets[RIL_HISTOGRAM_BUCKETS];
+};
+
+static inline void ril_histogram_clear(struct ril_histogram * h)
+{
+    memset((void *) h, 0, sizeof(*h));
+}
+
+static inline int ril_histogram_bucket(uint32_t value)
+{
+    if (value < RIL_HISTOGRAM_SUB_BUCKETS) {
+        return value;
+    }
+    int msb = 31 - __builtin_clz(value);
+    int sub = (value >> (msb - RIL_HISTOGRAM_SUB_BITS)) & (RIL_HISTOGRAM_SUB_BUCKETS - 1);
+    return (msb - RIL_HISTOGRAM_SUB_BITS + 1) * RIL_HISTOGRAM_SUB_BUCKETS + sub;
+}
+
+// Smallest value that falls in the given bucket
+static inline uint32_t ril_histogram_bucket_floor(int bucket)
+{
+    if (bucket < RIL_HISTOGRAM_SUB_BUCKETS) {
+        return bucket;
+    }
+    int msb = bucket / RIL_HISTOGRAM_SUB_BUCKETS + RIL_HISTOGRAM_SUB_BITS - 1;
+    int sub = bucket % RIL_HISTOGRAM_SUB_BUCKETS;
+    return (1u << msb) + ((uint32_t) sub << (msb - RIL_HISTOGRAM_SUB_BITS));
+}
+
+static inline void ril_histogram_record(struct ril_histogram * h, uint32_t value)
+{
+    __sync_fetch_and_add(&h->buckets[ril_histogram_bucket(value)], 1);
+    __sync_fetch_and_add(&h->count, 1);
+
+    uint32_t max = h->max;
+    while (value > max) {
+        uint32_t seen = __sync_val_compare_and_swap(&h->max, max, value);
+        if (seen == max) {
+            break;
+        }
+        max = seen;
+    }
+}
+
+// Lower bound of the bucket holding the given percentile (0-100),
+// or 0 if the histogram is empty
+static inline uint32_t ril_histogram_percentile(const struct ril_histogram * h, int percent)
+{
+    uint32_t total = 0;
+    uint32_t seen = 0;
+
+    for (int i = 0; i < RIL_HISTOGRAM_BUCKETS; i++) {
+        total += h->buckets[i];
+    }
+    if (total == 0) {
+        return 0;
+    }
+
+    // rank of the requested sample, 1-based
+    uint32_t rank = (uint32_t) (((uint64_t) total * percent + 99) / 100);
+    if (rank == 0) {
+        rank = 1;
+    }
+    for (int i = 0; i < RIL_HISTOGRAM_BUCKETS; i++) {
+        seen += h->buckets[i];
+        if (seen >= rank) {
+            return ril_histogram_bucket_floor(i);
+        }
+    }
+    return h->max;
+}
+
+#endif /* RIL_HISTOGRAM_H */
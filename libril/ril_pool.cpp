@@ -0,0 +1,247 @@
+/* //device/libs/telephony/ril_pool.cpp
+**
+** Copyright 2008, The Android Open Source Project
+**
+** Licensed under the Apache License, Version 2.0 (the "License");
+** you may not use this file except in compliance with the License.
+** You may obtain a copy of the License at
+**
+**     http://www.apache.org/licenses/LICENSE-2.0
+**
+** Unless required by applicable law or agreed to in writing, software
+** distributed under the License is distributed on an "AS IS" BASIS,
+** WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+** See the License for the specific language governing permissions and
+** limitations under the License.
+*/
+
+#define LOG_TAG "RILC"
+
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include <utils/Log.h>
+#include <ril_pool.h>
+
+// Pools that get per-thread caches; any further pool goes straight to
+// its shared free list
+#define POOL_MAX 8
+
+// Objects a thread may hold on to per pool, and how many move between
+// the thread and the pool at a time
+#define CACHE_MAX 32
+#define CACHE_BATCH 16
+
+// Objects carved out per slab
+#define SLAB_OBJECTS 32
+
+// A free object holds the link to the next one in its first word
+#define NEXT(obj) (*(void **)(obj))
+
+struct thread_cache {
+    void *head;
+    int count;
+};
+
+struct thread_caches {
+    struct thread_cache pools[POOL_MAX];
+};
+
+static pthread_mutex_t s_registryMutex = PTHREAD_MUTEX_INITIALIZER;
+static struct ril_pool *s_pools[POOL_MAX];
+static int s_poolCount = 0;
+
+static pthread_once_t s_cacheKeyOnce = PTHREAD_ONCE_INIT;
+static pthread_key_t s_cacheKey;
+static bool s_haveCacheKey = false;
+
+static size_t objectStride(struct ril_pool * pool)
+{
+    size_t size = pool->size < sizeof(void *) ? sizeof(void *) : pool->size;
+
+    return (size + 7) & ~(size_t) 7;
+}
+
+// Called with pool->mutex held
+static bool growLocked(struct ril_pool * pool)
+{
+    size_t stride = objectStride(pool);
+    char *slab = (char *) malloc(stride * SLAB_OBJECTS);
+
+    if (slab == NULL) {
+        ALOGE("pool %s: out of memory", pool->name);
+        return false;
+    }
+    for (int i = SLAB_OBJECTS - 1; i >= 0; i--) {
+        void *obj = slab + i * stride;
+        NEXT(obj) = pool->free_list;
+        pool->free_list = obj;
+    }
+    pool->capacity += SLAB_OBJECTS;
+    return true;
+}
+
+// Hand up to count objects from a thread cache back to the pool
+static void spill(struct ril_pool * pool, struct thread_cache * cache, int count)
+{
+    pthread_mutex_lock(&pool->mutex);
+    while (count-- > 0 && cache->head != NULL) {
+        void *obj = cache->head;
+        cache->head = NEXT(obj);
+        cache->count--;
+        NEXT(obj) = pool->free_list;
+        pool->free_list = obj;
+    }
+    pthread_mutex_unlock(&pool->mutex);
+}
+
+static void threadExit(void * param)
+{
+    struct thread_caches *caches = (struct thread_caches *) param;
+
+    for (int i = 0; i < POOL_MAX; i++) {
+        if (caches->pools[i].count > 0) {
+            spill(s_pools[i], &caches->pools[i], caches->pools[i].count);
+        }
+    }
+    free(caches);
+}
+
+static void createCacheKey()
+{
+    s_haveCacheKey = (pthread_key_create(&s_cacheKey, threadExit) == 0);
+    if (!s_haveCacheKey) {
+        ALOGW("pools will run without thread caches");
+    }
+}
+
+static void registerPool(struct ril_pool * pool)
+{
+    pthread_once(&s_cacheKeyOnce, createCacheKey);
+
+    pthread_mutex_lock(&s_registryMutex);
+    if (pool->id < 0) {
+        int id = POOL_MAX;
+
+        if (s_poolCount < POOL_MAX) {
+            id = s_poolCount++;
+            s_pools[id] = pool;
+        }
+        __sync_synchronize();
+        pool->id = id;
+    }
+    pthread_mutex_unlock(&s_registryMutex);
+}
+
+// The calling thread's cache for pool, or NULL if it has none
+static struct thread_cache * getCache(struct ril_pool * pool)
+{
+    struct thread_caches *caches;
+
+    if (pool->id < 0) {
+        registerPool(pool);
+    }
+    if (pool->id >= POOL_MAX || !s_haveCacheKey) {
+        return NULL;
+    }
+
+    caches = (struct thread_caches *) pthread_getspecific(s_cacheKey);
+    if (caches == NULL) {
+        caches = (struct thread_caches *) calloc(1, sizeof(struct thread_caches));
+        if (caches == NULL) {
+            return NULL;
+        }
+        if (pthread_setspecific(s_cacheKey, caches) != 0) {
+            free(caches);
+            return NULL;
+        }
+    }
+    return &caches->pools[pool->id];
+}
+
+void * ril_pool_alloc(struct ril_pool * pool)
+{
+    struct thread_cache *cache = getCache(pool);
+    void *obj;
+
+    if (cache != NULL) {
+        if (cache->head == NULL) {
+            pthread_mutex_lock(&pool->mutex);
+            if (pool->free_list != NULL || growLocked(pool)) {
+                while (cache->count < CACHE_BATCH && pool->free_list != NULL) {
+                    obj = pool->free_list;
+                    pool->free_list = NEXT(obj);
+                    NEXT(obj) = cache->head;
+                    cache->head = obj;
+                    cache->count++;
+                }
+            }
+            pthread_mutex_unlock(&pool->mutex);
+            if (cache->head == NULL) {
+                return NULL;
+            }
+        }
+        obj = cache->head;
+        cache->head = NEXT(obj);
+        cache->count--;
+    } else {
+        pthread_mutex_lock(&pool->mutex);
+        if (pool->free_list == NULL && !growLocked(pool)) {
+            pthread_mutex_unlock(&pool->mutex);
+            return NULL;
+        }
+        obj = pool->free_list;
+        pool->free_list = NEXT(obj);
+        pthread_mutex_unlock(&pool->mutex);
+    }
+
+    uint32_t in_use = __sync_add_and_fetch(&pool->in_use, 1);
+    uint32_t high_water = pool->high_water;
+    while (in_use > high_water) {
+        uint32_t seen = __sync_val_compare_and_swap(&pool->high_water, high_water, in_use);
+        if (seen == high_water) {
+            break;
+        }
+        high_water = seen;
+    }
+
+    memset(obj, 0, pool->size);
+    return obj;
+}
+
+void ril_pool_free(struct ril_pool * pool, void * obj)
+{
+    struct thread_cache *cache;
+
+    if (obj == NULL) {
+        return;
+    }
+
+    __sync_sub_and_fetch(&pool->in_use, 1);
+
+    cache = getCache(pool);
+    if (cache != NULL) {
+        NEXT(obj) = cache->head;
+        cache->head = obj;
+        if (++cache->count > CACHE_MAX) {
+            spill(pool, cache, CACHE_BATCH);
+        }
+    } else {
+        pthread_mutex_lock(&pool->mutex);
+        NEXT(obj) = pool->free_list;
+        pool->free_list = obj;
+        pthread_mutex_unlock(&pool->mutex);
+    }
+}
+
+void ril_pool_dump_stats(struct ril_pool * pool)
+{
+    uint32_t capacity;
+
+    pthread_mutex_lock(&pool->mutex);
+    capacity = pool->capacity;
+    pthread_mutex_unlock(&pool->mutex);
+
+    ALOGI("pool %s: %u in use, high water %u, %u allocated",
+            pool->name, pool->in_use, pool->high_water, capacity);
+}
@@ -0,0 +1,59 @@
+/* //device/libs/telephony/ril_pool.h
+**
+** Copyright 2008, The Android Open Source Project
+**
+** Licensed under the Apache License, Version 2.0 (the "License");
+** you may not use this file except in compliance with the License.
+** You may obtain a copy of the License at
+**
+**     http://www.apache.org/licenses/LICENSE-2.0
+**
+** Unless required by applicable law or agreed to in writing, software
+** distributed under the License is distributed on an "AS IS" BASIS,
+** WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+** See the License for the specific language governing permissions and
+** limitations under the License.
+*/
+
+#ifndef RIL_POOL_H
+#define RIL_POOL_H
+
+#include <pthread.h>
+#include <stdint.h>
+#include <stddef.h>
+
+// Fixed-size object pool. Objects are carved out of slabs obtained from
+// malloc and are never given back to it, so once the pool has grown to
+// the peak number of live objects, allocating and freeing stay off the
+// general allocator.
+//
+// Each thread keeps a small cache of free objects and only takes the
+// pool lock to refill or spill that cache in batches. Objects may be
+// freed on a different thread than the one that allocated them.
+//
+// Pools are meant to be static and are set up with RIL_POOL_INITIALIZER,
+// so they can be used before any init function has run.
+struct ril_pool {
+    size_t size;                // object size
+    const char *name;
+    pthread_mutex_t mutex;
+    volatile int id;            // slot in the per-thread caches, -1 until first use
+    void *free_list;            // guarded by mutex
+    uint32_t capacity;          // objects carved out so far, guarded by mutex
+    volatile uint32_t in_use;
+    volatile uint32_t high_water;
+};
+
+#define RIL_POOL_INITIALIZER(type, name) \
+    { sizeof(type), name, PTHREAD_MUTEX_INITIALIZER, -1, NULL, 0, 0, 0 }
+
+// Returns a zeroed object, or NULL if out of memory
+void * ril_pool_alloc(struct ril_pool * pool);
+
+// Returns obj to the pool; NULL is ignored
+void ril_pool_free(struct ril_pool * pool, void * obj);
+
+// Log the pool occupancy and its high-water mark
+void ril_pool_dump_stats(struct ril_pool * pool);
+
+#endif /* RIL_POOL_H */
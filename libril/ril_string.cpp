@@ -0,0 +1,132 @@
+/* //device/libs/telephony/ril_string.cpp
+**
+** Copyright 2008, The Android Open Source Project
+**
+** Licensed under the Apache License, Version 2.0 (the "License");
+** you may not use this file except in compliance with the License.
+** You may obtain a copy of the License at
+**
+**     http://www.apache.org/licenses/LICENSE-2.0
+**
+** Unless required by applicable law or agreed to in writing, software
+** distributed under the License is distributed on an "AS IS" BASIS,
+** WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+** See the License for the specific language governing permissions and
+** limitations under the License.
+*/
+
+#include <ril_string.h>
+
+#if defined(__SSE2__)
+#define RIL_STRING_SSE2 1
+#include <emmintrin.h>
+#elif defined(__ARM_NEON__) || defined(__ARM_NEON)
+#define RIL_STRING_NEON 1
+#include <arm_neon.h>
+#endif
+
+#ifdef RIL_STRING_NEON
+// True if any lane has one of the bits in mask set
+static inline bool anyBits(uint8x16_t v, uint8x16_t mask)
+{
+    uint64x2_t m = vreinterpretq_u64_u8(vandq_u8(v, mask));
+
+    return (vgetq_lane_u64(m, 0) | vgetq_lane_u64(m, 1)) != 0;
+}
+#endif
+
+bool ril_is_ascii(const char * s, size_t len)
+{
+    const uint8_t * p = (const uint8_t *) s;
+    size_t i = 0;
+
+#if defined(RIL_STRING_SSE2)
+    for (; i + 16 <= len; i += 16) {
+        __m128i v = _mm_loadu_si128((const __m128i *) (p + i));
+        if (_mm_movemask_epi8(v) != 0) {
+            return false;
+        }
+    }
+#elif defined(RIL_STRING_NEON)
+    const uint8x16_t high = vdupq_n_u8(0x80);
+
+    for (; i + 16 <= len; i += 16) {
+        if (anyBits(vld1q_u8(p + i), high)) {
+            return false;
+        }
+    }
+#endif
+
+    for (; i < len; i++) {
+        if (p[i] & 0x80) {
+            return false;
+        }
+    }
+    return true;
+}
+
+void ril_ascii_widen(uint16_t * dst, const char * src, size_t len)
+{
+    const uint8_t * p = (const uint8_t *) src;
+    size_t i = 0;
+
+#if defined(RIL_STRING_SSE2)
+    const __m128i zero = _mm_setzero_si128();
+
+    for (; i + 16 <= len; i += 16) {
+        __m128i v = _mm_loadu_si128((const __m128i *) (p + i));
+        _mm_storeu_si128((__m128i *) (dst + i), _mm_unpacklo_epi8(v, zero));
+        _mm_storeu_si128((__m128i *) (dst + i + 8), _mm_unpackhi_epi8(v, zero));
+    }
+#elif defined(RIL_STRING_NEON)
+    for (; i + 16 <= len; i += 16) {
+        uint8x16_t v = vld1q_u8(p + i);
+        vst1q_u16(dst + i, vmovl_u8(vget_low_u8(v)));
+        vst1q_u16(dst + i + 8, vmovl_u8(vget_high_u8(v)));
+    }
+#endif
+
+    for (; i < len; i++) {
+        dst[i] = p[i];
+    }
+}
+
+bool ril_ascii_narrow(char * dst, const uint16_t * src, size_t len)
+{
+    uint8_t * d = (uint8_t *) dst;
+    size_t i = 0;
+
+#if defined(RIL_STRING_SSE2)
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i high = _mm_set1_epi16((short) 0xff80);
+
+    for (; i + 16 <= len; i += 16) {
+        __m128i a = _mm_loadu_si128((const __m128i *) (src + i));
+        __m128i b = _mm_loadu_si128((const __m128i *) (src + i + 8));
+        __m128i bits = _mm_and_si128(_mm_or_si128(a, b), high);
+        if (_mm_movemask_epi8(_mm_cmpeq_epi16(bits, zero)) != 0xffff) {
+            return false;
+        }
+        _mm_storeu_si128((__m128i *) (d + i), _mm_packus_epi16(a, b));
+    }
+#elif defined(RIL_STRING_NEON)
+    const uint16x8_t high = vdupq_n_u16(0xff80);
+
+    for (; i + 16 <= len; i += 16) {
+        uint16x8_t a = vld1q_u16(src + i);
+        uint16x8_t b = vld1q_u16(src + i + 8);
+        if (anyBits(vreinterpretq_u8_u16(vorrq_u16(a, b)), vreinterpretq_u8_u16(high))) {
+            return false;
+        }
+        vst1q_u8(d + i, vcombine_u8(vmovn_u16(a), vmovn_u16(b)));
+    }
+#endif
+
+    for (; i < len; i++) {
+        if (src[i] >= 0x80) {
+            return false;
+        }
+        d[i] = (uint8_t) src[i];
+    }
+    return true;
+}
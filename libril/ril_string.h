@@ -0,0 +1,39 @@
+/* //device/libs/telephony/ril_string.h
+**
+** Copyright 2008, The Android Open Source Project
+**
+** Licensed under the Apache License, Version 2.0 (the "License");
+** you may not use this file except in compliance with the License.
+** You may obtain a copy of the License at
+**
+**     http://www.apache.org/licenses/LICENSE-2.0
+**
+** Unless required by applicable law or agreed to in writing, software
+** distributed under the License is distributed on an "AS IS" BASIS,
+** WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+** See the License for the specific language governing permissions and
+** limitations under the License.
+*/
+
+#ifndef RIL_STRING_H
+#define RIL_STRING_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// ASCII fast paths for moving strings between UTF-8 and the UTF-16
+// used by Parcel. Most RIL strings (numbers, operator names, hex PDUs)
+// are plain ASCII, for which conversion is a plain widen or narrow.
+// Uses SSE2 or NEON when the target has it.
+
+// True if the first len bytes of s are all ASCII
+bool ril_is_ascii(const char * s, size_t len);
+
+// Widen len ASCII bytes to UTF-16; src must pass ril_is_ascii
+void ril_ascii_widen(uint16_t * dst, const char * src, size_t len);
+
+// Narrow len UTF-16 units to ASCII. Returns false, with dst partly
+// written, if any unit is not ASCII.
+bool ril_ascii_narrow(char * dst, const uint16_t * src, size_t len);
+
+#endif /* RIL_STRING_H */
@@ -0,0 +1,307 @@
+/* //device/libs/telephony/ril_trace.cpp
+**
+** Copyright 2008, The Android Open Source Project
+**
+** Licensed under the Apache License, Version 2.0 (the "License");
+** you may not use this file except in compliance with the License.
+** You may obtain a copy of the License at
+**
+**     http://www.apache.org/licenses/LICENSE-2.0
+**
+** Unless required by applicable law or agreed to in writing, software
+** distributed under the License is distributed on an "AS IS" BASIS,
+** WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+** See the License for the specific language governing permissions and
+** limitations under the License.
+*/
+
+#define LOG_TAG "RILC"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <utils/Log.h>
+#include <telephony/ril.h>
+#include <telephony/ril_trace.h>
+
+// Records per thread; a power of two
+#define TRACE_RECORDS 512
+
+extern "C" const char * requestToString(int request);
+extern "C" const char * failCauseToString(RIL_Errno);
+
+struct TraceRecord {
+    int64_t timestamp_ns;       // CLOCK_MONOTONIC
+    // Written 0 before the rest of the record and the record's sequence
+    // number after it, so a reader can tell a record it copied whole
+    // from one that was rewritten under it
+    volatile uint32_t seq;
+    uint16_t event;
+    uint16_t length;            // of the string as given, clamped to 0xffff
+    pid_t tid;                  // a ring outlives its thread
+    union {
+        int32_t args[3];
+        char string[RIL_TRACE_STRING_MAX];
+    } u;
+};
+
+struct TraceRing {
+    TraceRing *next;            // never unlinked
+    volatile int inUse;         // owned by a live thread
+    pid_t tid;                  // of the thread that owns it
+    uint32_t count;             // records ever written; only the owner writes
+    TraceRecord records[TRACE_RECORDS];
+};
+
+static TraceRing * volatile s_rings = NULL;
+
+static pthread_once_t s_ringKeyOnce = PTHREAD_ONCE_INIT;
+static pthread_key_t s_ringKey;
+static bool s_haveRingKey = false;
+
+static void threadExit(void * param)
+{
+    TraceRing *ring = (TraceRing *) param;
+
+    // Its events stay for dumping until another thread takes it over
+    __sync_synchronize();
+    ring->inUse = 0;
+}
+
+static void createRingKey()
+{
+    s_haveRingKey = (pthread_key_create(&s_ringKey, threadExit) == 0);
+    if (!s_haveRingKey) {
+        ALOGW("trace: not recording, no thread key");
+    }
+}
+
+// The calling thread's ring, taking over one from an exited thread if
+// there is one; NULL if the thread can't have one
+static TraceRing * getRing()
+{
+    TraceRing *ring;
+
+    pthread_once(&s_ringKeyOnce, createRingKey);
+    if (!s_haveRingKey) {
+        return NULL;
+    }
+
+    ring = (TraceRing *) pthread_getspecific(s_ringKey);
+    if (ring != NULL) {
+        return ring;
+    }
+
+    for (ring = s_rings; ring != NULL; ring = ring->next) {
+        if (__sync_bool_compare_and_swap(&ring->inUse, 0, 1)) {
+            break;
+        }
+    }
+
+    if (ring == NULL) {
+        ring = (TraceRing *) calloc(1, sizeof(TraceRing));
+        if (ring == NULL) {
+            return NULL;
+        }
+        ring->inUse = 1;
+        do {
+            ring->next = s_rings;
+        } while (!__sync_bool_compare_and_swap(&s_rings, ring->next, ring));
+    }
+
+    ring->tid = gettid();
+    if (pthread_setspecific(s_ringKey, ring) != 0) {
+        ring->inUse = 0;
+        return NULL;
+    }
+    return ring;
+}
+
+// Claim the next record of the calling thread's ring and mark it
+// invalid until finishRecord()
+static TraceRecord * startRecord(RIL_TraceEvent event, TraceRing ** pRing)
+{
+    TraceRing *ring = getRing();
+    TraceRecord *record;
+    struct timespec ts;
+
+    if (ring == NULL) {
+        return NULL;
+    }
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    record = &ring->records[ring->count & (TRACE_RECORDS - 1)];
+    record->seq = 0;
+    __sync_synchronize();
+
+    record->event = event;
+    record->tid = ring->tid;
+    record->timestamp_ns = (int64_t) ts.tv_sec * 1000000000LL + ts.tv_nsec;
+    *pRing = ring;
+    return record;
+}
+
+static void finishRecord(TraceRing * ring, TraceRecord * record)
+{
+    __sync_synchronize();
+    // Sequence numbers start at 1, leaving 0 to mean invalid
+    record->seq = ++ring->count;
+}
+
+extern "C" void
+RIL_trace(RIL_TraceEvent event, int32_t a, int32_t b, int32_t c)
+{
+    TraceRing *ring;
+    TraceRecord *record = startRecord(event, &ring);
+
+    if (record == NULL) {
+        return;
+    }
+    record->length = 0;
+    record->u.args[0] = a;
+    record->u.args[1] = b;
+    record->u.args[2] = c;
+    finishRecord(ring, record);
+}
+
+extern "C" void
+RIL_traceString(RIL_TraceEvent event, const char *s)
+{
+    TraceRing *ring;
+    TraceRecord *record = startRecord(event, &ring);
+    size_t length;
+
+    if (record == NULL) {
+        return;
+    }
+    length = strlen(s);
+    record->length = (length > 0xffff) ? 0xffff : length;
+    memcpy(record->u.string, s,
+            (length > RIL_TRACE_STRING_MAX) ? RIL_TRACE_STRING_MAX : length);
+    finishRecord(ring, record);
+}
+
+// Copy out the intact records of ring, returning how many there were
+static int collectRing(TraceRing * ring, TraceRecord * out)
+{
+    int n = 0;
+
+    for (int i = 0; i < TRACE_RECORDS; i++) {
+        TraceRecord *record = &ring->records[i];
+        uint32_t seq = record->seq;
+
+        if (seq == 0) {
+            continue;
+        }
+        __sync_synchronize();
+        memcpy(&out[n], record, sizeof(*record));
+        __sync_synchronize();
+        if (record->seq != seq) {
+            continue;
+        }
+        out[n].seq = seq;
+        n++;
+    }
+    return n;
+}
+
+static int compareRecords(const void * a, const void * b)
+{
+    int64_t ta = ((const TraceRecord *) a)->timestamp_ns;
+    int64_t tb = ((const TraceRecord *) b)->timestamp_ns;
+
+    return (ta < tb) ? -1 : (ta > tb) ? 1 : 0;
+}
+
+static void printRecord(const TraceRecord * record, int64_t start_ns)
+{
+    const int32_t *args = record->u.args;
+    int64_t ns = record->timestamp_ns - start_ns;
+    int stringLength = (record->length > RIL_TRACE_STRING_MAX)
+            ? RIL_TRACE_STRING_MAX : record->length;
+    const char *more = (record->length > RIL_TRACE_STRING_MAX) ? "..." : "";
+    char prefix[32];
+
+    snprintf(prefix, sizeof(prefix), "%4lld.%06lld %5d",
+            (long long) (ns / 1000000000LL), (long long) (ns % 1000000000LL / 1000),
+            (int) record->tid);
+
+    switch (record->event) {
+        case RIL_TRACE_REQUEST:
+            ALOGI("%s [%04d]> %s", prefix, args[0], requestToString(args[1]));
+            break;
+        case RIL_TRACE_RESPONSE:
+            ALOGI("%s [%04d]< %s%s%s", prefix, args[0], requestToString(args[1]),
+                    args[2] != RIL_E_SUCCESS ? " fails by " : "",
+                    args[2] != RIL_E_SUCCESS ? failCauseToString((RIL_Errno) args[2]) : "");
+            break;
+        case RIL_TRACE_UNSOL:
+            ALOGI("%s [UNSL]< %s", prefix, requestToString(args[0]));
+            break;
+        case RIL_TRACE_LOCAL_REQUEST:
+            ALOGI("%s C[locl]> %s", prefix, requestToString(args[0]));
+            break;
+        case RIL_TRACE_LOCAL_RESPONSE:
+            ALOGI("%s C[locl]< %s%s%s", prefix, requestToString(args[0]),
+                    args[1] != RIL_E_SUCCESS ? " fails by " : "",
+                    args[1] != RIL_E_SUCCESS ? failCauseToString((RIL_Errno) args[1]) : "");
+            break;
+        case RIL_TRACE_VENDOR_REQUEST:
+            ALOGI("%s onRequest: %s", prefix, requestToString(args[0]));
+            break;
+        case RIL_TRACE_AT_SEND:
+            ALOGI("%s AT> %.*s%s", prefix, stringLength, record->u.string, more);
+            break;
+        case RIL_TRACE_AT_SEND_PDU:
+            ALOGI("%s AT> %.*s%s^Z", prefix, stringLength, record->u.string, more);
+            break;
+        case RIL_TRACE_AT_RECV:
+            ALOGI("%s AT< %.*s%s", prefix, stringLength, record->u.string, more);
+            break;
+        default:
+            ALOGI("%s event %d", prefix, record->event);
+            break;
+    }
+}
+
+extern "C" void
+RIL_traceDump(void)
+{
+    // Rings are only ever pushed on the front, so the list from here
+    // on stays as counted while threads come and go
+    TraceRing *head = s_rings;
+    TraceRecord *records;
+    int rings = 0;
+    int n = 0;
+
+    for (TraceRing *ring = head; ring != NULL; ring = ring->next) {
+        rings++;
+    }
+    if (rings == 0) {
+        ALOGI("trace: nothing recorded");
+        return;
+    }
+
+    records = (TraceRecord *) malloc(rings * TRACE_RECORDS * sizeof(TraceRecord));
+    if (records == NULL) {
+        ALOGE("trace: out of memory for dump");
+        return;
+    }
+
+    for (TraceRing *ring = head; ring != NULL; ring = ring->next) {
+        n += collectRing(ring, records + n);
+    }
+
+    qsort(records, n, sizeof(TraceRecord), compareRecords);
+
+    ALOGI("trace: %d events from %d threads", n, rings);
+    for (int i = 0; i < n; i++) {
+        printRecord(&records[i], records[0].timestamp_ns);
+    }
+
+    free(records);
+}
@@ -14,39 +14,47 @@
 ** See the License for the specific language governing permissions and
 ** limitations under the License.
 */
-    {RIL_UNSOL_RESPONSE_RADIO_STATE_CHANGED, responseVoid, WAKE_PARTIAL},
-    {RIL_UNSOL_RESPONSE_CALL_STATE_CHANGED, responseVoid, WAKE_PARTIAL},
-    {RIL_UNSOL_RESPONSE_VOICE_NETWORK_STATE_CHANGED, responseVoid, WAKE_PARTIAL},
-    {RIL_UNSOL_RESPONSE_NEW_SMS, responseString, WAKE_PARTIAL},
-    {RIL_UNSOL_RESPONSE_NEW_SMS_STATUS_REPORT, responseString, WAKE_PARTIAL},
-    {RIL_UNSOL_RESPONSE_NEW_SMS_ON_SIM, responseInts, WAKE_PARTIAL},
-    {RIL_UNSOL_ON_USSD, responseStrings, WAKE_PARTIAL},
-    {RIL_UNSOL_ON_USSD_REQUEST, responseVoid, DONT_WAKE},
-    {RIL_UNSOL_NITZ_TIME_RECEIVED, responseString, WAKE_PARTIAL},
-    {RIL_UNSOL_SIGNAL_STRENGTH, responseRilSignalStrength, DONT_WAKE},
-    {RIL_UNSOL_DATA_CALL_LIST_CHANGED, responseDataCallList, WAKE_PARTIAL},
-    {RIL_UNSOL_SUPP_SVC_NOTIFICATION, responseSsn, WAKE_PARTIAL},
-    {RIL_UNSOL_STK_SESSION_END, responseVoid, WAKE_PARTIAL},
-    {RIL_UNSOL_STK_PROACTIVE_COMMAND, responseString, WAKE_PARTIAL},
-    {RIL_UNSOL_STK_EVENT_NOTIFY, responseString, WAKE_PARTIAL},
-    {RIL_UNSOL_STK_CALL_SETUP, responseInts, WAKE_PARTIAL},
-    {RIL_UNSOL_SIM_SMS_STORAGE_FULL, responseVoid, WAKE_PARTIAL},
-    {RIL_UNSOL_SIM_REFRESH, responseSimRefresh, WAKE_PARTIAL},
-    {RIL_UNSOL_CALL_RING, responseCallRing, WAKE_PARTIAL},
-    {RIL_UNSOL_RESPONSE_SIM_STATUS_CHANGED, responseVoid, WAKE_PARTIAL},
-    {RIL_UNSOL_RESPONSE_CDMA_NEW_SMS, responseCdmaSms, WAKE_PARTIAL},
-    {RIL_UNSOL_RESPONSE_NEW_BROADCAST_SMS, responseRaw, WAKE_PARTIAL},
-    {RIL_UNSOL_CDMA_RUIM_SMS_STORAGE_FULL, responseVoid, WAKE_PARTIAL},
-    {RIL_UNSOL_RESTRICTED_STATE_CHANGED, responseInts, WAKE_PARTIAL},
-    {RIL_UNSOL_ENTER_EMERGENCY_CALLBACK_MODE, responseVoid, WAKE_PARTIAL},
-    {RIL_UNSOL_CDMA_CALL_WAITING, responseCdmaCallWaiting, WAKE_PARTIAL},
-    {RIL_UNSOL_CDMA_OTA_PROVISION_STATUS, responseInts, WAKE_PARTIAL},
-    {RIL_UNSOL_CDMA_INFO_REC, responseCdmaInformationRecords, WAKE_PARTIAL},
-    {RIL_UNSOL_OEM_HOOK_RAW, responseRaw, WAKE_PARTIAL},
-    {RIL_UNSOL_RINGBACK_TONE, responseInts, WAKE_PARTIAL},
-    {RIL_UNSOL_RESEND_INCALL_MUTE, responseVoid, WAKE_PARTIAL},
-    {RIL_UNSOL_CDMA_SUBSCRIPTION_SOURCE_CHANGED, responseInts, WAKE_PARTIAL},
-    {RIL_UNSOL_CDMA_PRL_CHANGED, responseInts, WAKE_PARTIAL},
-    {RIL_UNSOL_EXIT_EMERGENCY_CALLBACK_MODE, responseVoid, WAKE_PARTIAL},
-    {RIL_UNSOL_RIL_CONNECTED, responseInts, WAKE_PARTIAL},
-    {RIL_UNSOL_VOICE_RADIO_TECH_CHANGED, responseInts, WAKE_PARTIAL},
+/*
+ * One line per unsolicited response, in order from RIL_UNSOL_RESPONSE_BASE:
+ *   RIL_UNSOL_ENTRY(name, response function, wake type, outbound policy,
+ *           coalesce policy)
+ * where name is the RIL_UNSOL_ constant without its prefix. Define the
+ * macro before including this file; ril.cpp checks at compile time that
+ * every line sits at its number.
+ */
+    RIL_UNSOL_ENTRY(RESPONSE_RADIO_STATE_CHANGED, responseVoid, WAKE_PARTIAL, OUTBOUND_REPLACE_LATEST, COALESCE_NONE)
+    RIL_UNSOL_ENTRY(RESPONSE_CALL_STATE_CHANGED, responseVoid, WAKE_PARTIAL, OUTBOUND_REPLACE_LATEST, COALESCE_COLLAPSE)
+    RIL_UNSOL_ENTRY(RESPONSE_VOICE_NETWORK_STATE_CHANGED, responseVoid, WAKE_PARTIAL, OUTBOUND_REPLACE_LATEST, COALESCE_COLLAPSE)
+    RIL_UNSOL_ENTRY(RESPONSE_NEW_SMS, responseString, WAKE_PARTIAL, OUTBOUND_DROP_OLDEST, COALESCE_NONE)
+    RIL_UNSOL_ENTRY(RESPONSE_NEW_SMS_STATUS_REPORT, responseString, WAKE_PARTIAL, OUTBOUND_DROP_OLDEST, COALESCE_NONE)
+    RIL_UNSOL_ENTRY(RESPONSE_NEW_SMS_ON_SIM, responseInts, WAKE_PARTIAL, OUTBOUND_DROP_OLDEST, COALESCE_NONE)
+    RIL_UNSOL_ENTRY(ON_USSD, responseStrings, WAKE_PARTIAL, OUTBOUND_DROP_OLDEST, COALESCE_NONE)
+    RIL_UNSOL_ENTRY(ON_USSD_REQUEST, responseVoid, DONT_WAKE, OUTBOUND_DROP_OLDEST, COALESCE_NONE)
+    RIL_UNSOL_ENTRY(NITZ_TIME_RECEIVED, responseString, WAKE_PARTIAL, OUTBOUND_REPLACE_LATEST, COALESCE_NONE)
+    RIL_UNSOL_ENTRY(SIGNAL_STRENGTH, responseRilSignalStrength, DONT_WAKE, OUTBOUND_REPLACE_LATEST, COALESCE_LATEST)
+    RIL_UNSOL_ENTRY(DATA_CALL_LIST_CHANGED, responseDataCallList, WAKE_PARTIAL, OUTBOUND_REPLACE_LATEST, COALESCE_NONE)
+    RIL_UNSOL_ENTRY(SUPP_SVC_NOTIFICATION, responseSsn, WAKE_PARTIAL, OUTBOUND_DROP_OLDEST, COALESCE_NONE)
+    RIL_UNSOL_ENTRY(STK_SESSION_END, responseVoid, WAKE_PARTIAL, OUTBOUND_DROP_OLDEST, COALESCE_NONE)
+    RIL_UNSOL_ENTRY(STK_PROACTIVE_COMMAND, responseString, WAKE_PARTIAL, OUTBOUND_DROP_OLDEST, COALESCE_NONE)
+    RIL_UNSOL_ENTRY(STK_EVENT_NOTIFY, responseString, WAKE_PARTIAL, OUTBOUND_DROP_OLDEST, COALESCE_NONE)
+    RIL_UNSOL_ENTRY(STK_CALL_SETUP, responseInts, WAKE_PARTIAL, OUTBOUND_DROP_OLDEST, COALESCE_NONE)
+    RIL_UNSOL_ENTRY(SIM_SMS_STORAGE_FULL, responseVoid, WAKE_PARTIAL, OUTBOUND_DROP_OLDEST, COALESCE_NONE)
+    RIL_UNSOL_ENTRY(SIM_REFRESH, responseSimRefresh, WAKE_PARTIAL, OUTBOUND_DROP_OLDEST, COALESCE_NONE)
+    RIL_UNSOL_ENTRY(CALL_RING, responseCallRing, WAKE_PARTIAL, OUTBOUND_DROP_OLDEST, COALESCE_NONE)
+    RIL_UNSOL_ENTRY(RESPONSE_SIM_STATUS_CHANGED, responseVoid, WAKE_PARTIAL, OUTBOUND_REPLACE_LATEST, COALESCE_NONE)
+    RIL_UNSOL_ENTRY(RESPONSE_CDMA_NEW_SMS, responseCdmaSms, WAKE_PARTIAL, OUTBOUND_DROP_OLDEST, COALESCE_NONE)
+    RIL_UNSOL_ENTRY(RESPONSE_NEW_BROADCAST_SMS, responseRaw, WAKE_PARTIAL, OUTBOUND_DROP_OLDEST, COALESCE_NONE)
+    RIL_UNSOL_ENTRY(CDMA_RUIM_SMS_STORAGE_FULL, responseVoid, WAKE_PARTIAL, OUTBOUND_DROP_OLDEST, COALESCE_NONE)
+    RIL_UNSOL_ENTRY(RESTRICTED_STATE_CHANGED, responseInts, WAKE_PARTIAL, OUTBOUND_REPLACE_LATEST, COALESCE_NONE)
+    RIL_UNSOL_ENTRY(ENTER_EMERGENCY_CALLBACK_MODE, responseVoid, WAKE_PARTIAL, OUTBOUND_DROP_OLDEST, COALESCE_NONE)
+    RIL_UNSOL_ENTRY(CDMA_CALL_WAITING, responseCdmaCallWaiting, WAKE_PARTIAL, OUTBOUND_DROP_OLDEST, COALESCE_NONE)
+    RIL_UNSOL_ENTRY(CDMA_OTA_PROVISION_STATUS, responseInts, WAKE_PARTIAL, OUTBOUND_DROP_OLDEST, COALESCE_NONE)
+    RIL_UNSOL_ENTRY(CDMA_INFO_REC, responseCdmaInformationRecords, WAKE_PARTIAL, OUTBOUND_DROP_OLDEST, COALESCE_NONE)
+    RIL_UNSOL_ENTRY(OEM_HOOK_RAW, responseRaw, WAKE_PARTIAL, OUTBOUND_DROP_OLDEST, COALESCE_NONE)
+    RIL_UNSOL_ENTRY(RINGBACK_TONE, responseInts, WAKE_PARTIAL, OUTBOUND_DROP_OLDEST, COALESCE_NONE)
+    RIL_UNSOL_ENTRY(RESEND_INCALL_MUTE, responseVoid, WAKE_PARTIAL, OUTBOUND_REPLACE_LATEST, COALESCE_NONE)
+    RIL_UNSOL_ENTRY(CDMA_SUBSCRIPTION_SOURCE_CHANGED, responseInts, WAKE_PARTIAL, OUTBOUND_REPLACE_LATEST, COALESCE_NONE)
+    RIL_UNSOL_ENTRY(CDMA_PRL_CHANGED, responseInts, WAKE_PARTIAL, OUTBOUND_REPLACE_LATEST, COALESCE_NONE)
+    RIL_UNSOL_ENTRY(EXIT_EMERGENCY_CALLBACK_MODE, responseVoid, WAKE_PARTIAL, OUTBOUND_DROP_OLDEST, COALESCE_NONE)
+    RIL_UNSOL_ENTRY(RIL_CONNECTED, responseInts, WAKE_PARTIAL, OUTBOUND_DROP_OLDEST, COALESCE_NONE)
+    RIL_UNSOL_ENTRY(VOICE_RADIO_TECH_CHANGED, responseInts, WAKE_PARTIAL, OUTBOUND_REPLACE_LATEST, COALESCE_NONE)
@@ -0,0 +1,120 @@
+/* //device/libs/telephony/tools/ril_capture_dump.cpp
+**
+** Copyright 2008, The Android Open Source Project
+**
+** Licensed under the Apache License, Version 2.0 (the "License");
+** you may not use this file except in compliance with the License.
+** You may obtain a copy of the License at
+**
+**     http://www.apache.org/licenses/LICENSE-2.0
+**
+** Unless required by applicable law or agreed to in writing, software
+** distributed under the License is distributed on an "AS IS" BASIS,
+** WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+** See the License for the specific language governing permissions and
+** limitations under the License.
+*/
+
+// Host tool printing a command socket capture written by libril, oldest
+// frame first. Pull the file with
+//   adb pull /data/misc/radio/ril_capture
+// after setting persist.ril.capture_kb and restarting rild.
+//
+// usage: ril_capture_dump [-x] <capture file>
+//   -x  hex dump each frame's Parcel data as well
+
+#include <stdio.h>
+#include <unistd.h>
+#include "ril_capture_reader.h"
+
+// from ril.cpp
+#define RESPONSE_SOLICITED 0
+#define RESPONSE_UNSOLICITED 1
+
+static int32_t wordAt(const uint8_t *data, size_t length, int index)
+{
+    int32_t value = 0;
+
+    if ((index + 1) * sizeof(value) <= length) {
+        memcpy(&value, data + index * sizeof(value), sizeof(value));
+    }
+    return value;
+}
+
+static void printFrame(const struct ril_capture_frame *frame, const uint8_t *data,
+        int64_t start_ns, bool hex)
+{
+    int64_t ns = frame->timestamp_ns - start_ns;
+
+    printf("%5lld.%06lld %s client %u len %u ",
+            (long long) (ns / 1000000000LL), (long long) (ns % 1000000000LL / 1000),
+            (frame->direction == RIL_CAPTURE_IN) ? "<-" : "->",
+            frame->client, frame->length);
+
+    if (frame->direction == RIL_CAPTURE_IN) {
+        printf("request %d token %d\n", wordAt(data, frame->length, 0),
+                wordAt(data, frame->length, 1));
+    } else if (wordAt(data, frame->length, 0) == RESPONSE_SOLICITED) {
+        printf("response token %d error %d\n", wordAt(data, frame->length, 1),
+                wordAt(data, frame->length, 2));
+    } else {
+        printf("unsolicited %d\n", wordAt(data, frame->length, 1));
+    }
+
+    if (hex) {
+        for (uint32_t i = 0; i < frame->length; i++) {
+            printf("%s%02x", (i % 16 == 0) ? "    " : " ", data[i]);
+            if (i % 16 == 15 || i + 1 == frame->length) {
+                printf("\n");
+            }
+        }
+    }
+}
+
+int main(int argc, char **argv)
+{
+    struct ril_capture_reader reader;
+    struct ril_capture_frame frame;
+    uint8_t *data;
+    int64_t start_ns = -1;
+    bool hex = false;
+    int frames = 0;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "x")) != -1) {
+        if (opt == 'x') {
+            hex = true;
+        } else {
+            fprintf(stderr, "usage: %s [-x] <capture file>\n", argv[0]);
+            return 1;
+        }
+    }
+    if (optind + 1 != argc) {
+        fprintf(stderr, "usage: %s [-x] <capture file>\n", argv[0]);
+        return 1;
+    }
+
+    if (!ril_capture_reader_open(&reader, argv[optind])) {
+        return 1;
+    }
+    data = (uint8_t *) malloc(reader.header.ring_size / 2);
+    if (data == NULL) {
+        fprintf(stderr, "out of memory\n");
+        return 1;
+    }
+
+    while (ril_capture_reader_next(&reader, &frame, data)) {
+        if (start_ns < 0) {
+            start_ns = frame.timestamp_ns;
+        }
+        printFrame(&frame, data, start_ns, hex);
+        frames++;
+    }
+
+    fprintf(stderr, "%d frames%s\n", frames,
+            reader.header.filled ? ", older ones overwritten" : "");
+
+    ril_capture_reader_close(&reader);
+    free(data);
+    return 0;
+}
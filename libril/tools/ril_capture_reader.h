@@ -0,0 +1,127 @@
+/* //device/libs/telephony/tools/ril_capture_reader.h
+**
+** Copyright 2008, The Android Open Source Project
+**
+** Licensed under the Apache License, Version 2.0 (the "License");
+** you may not use this file except in compliance with the License.
+** You may obtain a copy of the License at
+**
+**     http://www.apache.org/licenses/LICENSE-2.0
+**
+** Unless required by applicable law or agreed to in writing, software
+** distributed under the License is distributed on an "AS IS" BASIS,
+** WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+** See the License for the specific language governing permissions and
+** limitations under the License.
+*/
+
+#ifndef RIL_CAPTURE_READER_H
+#define RIL_CAPTURE_READER_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ril_capture.h>
+
+// Reads back the frames of a capture file written by libril, oldest
+// first, for the host tools.
+
+struct ril_capture_reader {
+    struct ril_capture_header header;
+    uint8_t *ring;
+    uint32_t pos;
+};
+
+// Copy out of the ring at pos, wrapping around its end
+static inline void ril_capture_copy_out(const struct ril_capture_reader *reader,
+        void *data, uint32_t pos, size_t length)
+{
+    uint32_t offset = pos & (reader->header.ring_size - 1);
+    size_t first = reader->header.ring_size - offset;
+
+    if (first >= length) {
+        memcpy(data, reader->ring + offset, length);
+    } else {
+        memcpy(data, reader->ring + offset, first);
+        memcpy((uint8_t *) data + first, reader->ring, length - first);
+    }
+}
+
+// Load the file at path; prints why and returns false if it can't
+static inline bool ril_capture_reader_open(struct ril_capture_reader *reader,
+        const char *path)
+{
+    struct ril_capture_header *header = &reader->header;
+    FILE *fp;
+
+    reader->ring = NULL;
+
+    fp = fopen(path, "rb");
+    if (fp == NULL) {
+        perror(path);
+        return false;
+    }
+    if (fread(header, sizeof(*header), 1, fp) != 1
+            || header->magic != RIL_CAPTURE_MAGIC
+            || header->version != RIL_CAPTURE_VERSION
+            || header->ring_size < RIL_CAPTURE_MIN_RING
+            || header->ring_size > RIL_CAPTURE_MAX_RING
+            || (header->ring_size & (header->ring_size - 1)) != 0) {
+        fprintf(stderr, "%s: not a capture file\n", path);
+        fclose(fp);
+        return false;
+    }
+
+    reader->ring = (uint8_t *) malloc(header->ring_size);
+    if (reader->ring == NULL
+            || fseek(fp, RIL_CAPTURE_HEADER_SIZE, SEEK_SET) != 0
+            || fread(reader->ring, header->ring_size, 1, fp) != 1) {
+        fprintf(stderr, "%s: truncated\n", path);
+        free(reader->ring);
+        reader->ring = NULL;
+        fclose(fp);
+        return false;
+    }
+    fclose(fp);
+
+    // Once the ring has filled, everything before head - ring_size has
+    // been overwritten. head wraps after 4GB, so it can't tell by itself
+    reader->pos = header->filled ? header->head - header->ring_size : 0;
+    return true;
+}
+
+// Fetch the next intact frame and its Parcel data, which must have room
+// for half the ring. Returns false after the last frame.
+static inline bool ril_capture_reader_next(struct ril_capture_reader *reader,
+        struct ril_capture_frame *frame, uint8_t *data)
+{
+    uint32_t head = reader->header.head;
+
+    // The frame straddling the overwritten part is lost, as are any
+    // torn by a writer; search forward for one whose pos shows it is
+    // intact
+    while (head - reader->pos >= sizeof(*frame)) {
+        uint32_t total;
+
+        ril_capture_copy_out(reader, frame, reader->pos, sizeof(*frame));
+        total = RIL_CAPTURE_FRAME_SIZE(frame->length);
+        if (frame->pos != reader->pos || total > reader->header.ring_size / 2
+                || total > head - reader->pos) {
+            reader->pos += 8;
+            continue;
+        }
+
+        ril_capture_copy_out(reader, data, reader->pos + sizeof(*frame), frame->length);
+        reader->pos += total;
+        return true;
+    }
+    return false;
+}
+
+static inline void ril_capture_reader_close(struct ril_capture_reader *reader)
+{
+    free(reader->ring);
+    reader->ring = NULL;
+}
+
+#endif /* RIL_CAPTURE_READER_H */
@@ -0,0 +1,708 @@
+/* //device/libs/telephony/tools/ril_loadgen.cpp
+**
+** Copyright 2008, The Android Open Source Project
+**
+** Licensed under the Apache License, Version 2.0 (the "License");
+** you may not use this file except in compliance with the License.
+** You may obtain a copy of the License at
+**
+**     http://www.apache.org/licenses/LICENSE-2.0
+**
+** Unless required by applicable law or agreed to in writing, software
+** distributed under the License is distributed on an "AS IS" BASIS,
+** WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+** See the License for the specific language governing permissions and
+** limitations under the License.
+*/
+
+// Load generator for the rild command socket. Sends requests framed the
+// way RIL.java frames them, either a synthetic mix at a fixed rate or the
+// requests of a capture replayed with their original timing, and reports
+// throughput and per-request latency percentiles as one JSON object.
+//
+// Run rild against libstub-ril to measure libril rather than a modem:
+//   rild -l /system/lib/libstub-ril.so -- -d 2000
+// The tool must run as the radio user or one named in ro.ril.clients.
+// The host build reaches rild through adb forward (see Android.mk), which
+// connects as adbd's user, so that one must be named in ro.ril.clients.
+//
+// usage: ril_loadgen [-s <socket path>] [-n <count>] [-r <rate>] [-w <window>]
+//                    [-m <request>[:<weight>],...] [-R <capture> [-c <client>] [-x <speed>]]
+//   -s  connect to this filesystem socket instead of /dev/socket/rild
+//   -n  requests to send (default 10000; all of them when replaying)
+//   -r  requests per second, 0 to send as fast as the window allows
+//   -w  most requests outstanding at once (default 16)
+//   -m  request numbers to send and their relative weights
+//   -R  replay the requests of this capture instead
+//   -c  only those a connection with this id made (default all)
+//   -x  replay this many times faster than captured (default 1)
+//
+// When a rate is set, latency is measured from when a request was due to
+// go out, so time spent waiting for the window counts against it.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <arpa/inet.h>
+#include <cutils/sockets.h>
+#include <telephony/ril.h>
+#include <telephony/ril_cdma_sms.h>
+#include <ril_histogram.h>
+#include "ril_capture_reader.h"
+
+#define NUM_ELEMS(a) ((int) (sizeof(a) / sizeof((a)[0])))
+
+#define SOCKET_NAME_RIL "rild"
+
+// from ril.cpp
+#define MAX_COMMAND_BYTES (8 * 1024)
+#define RESPONSE_SOLICITED 0
+
+#define DEFAULT_COUNT 10000
+#define DEFAULT_WINDOW 16
+#define MAX_WINDOW 1024
+
+// How long to wait for the last responses before counting them lost
+#define DRAIN_TIMEOUT_US 5000000LL
+
+// A request being built, in Parcel's wire layout: 32-bit words, strings
+// as a length followed by NUL-terminated UTF-16 padded to a word
+struct Wire {
+    uint8_t data[MAX_COMMAND_BYTES];
+    size_t size;
+};
+
+static void wireInt32(Wire *w, int32_t value)
+{
+    if (w->size + sizeof(value) <= sizeof(w->data)) {
+        memcpy(w->data + w->size, &value, sizeof(value));
+        w->size += sizeof(value);
+    }
+}
+
+static void wireString(Wire *w, const char *s)
+{
+    size_t len;
+    size_t padded;
+
+    if (s == NULL) {
+        wireInt32(w, -1);
+        return;
+    }
+    len = strlen(s);
+    padded = ((len + 1) * sizeof(uint16_t) + 3) & ~(size_t) 3;
+    wireInt32(w, len);
+    if (w->size + padded > sizeof(w->data)) {
+        return;
+    }
+    memset(w->data + w->size, 0, padded);
+    for (size_t i = 0; i < len; i++) {
+        uint16_t c = (uint8_t) s[i];
+        memcpy(w->data + w->size + i * sizeof(c), &c, sizeof(c));
+    }
+    w->size += padded;
+}
+
+static void wireInts(Wire *w, int count, int32_t value)
+{
+    for (int i = 0; i < count; i++) {
+        wireInt32(w, value);
+    }
+}
+
+// Plausible arguments for each of ril.cpp's dispatch functions, named
+// after them so ril_commands.h can fill in s_commands
+
+static void dispatchVoid(Wire *w)
+{
+}
+
+static void dispatchString(Wire *w)
+{
+    wireString(w, "0");
+}
+
+static void dispatchStrings(Wire *w)
+{
+    wireInt32(w, 1);
+    wireString(w, "0");
+}
+
+static void dispatchInts(Wire *w)
+{
+    wireInt32(w, 1);
+    wireInt32(w, 0);
+}
+
+static void dispatchDial(Wire *w)
+{
+    wireString(w, "5551234");
+    wireInt32(w, 0);        // clir
+    wireInt32(w, 0);        // no uusInfo
+}
+
+static void dispatchSIM_IO(Wire *w)
+{
+    wireInt32(w, 0xb0);     // READ BINARY
+    wireInt32(w, 0x6fad);
+    wireString(w, "3F007F20");
+    wireInt32(w, 0);
+    wireInt32(w, 0);
+    wireInt32(w, 4);
+    wireString(w, NULL);
+    wireString(w, NULL);
+    wireString(w, NULL);
+}
+
+static void dispatchCallForward(Wire *w)
+{
+    wireInts(w, 4, 0);      // status, reason, serviceClass, toa
+    wireString(w, "");
+    wireInt32(w, 0);        // timeSeconds
+}
+
+static void dispatchRaw(Wire *w)
+{
+    wireInt32(w, sizeof(int32_t));
+    wireInt32(w, 0);
+}
+
+static void dispatchSmsWrite(Wire *w)
+{
+    wireInt32(w, 0);        // status
+    wireString(w, "0001000A8155512340000004D4F29C0E");
+    wireString(w, NULL);    // smsc
+}
+
+static void dispatchDataCall(Wire *w)
+{
+    static const char *args[] = {"1", "0", "internet", NULL, NULL, "0", "IP"};
+
+    wireInt32(w, NUM_ELEMS(args));
+    for (int i = 0; i < NUM_ELEMS(args); i++) {
+        wireString(w, args[i]);
+    }
+}
+
+static void dispatchVoiceRadioTech(Wire *w)
+{
+}
+
+static void dispatchCdmaSubscriptionSource(Wire *w)
+{
+}
+
+// Parcel::read of a byte still takes a word
+static void dispatchCdmaSms(Wire *w)
+{
+    wireInts(w, 8, 0);      // teleservice to address digit count
+    wireInts(w, 3, 0);      // subaddress type, odd, digit count
+    wireInt32(w, 0);        // bearer data length
+}
+
+static void dispatchCdmaSmsAck(Wire *w)
+{
+    wireInts(w, 2, 0);
+}
+
+static void dispatchGsmBrSmsCnf(Wire *w)
+{
+    wireInt32(w, 1);
+    wireInts(w, 5, 0);
+}
+
+static void dispatchCdmaBrSmsCnf(Wire *w)
+{
+    wireInt32(w, 1);
+    wireInts(w, 3, 0);
+}
+
+static void dispatchRilCdmaSmsWriteArgs(Wire *w)
+{
+    wireInts(w, 9, 0);      // status, then teleservice to address digit count
+    wireInts(w, RIL_CDMA_SMS_ADDRESS_MAX, 0);
+    wireInts(w, 3, 0);
+    wireInts(w, RIL_CDMA_SMS_SUBADDRESS_MAX, 0);
+    wireInt32(w, 0);
+    wireInts(w, RIL_CDMA_SMS_BEARER_DATA_MAX, 0);
+}
+
+struct CommandInfo {
+    int requestNumber;
+    const char *name;
+    void (*encode)(Wire *w);
+};
+
+// Responses are only timed, not decoded
+static CommandInfo s_commands[] = {
+#define RIL_REQUEST_ENTRY(name, dispatch, response) {RIL_REQUEST_##name, #name, dispatch},
+#define RIL_REQUEST_UNUSED(number) {0, NULL, NULL},
+#include "../ril_commands.h"
+#undef RIL_REQUEST_ENTRY
+#undef RIL_REQUEST_UNUSED
+};
+
+// What the framework polls while idle on a network
+static const int s_defaultMix[] = {
+    RIL_REQUEST_SIGNAL_STRENGTH,
+    RIL_REQUEST_SIGNAL_STRENGTH,
+    RIL_REQUEST_VOICE_REGISTRATION_STATE,
+    RIL_REQUEST_DATA_REGISTRATION_STATE,
+    RIL_REQUEST_OPERATOR,
+    RIL_REQUEST_QUERY_NETWORK_SELECTION_MODE,
+    RIL_REQUEST_GET_CURRENT_CALLS,
+};
+
+struct RequestStats {
+    struct ril_histogram latency;
+    uint32_t errors;
+};
+
+struct Outstanding {
+    int32_t request;        // 0 if the slot is free
+    int64_t sentUs;
+};
+
+static int s_fd = -1;
+static int s_window = DEFAULT_WINDOW;
+
+static pthread_mutex_t s_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t s_cond = PTHREAD_COND_INITIALIZER;
+static Outstanding s_outstanding[MAX_WINDOW];
+static int s_inFlight;
+static int s_completed;
+static int s_unknown;
+static int64_t s_lastResponseUs;
+static bool s_closed;
+
+static RequestStats s_stats[NUM_ELEMS(s_commands)];
+static struct ril_histogram s_total;
+static uint32_t s_errors;
+
+static int64_t nowUs()
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t) ts.tv_sec * 1000000LL + ts.tv_nsec / 1000;
+}
+
+static void sleepUntil(int64_t us)
+{
+    int64_t delay = us - nowUs();
+
+    if (delay > 0) {
+        struct timespec ts;
+
+        ts.tv_sec = delay / 1000000;
+        ts.tv_nsec = (delay % 1000000) * 1000;
+        while (nanosleep(&ts, &ts) < 0 && errno == EINTR) {
+        }
+    }
+}
+
+static int connectSocket(const char *path)
+{
+    struct sockaddr_un addr;
+    int fd;
+
+    if (path == NULL) {
+        return socket_local_client(SOCKET_NAME_RIL, ANDROID_SOCKET_NAMESPACE_RESERVED,
+                SOCK_STREAM);
+    }
+
+    fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0) {
+        return -1;
+    }
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    strncpy(addr.sun_path, path, sizeof(addr.sun_path) - 1);
+    if (connect(fd, (struct sockaddr *) &addr, sizeof(addr)) < 0) {
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+static bool readFully(int fd, void *buffer, size_t length)
+{
+    uint8_t *p = (uint8_t *) buffer;
+
+    while (length > 0) {
+        ssize_t n = read(fd, p, length);
+
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n <= 0) {
+            return false;
+        }
+        p += n;
+        length -= n;
+    }
+    return true;
+}
+
+static bool writeFully(int fd, const void *buffer, size_t length)
+{
+    const uint8_t *p = (const uint8_t *) buffer;
+
+    while (length > 0) {
+        ssize_t n = write(fd, p, length);
+
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n <= 0) {
+            return false;
+        }
+        p += n;
+        length -= n;
+    }
+    return true;
+}
+
+// Reads responses and times the solicited ones
+static void *readerLoop(void *param)
+{
+    uint8_t buffer[MAX_COMMAND_BYTES];
+
+    for (;;) {
+        uint32_t header;
+        uint32_t length;
+        int32_t word[3];
+        int64_t now;
+
+        if (!readFully(s_fd, &header, sizeof(header))) {
+            break;
+        }
+        length = ntohl(header);
+        if (length > sizeof(buffer) || !readFully(s_fd, buffer, length)) {
+            break;
+        }
+        if (length < sizeof(word)) {
+            continue;
+        }
+        memcpy(word, buffer, sizeof(word));
+        if (word[0] != RESPONSE_SOLICITED) {
+            continue;
+        }
+
+        now = nowUs();
+        pthread_mutex_lock(&s_mutex);
+        Outstanding *o = &s_outstanding[(uint32_t) word[1] % MAX_WINDOW];
+        if (o->request == 0) {
+            s_unknown++;
+        } else {
+            uint32_t us = (uint32_t) (now - o->sentUs);
+
+            ril_histogram_record(&s_stats[o->request].latency, us);
+            ril_histogram_record(&s_total, us);
+            if (word[2] != RIL_E_SUCCESS) {
+                s_stats[o->request].errors++;
+                s_errors++;
+            }
+            o->request = 0;
+            s_inFlight--;
+            s_completed++;
+            s_lastResponseUs = now;
+        }
+        pthread_cond_broadcast(&s_cond);
+        pthread_mutex_unlock(&s_mutex);
+    }
+
+    pthread_mutex_lock(&s_mutex);
+    s_closed = true;
+    pthread_cond_broadcast(&s_cond);
+    pthread_mutex_unlock(&s_mutex);
+    return NULL;
+}
+
+/**
+ * Send one request once the window has room, rewriting its token.
+ * data holds the request number, token and arguments as a Parcel.
+ * Returns false once the connection is gone.
+ */
+static bool sendRequest(uint8_t *data, size_t length, int64_t dueUs)
+{
+    static uint32_t nextToken;
+    int32_t request;
+    uint32_t token;
+    uint32_t header = htonl(length);
+
+    // rild does not answer requests it doesn't know
+    memcpy(&request, data, sizeof(request));
+    if (request < 1 || request >= NUM_ELEMS(s_commands)
+            || s_commands[request].requestNumber == 0) {
+        return true;
+    }
+
+    pthread_mutex_lock(&s_mutex);
+    // tokens cycle through MAX_WINDOW slots; skip any still in use
+    while (!s_closed && (s_inFlight >= s_window
+            || s_outstanding[nextToken % MAX_WINDOW].request != 0)) {
+        if (s_inFlight < s_window) {
+            nextToken++;
+        } else {
+            pthread_cond_wait(&s_cond, &s_mutex);
+        }
+    }
+    if (s_closed) {
+        pthread_mutex_unlock(&s_mutex);
+        return false;
+    }
+    token = nextToken++;
+    s_outstanding[token % MAX_WINDOW].request = request;
+    s_outstanding[token % MAX_WINDOW].sentUs = (dueUs > 0) ? dueUs : nowUs();
+    s_inFlight++;
+    pthread_mutex_unlock(&s_mutex);
+
+    memcpy(data + sizeof(request), &token, sizeof(token));
+    return writeFully(s_fd, &header, sizeof(header)) && writeFully(s_fd, data, length);
+}
+
+static int parseMix(const char *mix, int *requests, int *weights, int max)
+{
+    int n = 0;
+
+    while (*mix != '\0' && n < max) {
+        char *end;
+
+        requests[n] = strtol(mix, &end, 10);
+        weights[n] = 1;
+        if (*end == ':') {
+            weights[n] = strtol(end + 1, &end, 10);
+        }
+        if (end == mix || (*end != ',' && *end != '\0')
+                || requests[n] < 1 || requests[n] >= NUM_ELEMS(s_commands)
+                || s_commands[requests[n]].encode == NULL || weights[n] < 1) {
+            return -1;
+        }
+        n++;
+        mix = (*end == ',') ? end + 1 : end;
+    }
+    return n;
+}
+
+static int sendSynthetic(int count, int rate, const int *requests, const int *weights, int n)
+{
+    Wire w;
+    int totalWeight = 0;
+    int64_t start = nowUs();
+    unsigned int seed = 1;
+    int sent;
+
+    for (int i = 0; i < n; i++) {
+        totalWeight += weights[i];
+    }
+
+    for (sent = 0; sent < count; sent++) {
+        int pick = rand_r(&seed) % totalWeight;
+        int64_t due = 0;
+        int i;
+
+        for (i = 0; pick >= weights[i]; i++) {
+            pick -= weights[i];
+        }
+
+        w.size = 0;
+        wireInt32(&w, requests[i]);
+        wireInt32(&w, 0);
+        s_commands[requests[i]].encode(&w);
+
+        if (rate > 0) {
+            due = start + (int64_t) sent * 1000000LL / rate;
+            sleepUntil(due);
+        }
+        if (!sendRequest(w.data, w.size, due)) {
+            break;
+        }
+    }
+    return sent;
+}
+
+static int sendReplay(const char *path, uint32_t client, double speed, int count)
+{
+    struct ril_capture_reader reader;
+    struct ril_capture_frame frame;
+    uint8_t *data;
+    int64_t firstNs = -1;
+    int64_t start = nowUs();
+    int sent = 0;
+
+    if (!ril_capture_reader_open(&reader, path)) {
+        return -1;
+    }
+    data = (uint8_t *) malloc(reader.header.ring_size / 2);
+    if (data == NULL) {
+        ril_capture_reader_close(&reader);
+        return -1;
+    }
+
+    while (sent < count && ril_capture_reader_next(&reader, &frame, data)) {
+        int64_t due;
+
+        if (frame.direction != RIL_CAPTURE_IN || frame.length < 2 * sizeof(int32_t)
+                || frame.length > MAX_COMMAND_BYTES
+                || (client != 0 && frame.client != client)) {
+            continue;
+        }
+        if (firstNs < 0) {
+            firstNs = frame.timestamp_ns;
+        }
+
+        due = start + (int64_t) ((frame.timestamp_ns - firstNs) / 1000 / speed);
+        sleepUntil(due);
+        if (!sendRequest(data, frame.length, due)) {
+            break;
+        }
+        sent++;
+    }
+
+    free(data);
+    ril_capture_reader_close(&reader);
+    return sent;
+}
+
+static void printLatency(const struct ril_histogram *h)
+{
+    printf("\"p50_us\": %u, \"p90_us\": %u, \"p99_us\": %u, \"max_us\": %u",
+            ril_histogram_percentile(h, 50), ril_histogram_percentile(h, 90),
+            ril_histogram_percentile(h, 99), h->max);
+}
+
+static void usage(const char *argv0)
+{
+    fprintf(stderr, "usage: %s [-s <socket path>] [-n <count>] [-r <rate>] [-w <window>]\n"
+            "        [-m <request>[:<weight>],...] [-R <capture> [-c <client>] [-x <speed>]]\n",
+            argv0);
+}
+
+int main(int argc, char **argv)
+{
+    const char *socketPath = NULL;
+    const char *replayPath = NULL;
+    int requests[NUM_ELEMS(s_commands)];
+    int weights[NUM_ELEMS(s_commands)];
+    int n = 0;
+    int count = -1;
+    int rate = 0;
+    uint32_t client = 0;
+    double speed = 1.0;
+    int sent;
+    int64_t start;
+    int64_t elapsed;
+    int64_t drainUs;
+    pthread_t reader;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "s:n:r:w:m:R:c:x:")) != -1) {
+        switch (opt) {
+            case 's': socketPath = optarg; break;
+            case 'n': count = atoi(optarg); break;
+            case 'r': rate = atoi(optarg); break;
+            case 'w': s_window = atoi(optarg); break;
+            case 'm':
+                n = parseMix(optarg, requests, weights, NUM_ELEMS(requests));
+                if (n <= 0) {
+                    fprintf(stderr, "bad request mix: %s\n", optarg);
+                    return 1;
+                }
+                break;
+            case 'R': replayPath = optarg; break;
+            case 'c': client = strtoul(optarg, NULL, 10); break;
+            case 'x': speed = atof(optarg); break;
+            default:
+                usage(argv[0]);
+                return 1;
+        }
+    }
+    if (optind != argc || rate < 0 || s_window < 1 || s_window > MAX_WINDOW || speed <= 0) {
+        usage(argv[0]);
+        return 1;
+    }
+    if (count < 0) {
+        count = (replayPath != NULL) ? 0x7fffffff : DEFAULT_COUNT;
+    }
+    if (n == 0) {
+        for (n = 0; n < NUM_ELEMS(s_defaultMix); n++) {
+            requests[n] = s_defaultMix[n];
+            weights[n] = 1;
+        }
+    }
+
+    s_fd = connectSocket(socketPath);
+    if (s_fd < 0) {
+        fprintf(stderr, "can't connect to %s: %s\n",
+                (socketPath != NULL) ? socketPath : SOCKET_NAME_RIL, strerror(errno));
+        return 1;
+    }
+    pthread_create(&reader, NULL, readerLoop, NULL);
+
+    start = nowUs();
+    if (replayPath != NULL) {
+        sent = sendReplay(replayPath, client, speed, count);
+        if (sent < 0) {
+            return 1;
+        }
+    } else {
+        sent = sendSynthetic(count, rate, requests, weights, n);
+    }
+
+    // give the last responses a while to arrive, then count them lost
+    pthread_mutex_lock(&s_mutex);
+    drainUs = nowUs() + DRAIN_TIMEOUT_US;
+    while (s_inFlight > 0 && !s_closed && nowUs() < drainUs) {
+        struct timespec ts;
+
+        clock_gettime(CLOCK_REALTIME, &ts);
+        ts.tv_nsec += 10000000;
+        if (ts.tv_nsec >= 1000000000) {
+            ts.tv_sec++;
+            ts.tv_nsec -= 1000000000;
+        }
+        pthread_cond_timedwait(&s_cond, &s_mutex, &ts);
+    }
+    // with no response at all, time the run up to giving up on them
+    elapsed = ((s_lastResponseUs != 0) ? s_lastResponseUs : nowUs()) - start;
+    pthread_mutex_unlock(&s_mutex);
+
+    shutdown(s_fd, SHUT_RDWR);
+    pthread_join(reader, NULL);
+    close(s_fd);
+
+    printf("{\n  \"tool\": \"ril_loadgen\",\n  \"mode\": \"%s\",\n",
+            (replayPath != NULL) ? "replay" : "synthetic");
+    printf("  \"window\": %d,\n  \"rate\": %d,\n", s_window, rate);
+    printf("  \"sent\": %d,\n  \"completed\": %d,\n  \"errors\": %u,\n"
+            "  \"lost\": %d,\n  \"unmatched\": %d,\n",
+            sent, s_completed, s_errors, s_inFlight, s_unknown);
+    printf("  \"elapsed_s\": %.3f,\n  \"throughput_rps\": %.1f,\n",
+            elapsed / 1e6, (elapsed > 0) ? s_completed * 1e6 / elapsed : 0.0);
+    printf("  \"latency\": {");
+    printLatency(&s_total);
+    printf("},\n  \"requests\": [");
+    n = 0;
+    for (int i = 1; i < NUM_ELEMS(s_commands); i++) {
+        const RequestStats *stats = &s_stats[i];
+
+        if (stats->latency.count == 0) {
+            continue;
+        }
+        printf("%s\n    {\"request\": %d, \"name\": \"%s\", \"count\": %u, \"errors\": %u, ",
+                (n++ > 0) ? "," : "", i, s_commands[i].name, stats->latency.count,
+                stats->errors);
+        printLatency(&stats->latency);
+        printf("}");
+    }
+    printf("\n  ]\n}\n");
+
+    return (s_completed > 0) ? 0 : 1;
+}
@@ -32,6 +32,7 @@
 #define LOG_NDEBUG 0
 #define LOG_TAG "AT"
 #include <utils/Log.h>
+#include <telephony/ril_trace.h>
 
 #ifdef HAVE_ANDROID_OS
 /* for IOCTL's */
@@ -418,7 +419,7 @@ static const char *readline()
     s_ATBufferCur = p_eol + 1; /* this will always be <= p_read,    */
                               /* and there will be a \0 at *p_read */
 
-    ALOGD("AT< %s\n", ret);
+    RIL_traceString(RIL_TRACE_AT_RECV, ret);
     return ret;
 }
 
@@ -504,7 +505,7 @@ static int writeline (const char *s)
         return AT_ERROR_CHANNEL_CLOSED;
     }
 
-    ALOGD("AT> %s\n", s);
+    RIL_traceString(RIL_TRACE_AT_SEND, s);
 
     AT_DUMP( ">> ", s, strlen(s) );
 
@@ -543,7 +544,7 @@ static int writeCtrlZ (const char *s)
         return AT_ERROR_CHANNEL_CLOSED;
     }
 
-    ALOGD("AT> %s^Z\n", s);
+    RIL_traceString(RIL_TRACE_AT_SEND_PDU, s);
 
     AT_DUMP( ">* ", s, strlen(s) );
 
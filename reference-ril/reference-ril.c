@@ -39,6 +39,7 @@
 #include <regex.h>
 
 #include "ril.h"
+#include <telephony/ril_trace.h>
 #include "hardware/qemu_pipe.h"
 
 #define LOG_TAG "RIL"
@@ -188,6 +189,8 @@ static const struct RIL_Env *s_rilenv;
 #define RIL_onRequestComplete(t, e, response, responselen) s_rilenv->OnRequestComplete(t,e, response, responselen)
 #define RIL_onUnsolicitedResponse(a,b,c) s_rilenv->OnUnsolicitedResponse(a,b,c)
 #define RIL_requestTimedCallback(a,b,c) s_rilenv->RequestTimedCallback(a,b,c)
+#define RIL_requestTimedCallbackEx(a,b,c) s_rilenv->RequestTimedCallbackEx(a,b,c)
+#define RIL_cancelTimedCallback(a) s_rilenv->CancelTimedCallback(a)
 #endif
 
 static RIL_RadioState sState = RADIO_STATE_UNAVAILABLE;
@@ -209,6 +212,10 @@ static char *sATBufferCur = NULL;
 
 static const struct timeval TIMEVAL_SIMPOLL = {1,0};
 static const struct timeval TIMEVAL_CALLSTATEPOLL = {0,500000};
+
+/* pending re-polls; a new one replaces the old so they never pile up */
+static RIL_TimedCallbackHandle s_simPollHandle = NULL;
+static RIL_TimedCallbackHandle s_callStatePollHandle = NULL;
 static const struct timeval TIMEVAL_0 = {0,0};
 
 #ifdef WORKAROUND_ERRONEOUS_ANSWER
@@ -770,6 +777,8 @@ static void requestSetNetworkSelectionManual(
 
 static void sendCallStateChanged(void *param)
 {
+    // Fired, so the handle is spent
+    s_callStatePollHandle = NULL;
     RIL_onUnsolicitedResponse (
         RIL_UNSOL_RESPONSE_CALL_STATE_CHANGED,
         NULL, 0);
@@ -921,7 +930,11 @@ static void requestGetCurrentCalls(void *data, size_t datalen, RIL_Token t)
 #else
     if (needRepoll) {
 #endif
-        RIL_requestTimedCallback (sendCallStateChanged, NULL, &TIMEVAL_CALLSTATEPOLL);
+        if (s_callStatePollHandle != NULL) {
+            RIL_cancelTimedCallback(s_callStatePollHandle);
+        }
+        s_callStatePollHandle = RIL_requestTimedCallbackEx (sendCallStateChanged,
+                                        NULL, &TIMEVAL_CALLSTATEPOLL);
     }
 
     return;
@@ -3074,7 +3087,7 @@ onRequest (int request, void *data, size_t datalen, RIL_Token t)
     ATResponse *p_response;
     int err;
 
-    ALOGD("onRequest: %s", requestToString(request));
+    RIL_trace(RIL_TRACE_VENDOR_REQUEST, request, 0, 0);
 
     /* Ignore all requests except RIL_REQUEST_GET_SIM_STATUS
      * when RADIO_STATE_UNAVAILABLE.
@@ -3770,6 +3783,9 @@ static void pollSIMState (void *param)
     ATResponse *p_response;
     int ret;
 
+    // Fired, so the handle is spent
+    s_simPollHandle = NULL;
+
     if (sState != RADIO_STATE_ON) {
         // no longer valid to poll
         return;
@@ -3786,7 +3802,11 @@ static void pollSIMState (void *param)
         return;
 
         case SIM_NOT_READY:
-            RIL_requestTimedCallback (pollSIMState, NULL, &TIMEVAL_SIMPOLL);
+            if (s_simPollHandle != NULL) {
+                RIL_cancelTimedCallback(s_simPollHandle);
+            }
+            s_simPollHandle = RIL_requestTimedCallbackEx (pollSIMState,
+                                        NULL, &TIMEVAL_SIMPOLL);
         return;
 
         case SIM_READY:
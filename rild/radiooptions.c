@@ -34,6 +34,10 @@ enum options {
     DIAL_CALL,
     ANSWER_CALL,
     END_CALL,
+    DUMP_STATS,
+    TOGGLE_LOOP_STATS,
+    DUMP_LATENCY,
+    DUMP_TRACE,
 };
 
 
@@ -49,7 +53,11 @@ static void print_usage() {
            7 - DEACTIVE_PDP, \n\
            8 number - DIAL_CALL number, \n\
            9 - ANSWER_CALL, \n\
-           10 - END_CALL \n");
+           10 - END_CALL, \n\
+           11 - DUMP_STATS, \n\
+           12 - TOGGLE_LOOP_STATS, \n\
+           13 - DUMP_LATENCY, \n\
+           14 - DUMP_TRACE \n");
 }
 
 static int error_check(int argc, char * argv[]) {
@@ -57,7 +65,7 @@ static int error_check(int argc, char * argv[]) {
         return -1;
     }
     const int option = atoi(argv[1]);
-    if (option < 0 || option > 10) {
+    if (option < 0 || option > DUMP_TRACE) {
         return 0;
     } else if ((option == DIAL_CALL || option == SETUP_PDP) && argc == 3) {
         return 0;
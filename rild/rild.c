@@ -57,11 +57,18 @@ extern void RIL_onUnsolicitedResponse(int unsolResponse, const void *data,
 extern void RIL_requestTimedCallback (RIL_TimedCallback callback,
                                void *param, const struct timeval *relativeTime);
 
+extern RIL_TimedCallbackHandle RIL_requestTimedCallbackEx (RIL_TimedCallback callback,
+                               void *param, const struct timeval *relativeTime);
+
+extern int RIL_cancelTimedCallback (RIL_TimedCallbackHandle handle);
+
 
 static struct RIL_Env s_rilEnv = {
     RIL_onRequestComplete,
     RIL_onUnsolicitedResponse,
-    RIL_requestTimedCallback
+    RIL_requestTimedCallback,
+    RIL_requestTimedCallbackEx,
+    RIL_cancelTimedCallback
 };
 
 extern void RIL_startEventLoop();
@@ -0,0 +1,20 @@
+# Copyright 2006 The Android Open Source Project
+
+# Vendor RIL with no modem, for load testing libril with ril_loadgen
+#
+LOCAL_PATH:= $(call my-dir)
+include $(CLEAR_VARS)
+
+LOCAL_SRC_FILES:= \
+    stub-ril.c
+
+LOCAL_SHARED_LIBRARIES := \
+    libcutils libutils
+
+LOCAL_LDLIBS += -lpthread
+LOCAL_CFLAGS := -DRIL_SHLIB
+
+LOCAL_MODULE:= libstub-ril
+LOCAL_MODULE_TAGS := optional
+
+include $(BUILD_SHARED_LIBRARY)
@@ -0,0 +1,284 @@
+/* //device/system/stub-ril/stub-ril.c
+**
+** Copyright 2006, The Android Open Source Project
+**
+** Licensed under the Apache License, Version 2.0 (the "License");
+** you may not use this file except in compliance with the License.
+** You may obtain a copy of the License at
+**
+**     http://www.apache.org/licenses/LICENSE-2.0
+**
+** Unless required by applicable law or agreed to in writing, software
+** distributed under the License is distributed on an "AS IS" BASIS,
+** WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+** See the License for the specific language governing permissions and
+** limitations under the License.
+*/
+
+/*
+ * Vendor RIL with no modem behind it, for measuring libril itself with
+ * ril_loadgen. Every request completes after a configurable
+ * service time, from a thread standing in for a modem reader thread.
+ * The requests the framework polls most get canned responses so their
+ * marshalling is measured too; everything else completes with no data.
+ *
+ *   rild -l /system/lib/libstub-ril.so -- [-d <us>] [-j <us>] [-e <percent>]
+ *
+ *   -d  service time in microseconds; 0 completes inside onRequest
+ *   -j  spread the service time uniformly over +/- this many microseconds
+ *   -e  fail this percentage of requests with RIL_E_GENERIC_FAILURE
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <getopt.h>
+#include <pthread.h>
+#include <sys/time.h>
+#include <telephony/ril.h>
+
+#define LOG_TAG "RIL_STUB"
+#include <utils/Log.h>
+
+static void onRequest (int request, void *data, size_t datalen, RIL_Token t);
+static RIL_RadioState currentState();
+static int onSupports (int requestCode);
+static void onCancel (RIL_Token t);
+static const char *getVersion();
+
+static const RIL_RadioFunctions s_callbacks = {
+    RIL_VERSION,
+    onRequest,
+    currentState,
+    onSupports,
+    onCancel,
+    getVersion
+};
+
+static const struct RIL_Env *s_rilenv;
+
+#define RIL_onRequestComplete(t, e, response, responselen) s_rilenv->OnRequestComplete(t,e, response, responselen)
+
+/* A request waiting out its service time */
+typedef struct PendingRequest {
+    struct PendingRequest *next;
+    struct timespec deadline;
+    int request;
+    int fail;
+    RIL_Token t;
+} PendingRequest;
+
+static int s_serviceUs = 0;
+static int s_jitterUs = 0;
+static int s_errorPercent = 0;
+
+static pthread_mutex_t s_pendingMutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t s_pendingCond = PTHREAD_COND_INITIALIZER;
+static PendingRequest *s_pending = NULL;    /* sorted by deadline */
+static unsigned int s_seed = 1;      /* only onRequest draws from it */
+
+static void complete(int request, int fail, RIL_Token t)
+{
+    static const char *registration[] = {"1", "1f2e", "0003a4b2", "3", NULL, NULL, NULL,
+            NULL, NULL, NULL, NULL, NULL, NULL, "0"};
+    static const char *operatorNames[] = {"Stub Mobile", "Stub", "310260"};
+    static const char *serial = "310260000000000";
+    static int one = 1;
+    RIL_SignalStrength_v6 signal;
+
+    if (fail) {
+        RIL_onRequestComplete(t, RIL_E_GENERIC_FAILURE, NULL, 0);
+        return;
+    }
+
+    switch (request) {
+        case RIL_REQUEST_SIGNAL_STRENGTH:
+            memset(&signal, 0, sizeof(signal));
+            signal.GW_SignalStrength.signalStrength = 20;
+            signal.GW_SignalStrength.bitErrorRate = 99;
+            signal.LTE_SignalStrength.rsrp = 0x7fffffff;
+            signal.LTE_SignalStrength.rsrq = 0x7fffffff;
+            signal.LTE_SignalStrength.rssnr = 0x7fffffff;
+            signal.LTE_SignalStrength.cqi = 0x7fffffff;
+            RIL_onRequestComplete(t, RIL_E_SUCCESS, &signal, sizeof(signal));
+            break;
+        case RIL_REQUEST_VOICE_REGISTRATION_STATE:
+        case RIL_REQUEST_DATA_REGISTRATION_STATE:
+            RIL_onRequestComplete(t, RIL_E_SUCCESS, registration, sizeof(registration));
+            break;
+        case RIL_REQUEST_OPERATOR:
+            RIL_onRequestComplete(t, RIL_E_SUCCESS, operatorNames, sizeof(operatorNames));
+            break;
+        case RIL_REQUEST_GET_IMSI:
+        case RIL_REQUEST_GET_IMEI:
+        case RIL_REQUEST_GET_IMEISV:
+            RIL_onRequestComplete(t, RIL_E_SUCCESS, (void *) serial, sizeof(char *));
+            break;
+        case RIL_REQUEST_QUERY_NETWORK_SELECTION_MODE:
+        case RIL_REQUEST_GET_PREFERRED_NETWORK_TYPE:
+            RIL_onRequestComplete(t, RIL_E_SUCCESS, &one, sizeof(one));
+            break;
+        default:
+            RIL_onRequestComplete(t, RIL_E_SUCCESS, NULL, 0);
+            break;
+    }
+}
+
+static int timespecBefore(const struct timespec *a, const struct timespec *b)
+{
+    return a->tv_sec < b->tv_sec || (a->tv_sec == b->tv_sec && a->tv_nsec < b->tv_nsec);
+}
+
+/* Completes requests as their service time runs out */
+static void *modemLoop(void *param)
+{
+    pthread_mutex_lock(&s_pendingMutex);
+    for (;;) {
+        PendingRequest *p = s_pending;
+        struct timeval tv;
+        struct timespec now;
+
+        if (p == NULL) {
+            pthread_cond_wait(&s_pendingCond, &s_pendingMutex);
+            continue;
+        }
+
+        gettimeofday(&tv, NULL);
+        now.tv_sec = tv.tv_sec;
+        now.tv_nsec = tv.tv_usec * 1000;
+        if (timespecBefore(&now, &p->deadline)) {
+            pthread_cond_timedwait(&s_pendingCond, &s_pendingMutex, &p->deadline);
+            continue;
+        }
+
+        s_pending = p->next;
+        pthread_mutex_unlock(&s_pendingMutex);
+
+        complete(p->request, p->fail, p->t);
+        free(p);
+
+        pthread_mutex_lock(&s_pendingMutex);
+    }
+    return NULL;
+}
+
+static void
+onRequest (int request, void *data, size_t datalen, RIL_Token t)
+{
+    PendingRequest *p;
+    PendingRequest **pp;
+    struct timeval tv;
+    int us = s_serviceUs;
+    int fail = 0;
+
+    if (s_errorPercent > 0) {
+        fail = (int) (rand_r(&s_seed) % 100) < s_errorPercent;
+    }
+    if (s_jitterUs > 0) {
+        us += (int) (rand_r(&s_seed) % (2 * s_jitterUs + 1)) - s_jitterUs;
+    }
+    if (us <= 0) {
+        complete(request, fail, t);
+        return;
+    }
+
+    p = (PendingRequest *) malloc(sizeof(PendingRequest));
+    if (p == NULL) {
+        RIL_onRequestComplete(t, RIL_E_GENERIC_FAILURE, NULL, 0);
+        return;
+    }
+    p->request = request;
+    p->fail = fail;
+    p->t = t;
+
+    gettimeofday(&tv, NULL);
+    tv.tv_usec += us;
+    p->deadline.tv_sec = tv.tv_sec + tv.tv_usec / 1000000;
+    p->deadline.tv_nsec = (tv.tv_usec % 1000000) * 1000;
+
+    pthread_mutex_lock(&s_pendingMutex);
+    for (pp = &s_pending; *pp != NULL; pp = &(*pp)->next) {
+        if (timespecBefore(&p->deadline, &(*pp)->deadline)) {
+            break;
+        }
+    }
+    p->next = *pp;
+    *pp = p;
+    if (s_pending == p) {
+        pthread_cond_signal(&s_pendingCond);
+    }
+    pthread_mutex_unlock(&s_pendingMutex);
+}
+
+static RIL_RadioState
+currentState()
+{
+    return RADIO_STATE_ON;
+}
+
+static int
+onSupports (int requestCode)
+{
+    return 1;
+}
+
+static void onCancel (RIL_Token t)
+{
+}
+
+static const char * getVersion(void)
+{
+    return "android stub-ril 1.0";
+}
+
+static void usage(char *s)
+{
+    fprintf(stderr, "stub-ril requires: [-d <service us>] [-j <jitter us>] [-e <error percent>]\n");
+}
+
+const RIL_RadioFunctions *RIL_Init(const struct RIL_Env *env, int argc, char **argv)
+{
+    int opt;
+    pthread_t tid;
+    pthread_attr_t attr;
+
+    s_rilenv = env;
+
+    while ( -1 != (opt = getopt(argc, argv, "d:j:e:"))) {
+        switch (opt) {
+            case 'd':
+                s_serviceUs = atoi(optarg);
+            break;
+
+            case 'j':
+                s_jitterUs = atoi(optarg);
+            break;
+
+            case 'e':
+                s_errorPercent = atoi(optarg);
+            break;
+
+            default:
+                usage(argv[0]);
+                return NULL;
+        }
+    }
+
+    if (s_serviceUs < 0 || s_jitterUs < 0 || s_errorPercent < 0 || s_errorPercent > 100) {
+        usage(argv[0]);
+        return NULL;
+    }
+
+    ALOGI("stub-ril: service %d us +/- %d us, %d%% errors",
+            s_serviceUs, s_jitterUs, s_errorPercent);
+
+    pthread_attr_init (&attr);
+    pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
+    if (pthread_create(&tid, &attr, modemLoop, NULL) != 0) {
+        ALOGE("stub-ril: can't start modem thread errno:%d", errno);
+        return NULL;
+    }
+
+    return &s_callbacks;
+}